@@ -0,0 +1,240 @@
+/**
+ * @file    bench.c
+ *
+ * @author  Petros Bimpiris (pbimpiris@tuc.gr)
+ *
+ * @brief   A tool to measure how many test vectors per second each simulation kernel
+ *          (and the circuit compiled or jit translated to machine code) can go through on a
+ *          given circuit. It can also check the jit against simulate() (see -d).
+ *
+ * @version 1.0
+ *
+ * @date 11-06-2023
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "str_util.h"
+#include "netlist.h"
+
+#define GATE_LIB_NAME       "component.lib"
+#define INPUT_FILE          "subsystem.lib"
+#define SUBSYSTEM_NAME      "FULL_ADDER8"
+#define PASSES              20000
+
+void usage();
+
+/**
+ * @brief   Return the current time in seconds, from a clock that only moves forward.
+ */
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main(int argc, char *argv[]) {
+
+    char ch, *gate_lib_name = GATE_LIB_NAME, *input_file = INPUT_FILE, *subsys_name = SUBSYSTEM_NAME;
+    int passes = PASSES;
+    int check_vectors = 0;
+
+    // parse any (optional) arguments
+    while ((ch = getopt(argc, argv, "g:i:s:n:d:h")) != -1) {
+        switch (ch) {
+            case 'g':
+                gate_lib_name = optarg;
+                break;
+            case 'i':
+                input_file = optarg;
+                break;
+            case 's':
+                subsys_name = optarg;
+                break;
+            case 'n':
+                passes = atoi(optarg);
+                break;
+            case 'd':
+                check_vectors = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage();
+                exit(0);
+        }
+    }
+
+    // parse the component library and the netlist, just like simulate does
+    Netlist *gate_lib = malloc(sizeof(Netlist));
+    if (gate_lib_from_file(gate_lib_name, gate_lib)) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    Netlist *input = malloc(sizeof(Netlist));
+    if (subsys_lib_from_file(input_file, input, gate_lib)) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    Standard *std = find_in_lib(input, subsys_name);
+    if (std == NULL) {
+        return -1;
+    }
+    Subsystem *s = std->subsys;
+
+    // compile the subsystem, the kernels only work with programs
+    if (compile_subsystem(s, &(s->program)) || !s->program->levelized) {
+        fprintf(stderr, "subsystem %s cannot be compiled into a levelized program\n", s->name);
+        return -1;
+    }
+    SimProgram *p = s->program;
+
+    // only check the jit against simulate() if asked to
+    if (check_vectors > 0) {
+        int mismatches = jit_check(s, check_vectors, 1);
+        printf("%s: jit %s on %d random vectors (%s)\n", s->name, mismatches ? "FAILED" : "ok", check_vectors, p->jit != NULL ? "machine code" : "interpreter fallback");
+        free_lib(gate_lib);
+        free_lib(input);
+        free_symbols();
+        return mismatches ? 1 : 0;
+    }
+
+    printf("%s: %d inputs, %d gates, %d outputs, %d passes per kernel\n", s->name, s->_inputc, p->instrc, s->_outputc, passes);
+    printf("%-14s %-8s %-16s %s\n", "kernel", "lanes", "vectors/sec", "check");
+
+    // the widest kernel needs 8 words per slot, random inputs are generated once for all kernels
+    srand(1);
+    uint64_t *inputs = malloc(sizeof(uint64_t) * s->_inputc * 8 + 1);
+    for (int i=0; i<s->_inputc*8; i++) {
+        inputs[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+    }
+
+    // the reference results are the ones of the portable kernel
+    uint64_t *reference = malloc(sizeof(uint64_t) * p->slotc * 8 + 1);
+    memcpy(reference, inputs, sizeof(uint64_t) * s->_inputc * 8);
+    run_program_words(p, reference, 8);
+
+    // the one-vector-at-a-time engine that simulate() uses, for comparison
+    uint64_t *bit_slots = malloc(sizeof(uint64_t) * BIT_WORDS(p->slotc+1));
+    memset(bit_slots, 0, sizeof(uint64_t) * BIT_WORDS(p->slotc+1));
+    double start = now();
+    for (int n=0; n<passes; n++) {
+        bit_slots[(n % s->_inputc)/64] ^= (uint64_t)1 << ((n % s->_inputc)%64);
+        run_program_bits(p, bit_slots);
+    }
+    double secs = now() - start;
+    printf("%-14s %-8d %-16.0f %s\n", "levelized", 1, passes/secs, "-");
+
+    // run every kernel that this CPU supports
+    for (SimKernel *k=sim_kernels; k->name!=NULL; k++) {
+
+        if (k->supported != NULL && !k->supported()) {
+            printf("%-14s %-8d %-16s %s\n", k->name, 64*k->width, "-", "not supported by this CPU");
+            continue;
+        }
+
+        // lay the inputs out for the kernel's width (input i, word w is word i*8+w of the generated ones)
+        uint64_t *slots = malloc(sizeof(uint64_t) * p->slotc * k->width + 1);
+        for (int i=0; i<s->_inputc; i++) {
+            memcpy(slots + i*k->width, inputs + i*8, sizeof(uint64_t) * k->width);
+        }
+
+        // one pass to check the results, then the timed ones
+        k->run(p, slots);
+        int ok = 1;
+        for (int i=0; i<p->outc; i++) {
+            for (int w=0; w<k->width; w++) {
+                if (slots[p->out_slots[i]*k->width + w] != reference[p->out_slots[i]*8 + w]) ok = 0;
+            }
+        }
+
+        start = now();
+        for (int n=0; n<passes; n++) {
+            k->run(p, slots);
+        }
+        secs = now() - start;
+
+        printf("%-14s %-8d %-16.0f %s\n", k->name, 64*k->width, (double)passes*64*k->width/secs, ok ? "ok" : "MISMATCH");
+
+        free(slots);
+    }
+
+    // the subsystem compiled to machine code, at the widest width of the kernels above
+    if (compile_program_native(p, 8, NATIVE_CACHE_DIR)) {
+        printf("%-14s %-8d %-16s %s\n", "native", 512, "-", "could not be compiled");
+    } else {
+
+        uint64_t *slots = malloc(sizeof(uint64_t) * p->slotc * 8 + 1);
+        memcpy(slots, inputs, sizeof(uint64_t) * s->_inputc * 8);
+
+        run_program_native(p, slots);
+        int ok = 1;
+        for (int i=0; i<p->outc; i++) {
+            for (int w=0; w<8; w++) {
+                if (slots[p->out_slots[i]*8 + w] != reference[p->out_slots[i]*8 + w]) ok = 0;
+            }
+        }
+
+        start = now();
+        for (int n=0; n<passes; n++) {
+            run_program_native(p, slots);
+        }
+        secs = now() - start;
+
+        printf("%-14s %-8d %-16.0f %s\n", "native", 512, (double)passes*512/secs, ok ? "ok" : "MISMATCH");
+
+        free(slots);
+    }
+
+    // the subsystem translated to machine code in memory
+    jit_compile_program(p, 8);
+    {
+        uint64_t *slots = malloc(sizeof(uint64_t) * p->slotc * 8 + 1);
+        memcpy(slots, inputs, sizeof(uint64_t) * s->_inputc * 8);
+
+        run_program_jit(p, slots);
+        int ok = 1;
+        for (int i=0; i<p->outc; i++) {
+            for (int w=0; w<8; w++) {
+                if (slots[p->out_slots[i]*8 + w] != reference[p->out_slots[i]*8 + w]) ok = 0;
+            }
+        }
+
+        start = now();
+        for (int n=0; n<passes; n++) {
+            run_program_jit(p, slots);
+        }
+        secs = now() - start;
+
+        printf("%-14s %-8d %-16.0f %s\n", p->jit != NULL ? "jit" : "jit fallback", 512, (double)passes*512/secs, ok ? "ok" : "MISMATCH");
+
+        free(slots);
+    }
+
+    // cleanup
+    free(inputs);
+    free(reference);
+    free(bit_slots);
+    free_lib(gate_lib);
+    free_lib(input);
+    free_symbols();
+
+    return 0;
+}
+
+void usage() {
+    printf("Usage: ./bench [<option> <argument>]\n");
+    printf("Available options:\n");
+    printf("\t-g <filename>:\tuse the file with the given name as the component (gate) library (default %s)\n", GATE_LIB_NAME);
+    printf("\t-i <filename>:\tuse the file with the given name as the input netlist (default %s)\n", INPUT_FILE);
+    printf("\t-s <name>:\tbenchmark the subsystem with the given name (must be contained in the specified netlist) (default %s)\n", SUBSYSTEM_NAME);
+    printf("\t-n <passes>:\tthe number of passes over the subsystem that each kernel will make (default %d)\n", PASSES);
+    printf("\t-d <vectors>:\tinstead of benchmarking, check the jit against simulate() on the given number of random vectors (exits with 1 on any mismatch)\n");
+}
@@ -0,0 +1,188 @@
+/**
+ * @file    flatten.c
+ *
+ * @author  Petros Bimpiris (pbimpiris@tuc.gr)
+ *
+ * @brief   A tool to flatten the subsystems of a netlist down to their gates and write
+ *          the gate-only netlist to a file.
+ *
+ * @version 1.0
+ *
+ * @date 11-06-2023
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "str_util.h"
+#include "netlist.h"
+
+#define GATE_LIB_NAME       "component.lib"
+#define SUBSYS_LIB_NAME     "subsystem.lib"
+#define NETLIST_NAME        "netlist5.txt"
+#define OUTPUT_FILE         "gates_only.txt"
+#define MAX_SUBSYS_LIBS     16
+
+void usage();
+
+/**
+ * @brief   Add the standards of lib to lookup, which only refers to them. The name of lib is the one that the
+ *          messages about lookup report from now on.
+ */
+void add_to_lookup(Netlist *lookup, Netlist *lib) {
+
+    for (Node *n=lib->contents->head; n!=NULL; n=n->next) {
+        if (n->type == STANDARD) {
+            add_to_lib(lookup, n->std, 1, n->std->type);
+        }
+    }
+    lookup->file = lib->file;
+}
+
+int main(int argc, char *argv[]) {
+
+    int ch;
+    char *gate_lib_name = GATE_LIB_NAME, *netlist_name = NETLIST_NAME, *output_file = OUTPUT_FILE;
+    char *subsys_lib_names[MAX_SUBSYS_LIBS] = { SUBSYS_LIB_NAME };
+    int subsys_libc = 0;
+    int threads = 1;
+    char *levels_file = NULL;
+
+    // parse any (optional) arguments
+    while ((ch = getopt(argc, argv, "g:s:n:o:j:l:h")) != -1) {
+        switch (ch) {
+            case 'g':
+                gate_lib_name = optarg;
+                break;
+            case 's':
+                if (subsys_libc == MAX_SUBSYS_LIBS) {
+                    fprintf(stderr, "at most %d subsystem libraries can be given\n", MAX_SUBSYS_LIBS);
+                    exit(-1);
+                }
+                subsys_lib_names[subsys_libc++] = optarg;
+                break;
+            case 'n':
+                netlist_name = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+                    usage();
+                    exit(-1);
+                }
+                break;
+            case 'l':
+                levels_file = optarg;
+                break;
+            case 'h':
+            default:
+                usage();
+                exit(0);
+        }
+    }
+
+    // with no -s, only the default subsystem library is read
+    if (subsys_libc == 0) {
+        subsys_libc = 1;
+    }
+
+    // read the component library where the gates are defined
+    Netlist *gate_lib = malloc(sizeof(Netlist));
+    if (gate_lib_from_file(gate_lib_name, gate_lib)) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    // every library is built from the gates and the subsystems of the libraries before it, which are all
+    // looked up in one library that only refers to them (a name that is defined twice is found where it is first)
+    Netlist *lookup = malloc(sizeof(Netlist));
+    lookup->type = SUBSYSTEM;
+    lookup->contents = ll_init();
+    lookup->index = NULL;
+    lookup->lazy = NULL;
+    lookup->arena = NULL;
+    add_to_lookup(lookup, gate_lib);
+
+    // read the subsystem libraries
+    Netlist *libs[MAX_SUBSYS_LIBS];
+    for (int l=0; l<subsys_libc; l++) {
+        libs[l] = malloc(sizeof(Netlist));
+        if (subsys_lib_from_file_parallel(subsys_lib_names[l], libs[l], lookup, threads)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+        add_to_lookup(lookup, libs[l]);
+    }
+
+    // read the netlist, which is built from all of the above too
+    Netlist *netlist = malloc(sizeof(Netlist));
+    if (subsys_lib_from_file_parallel(netlist_name, netlist, lookup, threads)) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    // create a netlist that contains everything the one above does, but implemented only with gates
+    Netlist *only_gates_lib = malloc(sizeof(Netlist));
+    if (netlist_to_gate_only_parallel(only_gates_lib, netlist, 1, threads)) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    // print the gates-only netlist to the file
+    if (lib_to_file(only_gates_lib, output_file, "w")) {
+        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+        return -1;
+    }
+
+    // report how deep the gates of every subsystem of the netlist were, if asked to
+    if (levels_file != NULL) {
+
+        FILE *fp = fopen(levels_file, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "could not open %s\n", levels_file);
+            return -1;
+        }
+
+        for (Node *n=netlist->contents->head; n!=NULL; n=n->next) {
+            if (n->type == STANDARD && n->std->type == SUBSYSTEM && gate_levels_to_file(n->std->subsys, fp)) {
+                fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+                return -1;
+            }
+        }
+        fclose(fp);
+    }
+
+    // cleanup (the lookup library only refers to the contents of the others)
+    free_lib(only_gates_lib);
+    free_lib(netlist);
+    ll_free(lookup->contents, 0);
+    free_index(lookup->index);
+    free(lookup);
+    for (int l=subsys_libc-1; l>=0; l--) {
+        free_lib(libs[l]);
+    }
+    free_lib(gate_lib);
+    free_symbols();
+
+    printf("Program executed successfully\n");
+    return 0;
+}
+
+void usage() {
+    printf("Usage: ./flatten [<option> <argument>]\n");
+    printf("Available options:\n");
+    printf("\t-g <filename>:\tuse the file with the given name as the component (gate) library (default %s)\n", GATE_LIB_NAME);
+    printf("\t-s <filename>:\tuse the file with the given name as a subsystem library, can be given up to %d times, each library is built from the gates and the subsystems of the ones before it (default %s)\n", MAX_SUBSYS_LIBS, SUBSYS_LIB_NAME);
+    printf("\t-n <filename>:\tuse the file with the given name as the input netlist, built from the gates and the subsystems of the libraries (default %s)\n", NETLIST_NAME);
+    printf("\t-o <filename>:\twrite the gate-only netlist to a file with the given name (will be overwritten if it already exists) (default %s)\n", OUTPUT_FILE);
+    printf("\t-l <filename>:\twrite how many gates every subsystem of the netlist has, and how many of them come from each level of its hierarchy, to a file with the given name\n");
+    printf("\t-j <threads>:\tsplit the parsing and the flattening of the subsystems across the given number of threads, the output stays the same (default 1)\n");
+}
@@ -17,13 +17,32 @@
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+#include <fcntl.h>
+#include <errno.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
 #include "netlist.h"
 #include "str_util.h"
 
 LList* ll_init() {
-    LList *ll = malloc(sizeof(LList));
+    return ll_init_in(NULL);
+}
+
+LList* ll_init_in(Arena *arena) {
+    LList *ll = alloc_in(arena, sizeof(LList));
     ll->head = NULL;
     ll->tail = NULL;
+    ll->size = 0;
+    ll->arena = arena;
 
     return ll;
 }
@@ -42,13 +61,15 @@ int ll_add(LList *ll, Node* new_element) {
     }
 
     ll->tail = new_element;
+    ll->size++;
 
     return 0;
 }
 
 void ll_free(LList *l, int complete) {
 
-    if (l != NULL) {
+    // the list, its nodes and their contents go away with the arena
+    if (l != NULL && l->arena == NULL) {
 
         if (l->head != NULL) {
 
@@ -95,29 +116,15 @@ void free_subsystem(Subsystem *s, int free_comp) {
 
     if (s!=NULL) {
 
-        // free inputs
+        // anything that was allocated from an arena stays there (see free_in())
+        Arena *arena = s->arena;
+
+        // free the lists of inputs and outputs (the names are interned, they are not freed)
         if (s->inputs != NULL) {
-            for(int i=0; i<s->_inputc; i++) {
-                if (s->inputs[i] != NULL) {
-                    free(s->inputs[i]);
-                }
-            }
-            free(s->inputs);
+            free_in(arena, s->inputs);
         }
-
-        // free outputs
         if (s->outputs != NULL) {
-            for(int i=0; i<s->_outputc; i++) {
-                if (s->outputs[i] != NULL) {
-                    free(s->outputs[i]);
-                }
-            }
-            free(s->outputs);
-        }
-
-        // free name
-        if (s->name != NULL) {
-            free(s->name);
+            free_in(arena, s->outputs);
         }
 
         // free component list
@@ -127,12 +134,7 @@ void free_subsystem(Subsystem *s, int free_comp) {
         
         // free output mapping str list
         if (s->output_mappings != NULL) {
-            for (int i=0; i<s->_outputc; i++) {
-                if (s->output_mappings[i] != NULL) {
-                    free(s->output_mappings[i]);
-                }
-            }
-            free(s->output_mappings);
+            free_in(arena, s->output_mappings);
         }
 
         // free aliases
@@ -141,7 +143,7 @@ void free_subsystem(Subsystem *s, int free_comp) {
         }
 
         // free the actual output mappings (if needed)
-        if (s->is_standard) {
+        if (s->is_standard && arena == NULL) {
             if (s->o_maps != NULL) {
                 for (int i=0; i<s->_outputc; i++) {
                     if (s->o_maps[i] != NULL) {
@@ -152,8 +154,22 @@ void free_subsystem(Subsystem *s, int free_comp) {
             }
         }
 
+        // free the compiled program (if it was ever compiled)
+        if (s->program != NULL) {
+            free_program(s->program);
+        }
+
+        // free the indexes
+        free_index(s->comp_index);
+        free_index(s->input_index);
+        free_index(s->output_index);
+        free_index(s->alias_index);
+        free_comp_store(s->store);
+        free_flat_template(s->tmpl);
+        free_model(s->model);
+
         // free s itself
-        free(s);
+        free_in(arena, s);
 
     }
 
@@ -217,6 +233,23 @@ int subsys_hdr_to_str(Subsystem* s, char* str, int n) {
     return 0;
 }
 
+/**
+ * @brief   Return how many bytes the header of the given subsystem takes up once it is written by
+ *          subsys_hdr_to_str() (null terminator included), which can be more than MAX_LINE_LEN.
+*/
+int subsys_hdr_size(Subsystem *s) {
+
+    int size = strlen(DECL_DESIGNATION) + strlen(s->name) + 2*strlen(GENERAL_DELIM) + strlen(INPUT_DESIGNATION) + strlen(OUTPUT_DESIGNATION) + 1;
+    for (int i=0; i<s->_inputc; i++) {
+        size += strlen(s->inputs[i]) + strlen(IN_OUT_DELIM);
+    }
+    for (int i=0; i<s->_outputc; i++) {
+        size += strlen(s->outputs[i]) + strlen(IN_OUT_DELIM);
+    }
+
+    return size;
+}
+
 int str_to_subsys_hdr(char *str, Subsystem *s, int n) {
 
     // any line declaring a subsystem starts with DECL_DESIGNATION which we ignore
@@ -243,13 +276,9 @@ int str_to_subsys_hdr(char *str, Subsystem *s, int n) {
     char *_outputs = raw_outputs+strlen(OUTPUT_DESIGNATION);
 
     // parse the input and output lists
-    s->inputs = NULL;   // initialize to NULL so initial call to realloc is like malloc
-    s->outputs = NULL;
-
-    s->_inputc = str_to_list(_inputs, &(s->inputs), IN_OUT_DELIM);
-    s->_outputc = str_to_list(_outputs, &(s->outputs), IN_OUT_DELIM);
-    s->name = malloc(strlen(name)+1);
-    strncpy(s->name, name, strlen(name)+1);
+    s->_inputc = str_to_sym_list(_inputs, &(s->inputs), IN_OUT_DELIM, s->arena);
+    s->_outputc = str_to_sym_list(_outputs, &(s->outputs), IN_OUT_DELIM, s->arena);
+    s->name = intern(name, strlen(name));
 
     return 0;
 }
@@ -272,13 +301,8 @@ void free_component(Component *c) {
             }
         }
 
-        // in any case there will be inputs
+        // in any case there will be inputs (only the list, the names are interned)
         if (c->inputs != NULL) {
-            for(int i=0; i<c->_inputc; i++) {
-                if (c->inputs[i] != NULL) {
-                    free(c->inputs[i]);
-                }
-            }
             free(c->inputs);
         }
 
@@ -328,7 +352,7 @@ int comp_to_str(Component *c, char *str, int n) {
     return 0;
 }
 
-int str_to_gate(char *str, Gate *g, int n, int parse_tt) {
+int str_to_gate(char *str, Gate *g, int n, int parse_tt, Arena *arena) {
 
     if (str==NULL || g==NULL) {
         return NARG;
@@ -353,15 +377,34 @@ int str_to_gate(char *str, Gate *g, int n, int parse_tt) {
     char *_inputs = raw_inputs+strlen(INPUT_DESIGNATION);
 
     // parse the name
-    g->name = malloc(strlen(name)+1);
-    strncpy(g->name, name, strlen(name)+1);
+    g->name = intern(name, strlen(name));
 
     // parse the input list
-    g->inputs = NULL;   // initialize to NULL so initial call to realloc is like malloc
-    g->_inputc = str_to_list(_inputs, &(g->inputs), IN_OUT_DELIM);
+    g->_inputc = str_to_sym_list(_inputs, &(g->inputs), IN_OUT_DELIM, arena);
+
+    // parse the truth table (if asked to), it must have a row for every combination of the inputs
+    g->truth_table = NULL;
+    if (parse_tt) {
+
+        if (g->_inputc > MAX_GATE_INPUTS) {
+            fprintf(stderr, "gate %s has %d inputs, at most %d are supported\n", g->name, g->_inputc, MAX_GATE_INPUTS);
+            return GENERIC_ERROR;
+        }
+
+        int rows = parse_truth_table(truth_table, &(g->truth_table));
+        if (rows != 1<<g->_inputc) {
+            fprintf(stderr, "the truth table of gate %s has %d rows, expected %d\n", g->name, rows, 1<<g->_inputc);
+            return GENERIC_ERROR;
+        }
 
-    // parse the truth table
-    g->truth_table = parse_truth_table(truth_table);
+        // the table is parsed into malloc()'d memory, it is moved to the arena
+        if (arena != NULL) {
+            uint64_t *tt = arena_alloc(arena, sizeof(uint64_t) * TT_WORDS(g->_inputc));
+            memcpy(tt, g->truth_table, sizeof(uint64_t) * TT_WORDS(g->_inputc));
+            free(g->truth_table);
+            g->truth_table = tt;
+        }
+    }
 
     return 0;
 }
@@ -414,9 +457,8 @@ int str_to_alias(char *str, Alias* a, Subsystem *s, int n){
     char *name     = split(&_str, MAP_DELIM);
     char *map_info = _str;
 
-    a->name = malloc(sizeof(name)+1);
-    strncpy(a->name, name, strlen(name)+1);
-    a->mapping = malloc(sizeof(Mapping));
+    a->name = intern(name, strlen(name));
+    a->mapping = alloc_in(s->arena, sizeof(Mapping));
     
     int res = str_to_mapping(map_info, s, a->mapping, strlen(map_info));
 
@@ -452,12 +494,7 @@ void free_alias(Alias *a) {
 
     if (a != NULL) {
 
-        // free the name
-        if (a->name != NULL) {
-            free(a->name);
-        }
-
-        // free the mapping
+        // free the mapping (the name is interned)
         if (a->mapping != NULL) {
             free(a->mapping);
         }
@@ -471,21 +508,16 @@ void free_alias(Alias *a) {
 
 void free_gate(Gate *g) {
 
-    // free name
-    if (g->name != NULL) {
-        free(g->name);
-    }
-
-    // free inputs
+    // free the list of inputs (the names are interned, just like the name of the gate)
     if (g->inputs != NULL) {
-        for(int i=0; i<g->_inputc; i++) {
-            if (g->inputs[i] != NULL) {
-                free(g->inputs[i]);
-            }
-        }
         free(g->inputs);
     }
 
+    // free the truth table
+    if (g->truth_table != NULL) {
+        free(g->truth_table);
+    }
+
     // free g itself
     free(g);
 }
@@ -531,15 +563,11 @@ void free_tb(Testbench *tb) {
 
     if (tb != NULL) {
 
-        // free the values
+        // free the values (they were all allocated from the testbench's arena)
         if (tb->values != NULL) {
-
-            for(int i=0; i<tb->uut->_inputc; i++) {
-                free_str_list(tb->values[i], tb->v_c);
-            }
-
             free(tb->values);
         }
+        arena_free(tb->arena);
 
         // free the output display list
         if (tb->outs_display != NULL) {
@@ -560,10 +588,17 @@ int add_to_lib(Netlist *lib, void* s, int is_standard, enum STANDARD_TYPE type)
     }
 
     // make the standard into a node
-    Node *n = malloc(sizeof(Node));
+    Node *n = alloc_in(lib->contents->arena, sizeof(Node));
     if (is_standard) {
         n->type = STANDARD;
         n->std = (Standard*) s;
+
+        // index it by name (the first standard with a name is the one that is found)
+        if (lib->index == NULL) {
+            lib->index = index_init(0);
+        }
+        char *name = n->std->type == GATE ? n->std->gate->name : n->std->subsys->name;
+        index_put(lib->index, sym_id(name), lib->contents->size, n->std);
     } else {
         if (type == SUBSYSTEM) {
             n->type = SUBSYSTEM_N;
@@ -584,13 +619,15 @@ int gate_lib_from_file(char *filename, Netlist* lib) {
         return NARG;
     }
     
-    char *line = NULL;  // no need to malloc it, getline() does that for us (and also reallocs if needed) 
-
-    int nread = 0;
-    int offset = 0;
-    size_t len = 0;
+    char *line = NULL;  // belongs to the reader, no need to malloc or free it
     int _en;
 
+    // open the file once, the lines are read from memory
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return GENERIC_ERROR;
+    }
+
     // save the filename
     lib->file = malloc(strlen(filename)+1);
     strncpy(lib->file, filename, strlen(filename)+1);
@@ -598,11 +635,14 @@ int gate_lib_from_file(char *filename, Netlist* lib) {
     // set the lib type
     lib->type = GATE;
 
-    // initialize the contents list pointer to null
-    lib->contents = ll_init();
+    // everything in the library is allocated from its arena
+    lib->arena = arena_init(0);
+    lib->contents = ll_init_in(lib->arena);
+    lib->index = NULL;
+    lib->lazy = NULL;
 
     // loop through the lines of the file and get the contents
-    while((nread = read_line_from_file(&line, filename, &len, offset)) != -1) {
+    while(lr_next(r, &line) != -1) {
 
         if (strlen(line) != 0) {
 
@@ -610,11 +650,11 @@ int gate_lib_from_file(char *filename, Netlist* lib) {
             if((starts_with(line, DECL_DESIGNATION))) {
 
                 // ...parse the line into a new gate...
-                Gate *g = malloc(sizeof(Gate));
-                if ( (_en=str_to_gate(line, g, strlen(line), 1)) ) return _en; // strlen(line) and not nread, because they might differ (see read_line())
+                Gate *g = arena_alloc(lib->arena, sizeof(Gate));
+                if ( (_en=str_to_gate(line, g, strlen(line), 1, lib->arena)) ) return _en; // strlen(line) and not nread, because they might differ (see read_line())
 
                 // ...create a standard from that new gate...
-                Standard *s = malloc(sizeof(Standard));
+                Standard *s = arena_alloc(lib->arena, sizeof(Standard));
                 s->type = GATE;
                 s->gate = g;
                 s->defined_in = lib;
@@ -623,168 +663,211 @@ int gate_lib_from_file(char *filename, Netlist* lib) {
                 if ( (_en=add_to_lib(lib, s, 1, GATE)) ) return _en;
             }
         }
-
-        // move the cursor according to the bytes read from the file
-        offset += nread;
     }
 
-    free(line);
+    lr_close(r);
 
     return 0;
 }
 
-int subsys_lib_from_file(char *filename, Netlist *lib, Netlist *lookup_lib) {
-    
-    if (filename == NULL || lib==NULL) {
-        return NARG;
-    }
-    
-    char *line = NULL;  // no need to malloc it, getline() does that for us (and also reallocs if needed) 
-    int line_no = 0;
-    int nread = 0;
-    int offset = 0;
-    size_t len = 0;
+/**
+ * Where the messages of the parser go while a thread of subsys_lib_from_file_parallel() parses a
+ * block: the buffers of that block, so that only the messages of the blocks that the serial parser
+ * would have reached are printed (see parse_worker()). NULL when nothing is buffered.
+*/
+__thread FILE *parse_out = NULL;
+__thread FILE *parse_err = NULL;
+
+/**
+ * @brief   Return the stream where a message of the parser for the given stream (stdout or stderr) goes.
+*/
+FILE *diag_stream(FILE *stream) {
+
+    if (stream == stderr && parse_err != NULL) return parse_err;
+    if (stream == stdout && parse_out != NULL) return parse_out;
+
+    return stream;
+}
+
+/**
+ * @brief   Parse the block of a subsystem (from its declaration to the end of its netlist) into a
+ *          new subsystem, whose components are looked up in lookup_lib.
+ * 
+ * @details line is the declaration (already read from r), the rest of the block is read from r.
+ *          line_no is the number of the line that was read last, for the error messages. The
+ *          subsystem and everything in it are allocated from the given arena.
+ */
+int subsys_from_lines(LineReader *r, char *line, char *filename, int *line_no, Netlist *lookup_lib, Arena *arena, Subsystem **sp) {
+
+    int index = -1;
+    int comp_buffer_index = 0;  // the index of each parsed component in the simulation buffers
     int _en;
 
-    // save the filename
-    lib->file = malloc(strlen(filename)+1);
-    strncpy(lib->file, filename, strlen(filename)+1);
+    // parse the first line into a subsystem header
+    Subsystem *s = arena_alloc(arena, sizeof(Subsystem));
+    s->arena = arena;
+    s->is_standard = 1;
+    s->components = ll_init_in(arena);
+    s->aliases = ll_init_in(arena);
+    s->program = NULL;
+    s->comp_index = s->input_index = s->output_index = s->alias_index = NULL;
+    s->store = NULL;
+    s->tmpl = NULL;
+    s->model = NULL;
+    if ( (_en=str_to_subsys_hdr(line, s, strlen(line))) ) {
+        fprintf(diag_stream(stdout), "error reading\n");
+        return _en;
+    }
 
-    lib->type = SUBSYSTEM;
+    // also allocate memory for the output mappings of the subsystem, now that we know how many there should be
+    s->output_mappings = arena_alloc(arena, sizeof(char*) * s->_outputc);
+    s->o_maps = arena_alloc(arena, sizeof(Mapping*) * s->_outputc);
+    // (any output that is never mapped stays NULL)
+    memset(s->output_mappings, 0, sizeof(char*) * s->_outputc);
+    memset(s->o_maps, 0, sizeof(Mapping*) * s->_outputc);
+
+    // read the next line
+    if ( lr_next(r, &line) == -1 ) {
+        fprintf(diag_stream(stdout), "%s:%d: Error! File ended right after %s declaration\n",filename, *line_no, DECL_DESIGNATION);
+        return UNEXPECTED_EOF;
+    }
+    (*line_no)++;
 
-    // initialize the contents list pointer to null
-    lib->contents = ll_init();
+    // check that the next line starts with BEGIN 
+    if (!starts_with(line, NETLIST_START)) {
+        fprintf(diag_stream(stdout), "%s:%d: Syntax error! Expected %s, got %s instead\n",filename, *line_no, NETLIST_START, line);
+        return SYNTAX_ERROR;
+    }
 
-    // loop through the lines of the file and get the contents
-    while((nread = read_line_from_file(&line, filename, &len, offset)) != -1) {
-        
-        line_no++;
-        offset += nread;
-        int index = -1;
+    // check that the netlist is of the expected subsystem
+    if  (!starts_with(line+strlen(NETLIST_START), s->name)) {
+        fprintf(diag_stream(stdout), "%s:%d: Syntax error! Expected netlist for subsystem %s, got %s instead\n",filename, *line_no, s->name, line);
+        return SYNTAX_ERROR;
+    }
 
-        int *comp_buffer_index = malloc(sizeof(int));  // the index of each parsed component in the simulation buffers
-        *comp_buffer_index = 0;
 
-        if (strlen(line) != 0) {    // if the line is empty, skip it
+    // keep reading lines and parsing them until END ... NETLIST is found
+    while (1) {
 
-            // if a line contains a gate declaration a new subsystem must be parsed
-            if((starts_with(line, DECL_DESIGNATION))) {
+        // read the next line
+        if ( lr_next(r, &line) == -1 ) {
+            fprintf(diag_stream(stdout), "%s:%d: Error! File ended while %s netlist was pending\n",filename, *line_no, s->name);
+            return UNEXPECTED_EOF;
+        }
+        (*line_no)++;
 
-                // parse the first line into a subsystem header
-                Subsystem *s = malloc(sizeof(Subsystem));
-                s->is_standard = 1;
-                s->components = ll_init();
-                s->aliases = ll_init();
-                if ( (_en=str_to_subsys_hdr(line, s, strlen(line))) ) {
-                    printf("error reading\n");
-                    return _en;
-                }
+        // if what is before the delimiter is an output of the subsystem, it's an output mapping
+        char *delim = strstr(line, MAP_DELIM);
+        char *sym = delim != NULL ? sym_lookup(line, delim-line) : NULL;
+        if ( sym != NULL && (index = subsys_output(s, sym)) != -1) {
 
-                // also allocate memory for the output mappings of the subsystem, now that we know how many there should be
-                s->output_mappings = malloc(sizeof(char*) * s->_outputc);
-                s->o_maps = malloc(sizeof(Mapping*) * s->_outputc);
+            char *_line = line;
+            split(&_line, MAP_DELIM);
 
-                // read the next line
-                if ( (nread = read_line_from_file(&line, filename, &len, offset)) == -1 ) {
-                    printf("%s:%d: Error! File ended right after %s declaration\n",filename, line_no, DECL_DESIGNATION);
-                    return UNEXPECTED_EOF;
-                }
-                line_no++;
-                offset += nread;
+            /*
+                _line now contains only the part after the delimiter, which is the signal
+                that is mapped to the (index)'th output of the subsystem
+            */
+            s->output_mappings[index] = intern(_line, strlen(_line));
+        
+            // also create the actual mapping
+            s->o_maps[index] = arena_alloc(arena, sizeof(Mapping));
 
-                // check that the next line starts with BEGIN 
-                if (!starts_with(line, NETLIST_START)) {
-                    printf("%s:%d: Syntax error! Expected %s, got %s instead\n",filename, line_no, NETLIST_START, line);
-                    return SYNTAX_ERROR;
-                }
+            // create the corresponding mapping
+            str_to_mapping(s->output_mappings[index], s, s->o_maps[index], strlen(s->output_mappings[index]));
 
-                // check that the netlist is of the expected subsystem
-                if  (!starts_with(line+strlen(NETLIST_START), s->name)) {
-                    printf("%s:%d: Syntax error! Expected netlist for subsystem %s, got %s instead\n",filename, line_no, s->name, line);
-                    return SYNTAX_ERROR;
-                }
+        }
 
+        // if it starts with a component declaration, create a component from it and add it to the subsystem
+        else if (starts_with(line, COMP_ID_PREFIX)) {
+            Component *c = arena_alloc(arena, sizeof(Component));
+            if ( (_en=str_to_comp(line, c, strlen(line), lookup_lib, s, 1, &comp_buffer_index)) ) {
+                fprintf(diag_stream(stderr), "%s:%d: component parsing failed\n", filename, *line_no);
+                return _en;
+            }
+            if ( (_en=subsys_add_comp(s, c)) ) return _en;
+        }
 
-                // keep reading lines and parsing them until END ... NETLIST is found
-                while (1) {
+        // if it is an alias (contains the delimiter while not being an output)
+        else if (strstr(line, MAP_DELIM)) {
+            
+            // store a copy of the line to be free to modify it and pass it to split
+            char *_line = line;
+
+            // create an alias
+            Alias *a = arena_alloc(arena, sizeof(Alias));
+            str_to_alias(_line, a, s, strlen(_line));
+            // add that alias to the subsystems aliases list
+            if ( (_en=subsys_add_alias(s, a)) ) return _en;
+        }
 
-                    // read the next line
-                    if ( (nread = read_line_from_file(&line, filename, &len, offset)) == -1 ) {
-                        printf("%s:%d: Error! File ended while %s netlist was pending\n",filename, line_no, s->name);
-                        return UNEXPECTED_EOF;
-                    }
-                    line_no++;
-                    offset += nread;
+        // else it should be an END ... NETLIST line
+        else if (starts_with(line, NETLIST_END)) {
 
-                    // if it starts with something that is an output of the subsystem, it's an output mapping
-                    if ( (index = index_starts_with(line, s->outputs, s->_outputc)) != -1) {
+            // check that the ending netlist is of the current subsystem
+            if  (!starts_with(line+strlen(NETLIST_END), s->name)) {
+                fprintf(diag_stream(stdout), "%s:%d: Syntax error! Expected end of netlist for subsystem %s, got %s instead\n",filename, *line_no, s->name, line);
+                return SYNTAX_ERROR;
+            }
+            break;
+        }
 
-                        char *_line = line;
-                        split(&_line, MAP_DELIM);
+        // if none of the above conditions hold, the line is assumed to be of no interest
+        // to us and is skipped
 
-                        /*
-                            _line now contains only the part after the delimiter, which is the signal
-                            that is mapped to the (index)'th output of the subsystem
-                        */
-                        s->output_mappings[index] = malloc(strlen(_line)+1);
-                        strncpy(s->output_mappings[index], _line, strlen(_line)+1);
-                    
-                        // also create the actual mapping
-                        s->o_maps[index] = malloc(sizeof(Mapping));
+    }
 
-                        // create the corresponding mapping
-                        str_to_mapping(s->output_mappings[index], s, s->o_maps[index], strlen(s->output_mappings[index]));
+    // the above loop only breaks if the netlist ended (otherwise - on error -  it returns)
+    // so reaching here means a whole subsystem has been parsed
+    *sp = s;
 
-                    }
+    return 0;
+}
 
-                    // if it starts with a component declaration, create a component from it and add it to the subsystem
-                    else if (starts_with(line, COMP_ID_PREFIX)) {
-                        Component *c = malloc(sizeof(Component));
-                        if ( (_en=str_to_comp(line, c, strlen(line), lookup_lib, s, 1, comp_buffer_index)) ) {
-                            fprintf(stderr, "%s:%d: component parsing failed\n", filename, line_no);
-                            return _en;
-                        }
-                        if ( (_en=subsys_add_comp(s, c)) ) return _en;
-                    }
+int subsys_lib_from_file(char *filename, Netlist *lib, Netlist *lookup_lib) {
+    
+    if (filename == NULL || lib==NULL) {
+        return NARG;
+    }
+    
+    char *line = NULL;  // belongs to the reader, no need to malloc or free it
+    int line_no = 0;
+    int _en;
 
-                    // if it is an alias (contains the delimiter while not being an output)
-                    else if (strstr(line, MAP_DELIM)) {
-                        
-                        // store a copy of the line to be free to modify it and pass it to split
-                        char *_line = line;
-
-                        // create an alias
-                        Alias *a = malloc(sizeof(Alias));
-                        str_to_alias(_line, a, s, strlen(_line));
-                        // add that alias to the subsystems aliases list
-                        Node *n = malloc(sizeof(Node));
-                        n->type = ALIAS;
-                        n->alias = a;
-                        n->next = NULL;
-                        ll_add(s->aliases, n);
-                    }
+    // open the file once, the lines are read from memory
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return GENERIC_ERROR;
+    }
 
-                    // else it should be an END ... NETLIST line
-                    else if (starts_with(line, NETLIST_END)) {
+    // save the filename
+    lib->file = malloc(strlen(filename)+1);
+    strncpy(lib->file, filename, strlen(filename)+1);
 
-                        // check that the ending netlist is of the current subsystem
-                        if  (!starts_with(line+strlen(NETLIST_END), s->name)) {
-                            printf("%s:%d: Syntax error! Expected end of netlist for subsystem %s, got %s instead\n",filename, line_no, s->name, line);
-                            return SYNTAX_ERROR;
-                        }
-                        break;
-                    }
+    lib->type = SUBSYSTEM;
 
-                    // if none of the above conditions hold, the line is assumed to be of no interest
-                    // to us and is skipped
+    // everything in the library is allocated from its arena
+    lib->arena = arena_init(0);
+    lib->contents = ll_init_in(lib->arena);
+    lib->index = NULL;
+    lib->lazy = NULL;
 
-                }
+    // loop through the lines of the file and get the contents
+    while(lr_next(r, &line) != -1) {
+        
+        line_no++;
+
+        if (strlen(line) != 0) {    // if the line is empty, skip it
+
+            // if a line contains a gate declaration a new subsystem must be parsed
+            if((starts_with(line, DECL_DESIGNATION))) {
 
-                // the above loop only breaks if the netlist ended (otherwise - on error -  it returns)
-                // so reaching here means a whole subsystem has been parsed
+                // parse the whole block of the subsystem
+                Subsystem *s;
+                if ( (_en=subsys_from_lines(r, line, filename, &line_no, lookup_lib, lib->arena, &s)) ) return _en;
 
                 // turn it into a standard
-                Standard *std = malloc(sizeof(Standard));
+                Standard *std = arena_alloc(lib->arena, sizeof(Standard));
                 std->type = SUBSYSTEM;
                 std->subsys = s;
                 std->defined_in = lib;
@@ -793,201 +876,653 @@ int subsys_lib_from_file(char *filename, Netlist *lib, Netlist *lookup_lib) {
 
         }
 
-        free(comp_buffer_index);
-
     }
 
-    free(line);
+    lr_close(r);
 
     return 0;
 }
 
-void free_lib(Netlist *lib) {
+/**
+ * Where the blocks of the subsystems of a library file are, each one from the declaration of
+ * a subsystem up to the next one (see find_subsys_blocks()).
+*/
+typedef struct subsys_blocks {
+    size_t *starts;     // the offset of each block in the file
+    size_t *ends;       // the offset right after each block
+    int *line_nos;      // the line where each block starts
+    char **names;       // the (interned) name of the subsystem of each block
+    int count;          // the number of blocks
+} SubsysBlocks;
 
-    if (lib != NULL) {
+/**
+ * @brief   Find the blocks of the subsystems in the file of the given reader (read from its start to its end).
+*/
+void find_subsys_blocks(LineReader *r, SubsysBlocks *b) {
 
-        // free the contents
-        if (lib->contents != NULL) {
-            ll_free(lib->contents, 1);
-        }
+    char *line = NULL;
+    int line_no = 0;
+    int cap = 64;
 
+    b->starts = malloc(sizeof(size_t) * cap);
+    b->ends = malloc(sizeof(size_t) * cap);
+    b->line_nos = malloc(sizeof(int) * cap);
+    b->names = malloc(sizeof(char*) * cap);
+    b->count = 0;
 
-        // free the filename
-        if (lib->file != NULL) {
-            free(lib->file);
+    size_t pos = 0;
+    while (lr_next(r, &line) != -1) {
+
+        line_no++;
+
+        if (starts_with(line, DECL_DESIGNATION)) {
+
+            if (b->count == cap) {
+                cap *= 2;
+                b->starts = realloc(b->starts, sizeof(size_t) * cap);
+                b->ends = realloc(b->ends, sizeof(size_t) * cap);
+                b->line_nos = realloc(b->line_nos, sizeof(int) * cap);
+                b->names = realloc(b->names, sizeof(char*) * cap);
+            }
+
+            // the name is what lies between the designation and the first delimiter (see str_to_subsys_hdr())
+            char *name = line + strlen(DECL_DESIGNATION);
+            char *delim = strstr(name, GENERAL_DELIM);
+
+            if (b->count > 0) b->ends[b->count-1] = pos;
+            b->starts[b->count] = pos;
+            b->line_nos[b->count] = line_no;
+            b->names[b->count] = intern(name, delim != NULL ? delim-name : strlen(name));
+            b->count++;
         }
 
-        // free the lib itself
-        free(lib);
+        pos = r->pos;
     }
+    if (b->count > 0) b->ends[b->count-1] = r->size;
 }
 
-int str_to_comp(char *str, Component *c, int n, Netlist *lib, Subsystem *s, int is_standard, int *buffer_index) {
+/**
+ * @brief   Free the lists of the given blocks.
+*/
+void free_subsys_blocks(SubsysBlocks *b) {
+    free(b->starts);
+    free(b->ends);
+    free(b->line_nos);
+    free(b->names);
+}
 
-    if (str==NULL || c==NULL) {
-        return NARG;
-    }
+/**
+ * @brief   Parse the i'th block of a file (whose contents are data) into a new subsystem, allocated from the given arena (see subsys_from_lines()).
+*/
+int subsys_from_block(char *filename, char *data, SubsysBlocks *b, int i, Netlist *lookup_lib, Arena *arena, Subsystem **sp) {
 
-    // skip the ID prefix
-    char *_str = str+strlen(COMP_ID_PREFIX);
+    // read the block on its own, as if it was a file that starts with the declaration
+    char *line = NULL;
+    int line_no = b->line_nos[i];
+    LineReader *r = lr_from_memory(data + b->starts[i], b->ends[i] - b->starts[i]);
+    lr_next(r, &line);
+    int _en = subsys_from_lines(r, line, filename, &line_no, lookup_lib, arena, sp);
+    lr_close(r);
 
-    // read the fields
-    char *_id         = split(&_str, COMP_DELIM);
-    char *_name       = split(&_str, COMP_DELIM);
-    char *_raw_inputs = _str;
+    return _en;
+}
 
-    // add the id to the component
-    c->id = atoi(_id);
+/**
+ * @brief   Point the given subsystem (and its lists) at the given arena, once the arena that it was allocated
+ *          from has been merged into it (see arena_merge(), which frees the merged arena).
+*/
+void subsys_move_to_arena(Subsystem *s, Arena *arena) {
 
-    // check if the name of the component is a known one
-    Standard *std = find_in_lib(lib, _name);
-    if (std == NULL) {
-        printf("Could not find component '%s' in library %s\n", _name, lib->file);
-        return UNKNOWN_COMP;
+    s->arena = arena;
+    s->components->arena = arena;
+    if (s->aliases != NULL) {
+        s->aliases->arena = arena;
     }
-    c->prototype = std;
+}
 
-    // parse the inputs into the component
-    c->inputs = NULL;   // initialize to NULL so initial call to realloc is like malloc
-    c->_inputc = str_to_list(_raw_inputs, &(c->inputs), IN_OUT_DELIM);
+/**
+ * A task of a pool of threads (see run_pool()): run task number t with ctx, allocating from the arena of the
+ * thread that runs it. local is kept per thread, it starts as NULL and the task may keep anything there.
+*/
+typedef void (*PoolTask)(void *ctx, int t, Arena *arena, void **local);
 
-    c->is_standard=is_standard;
+/**
+ * What the threads of run_pool() share: the tasks and the next one to be run.
+*/
+typedef struct work_pool {
+    void *ctx;              // what every task is run with
+    PoolTask task;          // the task
+    void (*done)(void *ctx, void *local);   // called by each thread with its local once there are no tasks left (may be NULL)
+    int taskc;              // the number of tasks
+    Arena *arena;           // where each thread hands its own arena over to when it is done (NULL if the tasks allocate nothing)
+    int next;               // the next task that will be picked up by a thread
+    pthread_mutex_t lock;   // protects next and arena
+} WorkPool;
 
-    // set the buffer index and increment it
-    c->buffer_index = (*buffer_index);
-    (*buffer_index)++;
+/**
+ * @brief   The body of each thread of run_pool(): keep picking up tasks until there are none left.
+*/
+void *pool_worker(void *arg) {
 
-    // if needed, take care of the input mappings
-    if ( (s!=NULL) && is_standard ) {
-        
-        // allocate space for the list
-        c->i_maps = malloc(sizeof(Mapping*) * c->_inputc);
+    WorkPool *pool = (WorkPool*) arg;
 
-        // create each individual mapping
-        for (int i=0; i<c->_inputc; i++) {
+    // every thread allocates from an arena of its own, no locking needed
+    Arena *arena = pool->arena != NULL ? arena_init(0) : NULL;
+    void *local = NULL;
 
-            // allocate space for each individual mapping
-            c->i_maps[i] = malloc(sizeof(Mapping));
+    while (1) {
 
-            // find it
-            int _en;
-            if ( (_en=str_to_mapping(c->inputs[i], s, c->i_maps[i], strlen(c->inputs[i]))) ) return _en;
+        // pick up the next task
+        pthread_mutex_lock(&(pool->lock));
+        int t = pool->next++;
+        pthread_mutex_unlock(&(pool->lock));
 
+        if (t >= pool->taskc) {
+            break;
         }
-    }
-
-    return 0;
-}
 
-int subsys_add_comp(Subsystem *s, Component *c) {
-    
-    if (s==NULL || c==NULL) {
-        return NARG;
+        pool->task(pool->ctx, t, arena, &local);
     }
 
-    // make the component into a node
-    Node *n = malloc(sizeof(Node));
-    n->type = COMPONENT;
-    n->comp = c;
-    n->next = NULL;
+    if (pool->done != NULL) {
+        pool->done(pool->ctx, local);
+    }
 
-    // add the new node to the subsystem
-    return ll_add(s->components, n);
+    // what the tasks allocated stays where it is, but the given arena now owns it
+    if (arena != NULL) {
+        pthread_mutex_lock(&(pool->lock));
+        arena_merge(pool->arena, arena);
+        pthread_mutex_unlock(&(pool->lock));
+    }
 
+    return NULL;
 }
 
-Node *move_in_list(int x, LList* list) {
+/**
+ * @brief   Run taskc tasks on (at most) the given number of threads and wait for all of them to finish. If no thread
+ *          can be started, the calling thread runs them all, and if only some can, those run them all.
+*/
+void run_pool(void *ctx, PoolTask task, void (*done)(void *ctx, void *local), int taskc, int threads, Arena *arena) {
+
+    WorkPool pool;
+    pool.ctx = ctx;
+    pool.task = task;
+    pool.done = done;
+    pool.taskc = taskc;
+    pool.arena = arena;
+    pool.next = 0;
+    pthread_mutex_init(&(pool.lock), NULL);
+
+    if (threads > taskc) threads = taskc;
+    pthread_t *workers = malloc(sizeof(pthread_t) * (threads+1));
+    int started = 0;
+    while (started < threads && pthread_create(&(workers[started]), NULL, pool_worker, &pool) == 0) {
+        started++;
+    }
 
-    // move x positions in the list as long as they are valid
-    Node *tmp = list->head;
-    while(x > 0) {
-        if (tmp == NULL) return NULL;
-        tmp = tmp->next;
-        x--;
+    if (started == 0) {
+        pool_worker(&pool);
+    }
+    for (int t=0; t<started; t++) {
+        pthread_join(workers[t], NULL);
     }
 
-    return tmp;
+    pthread_mutex_destroy(&(pool.lock));
+    free(workers);
 }
 
-int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int starting_index) {
+/**
+ * What parsing a block printed, to stdout and to stderr (see diag_stream()).
+*/
+typedef struct parse_msgs {
+    char *out;          // what went to stdout
+    size_t out_len;     // its length
+    char *err;          // what went to stderr
+    size_t err_len;     // its length
+} ParseMsgs;
 
-    if (std==NULL || inputs==NULL) {
-        return NARG;
-    }
+/**
+ * The work that the threads of subsys_lib_from_file_parallel() share: the blocks of the file
+ * and what each one was parsed into.
+*/
+typedef struct parse_pool {
+    char *filename;         // the file that is parsed (for the error messages)
+    Netlist *lookup_lib;    // where the components are looked up
+    char *data;             // the contents of the file
+    SubsysBlocks blocks;    // where each block is in data
+    Subsystem **subsystems; // what each block was parsed into
+    int *results;           // what subsys_from_lines() returned for each block
+    ParseMsgs *msgs;        // what parsing each block printed, printed in the order of the file once all are parsed
+} ParsePool;
 
-    if (std->type != SUBSYSTEM) {
-        return NARG;
-    }
+/**
+ * @brief   Parse block b for subsys_lib_from_file_parallel() (see run_pool()).
+*/
+void parse_task(void *ctx, int b, Arena *arena, void **local) {
+
+    ParsePool *pool = (ParsePool*) ctx;
+
+    // keep what the parser prints for this block, the blocks after the first one that fails are not printed
+    ParseMsgs *m = &(pool->msgs[b]);
+    parse_out = open_memstream(&(m->out), &(m->out_len));
+    parse_err = open_memstream(&(m->err), &(m->err_len));
+
+    pool->results[b] = subsys_from_block(pool->filename, pool->data, &(pool->blocks), b, pool->lookup_lib, arena, &(pool->subsystems[b]));
+
+    fclose(parse_out);
+    fclose(parse_err);
+    parse_out = parse_err = NULL;
+}
+
+int subsys_lib_from_file_parallel(char *filename, Netlist *lib, Netlist *lookup_lib, int threads) {
+
+    // looking up anything in a lazily loaded library may parse more of it, so only one thread can do it
+    if (threads <= 1 || (lookup_lib != NULL && lookup_lib->lazy != NULL)) {
+        return subsys_lib_from_file(filename, lib, lookup_lib);
+    }
+
+    if (filename == NULL || lib==NULL || lookup_lib==NULL) {
+        return NARG;
+    }
+
+    int _en = 0;
+
+    // the file is opened once and shared by the threads
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    lib->file = malloc(strlen(filename)+1);
+    strncpy(lib->file, filename, strlen(filename)+1);
+    lib->type = SUBSYSTEM;
+    lib->arena = arena_init(0);
+    lib->contents = ll_init_in(lib->arena);
+    lib->index = NULL;
+    lib->lazy = NULL;
+
+    // find the blocks
+    ParsePool pool;
+    find_subsys_blocks(r, &(pool.blocks));
+    int blockc = pool.blocks.count;
+
+    // the threads only read the lookup library, so the indexes that are built on first use are built now
+    for (Node *n=lookup_lib->contents->head; n!=NULL; n=n->next) {
+        if (n->type == STANDARD && n->std->type == SUBSYSTEM) {
+            subsys_index_signals(n->std->subsys);
+        }
+    }
+
+    pool.filename = filename;
+    pool.lookup_lib = lookup_lib;
+    pool.data = r->data;
+    pool.subsystems = malloc(sizeof(Subsystem*) * (blockc+1));
+    pool.results = malloc(sizeof(int) * (blockc+1));
+    memset(pool.subsystems, 0, sizeof(Subsystem*) * (blockc+1));
+    pool.msgs = malloc(sizeof(ParseMsgs) * (blockc+1));
+    memset(pool.msgs, 0, sizeof(ParseMsgs) * (blockc+1));
+
+    // parse the blocks, the subsystems end up in the arena of the library
+    run_pool(&pool, parse_task, NULL, blockc, threads, lib->arena);
+
+    // add the subsystems to the library in the order of the file, up to the first error
+    for (int b=0; b<blockc; b++) {
+
+        // print what the serial parser would have printed: the messages of every block up to the first one that fails
+        if (!_en) {
+            fwrite(pool.msgs[b].out, 1, pool.msgs[b].out_len, stdout);
+            fwrite(pool.msgs[b].err, 1, pool.msgs[b].err_len, stderr);
+        }
+        free(pool.msgs[b].out);
+        free(pool.msgs[b].err);
+
+        if (!_en && pool.results[b]) {
+            _en = pool.results[b];
+        }
+
+        if (_en) {
+            if (!pool.results[b]) free_subsystem(pool.subsystems[b], 1);
+            continue;
+        }
+
+        // its thread's arena is now part of the library's one
+        subsys_move_to_arena(pool.subsystems[b], lib->arena);
+
+        Standard *std = arena_alloc(lib->arena, sizeof(Standard));
+        std->type = SUBSYSTEM;
+        std->subsys = pool.subsystems[b];
+        std->defined_in = lib;
+        _en = add_to_lib(lib, std, 1, SUBSYSTEM);
+    }
+
+    // cleanup
+    free_subsys_blocks(&(pool.blocks));
+    free(pool.subsystems);
+    free(pool.results);
+    free(pool.msgs);
+    lr_close(r);
+
+    return _en;
+}
+
+/**
+ * The subsystems of a lazily loaded library that are not parsed yet (see subsys_lib_open_lazy()).
+*/
+typedef struct lazy_lib {
+    char *filename;         // the file of the library (for the error messages)
+    Netlist *lookup_lib;    // where the components are looked up
+    LineReader *r;          // the contents of the file, kept for as long as the library
+    SubsysBlocks blocks;    // where each block is in the file
+    Index *by_name;         // the first block of every subsystem name
+    char *state;            // for each block: 0 if it is not parsed, 1 while it is being parsed, 2 once it is parsed (or failed to)
+    int *errors;            // for each block: the error code that parsing it returned (0 if it is not parsed or it was parsed)
+} LazyLib;
+
+/**
+ * @brief   Parse the block of the subsystem with the given (interned) name of a lazily loaded library and
+ *          add it to the library. Return its standard, NULL if there is no such block or it cannot be parsed.
+*/
+Standard *lazy_load(Netlist *lib, char *sym) {
+
+    LazyLib *l = lib->lazy;
+    IndexEntry *e = index_get(l->by_name, sym_id(sym));
+
+    // a block that is being parsed is needed by one of its own components (a cycle), the component is rejected
+    if (e == NULL || l->state[e->pos] != 0) {
+        return NULL;
+    }
+
+    // anything that this block needs from its lookup library is loaded (if that is lazy too) as it is parsed
+    Subsystem *s;
+    l->state[e->pos] = 1;
+    int _en = subsys_from_block(l->filename, l->r->data, &(l->blocks), e->pos, l->lookup_lib, lib->arena, &s);
+    l->state[e->pos] = 2;
+    if (_en) {
+        l->errors[e->pos] = _en;
+        return NULL;
+    }
+
+    Standard *std = arena_alloc(lib->arena, sizeof(Standard));
+    std->type = SUBSYSTEM;
+    std->subsys = s;
+    std->defined_in = lib;
+    add_to_lib(lib, std, 1, SUBSYSTEM);
+
+    return std;
+}
+
+/**
+ * @brief   Free what a lazily loaded library keeps to parse the rest of its subsystems.
+*/
+void free_lazy_lib(LazyLib *l) {
+
+    if (l != NULL) {
+        free_subsys_blocks(&(l->blocks));
+        free_index(l->by_name);
+        free(l->state);
+        free(l->errors);
+        lr_close(l->r);
+        free(l);
+    }
+}
+
+int subsys_lib_open_lazy(char *filename, Netlist *lib, Netlist *lookup_lib) {
+
+    if (filename == NULL || lib==NULL || lookup_lib==NULL) {
+        return NARG;
+    }
+
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    lib->file = malloc(strlen(filename)+1);
+    strncpy(lib->file, filename, strlen(filename)+1);
+    lib->type = SUBSYSTEM;
+    lib->arena = arena_init(0);
+    lib->contents = ll_init_in(lib->arena);
+    lib->index = NULL;
+    lib->lazy = NULL;
+
+    // only the declarations are read to find the blocks, nothing is parsed yet
+    LazyLib *l = malloc(sizeof(LazyLib));
+    l->filename = lib->file;
+    l->lookup_lib = lookup_lib;
+    l->r = r;
+    find_subsys_blocks(r, &(l->blocks));
+    l->by_name = index_init(l->blocks.count);
+    for (int b=0; b<l->blocks.count; b++) {
+        index_put(l->by_name, sym_id(l->blocks.names[b]), b, NULL);
+    }
+    l->state = malloc(l->blocks.count+1);
+    memset(l->state, 0, l->blocks.count+1);
+    l->errors = malloc(sizeof(int)*(l->blocks.count+1));
+    memset(l->errors, 0, sizeof(int)*(l->blocks.count+1));
+    lib->lazy = l;
+
+    return 0;
+}
+
+int lazy_lib_error(Netlist *lib, char *name) {
+
+    if (lib == NULL || name == NULL) {
+        return NARG;
+    }
+
+    char *sym = sym_lookup(name, strlen(name));
+    if (lib->lazy == NULL || sym == NULL) {
+        return 0;
+    }
+
+    IndexEntry *e = index_get(lib->lazy->by_name, sym_id(sym));
+
+    return e != NULL ? lib->lazy->errors[e->pos] : 0;
+}
+
+void free_lib(Netlist *lib) {
+
+    if (lib != NULL) {
+
+        // free the contents (with an arena, only what the subsystems keep out of it needs to be freed)
+        if (lib->contents != NULL) {
+            if (lib->arena != NULL) {
+                for (Node *n=lib->contents->head; n!=NULL; n=n->next) {
+                    if (n->type == STANDARD && n->std->type == SUBSYSTEM) {
+                        free_subsystem(n->std->subsys, 1);
+                    } else if (n->type == SUBSYSTEM_N) {
+                        free_subsystem(n->subsys, 1);
+                    }
+                }
+            }
+            ll_free(lib->contents, 1);
+        }
+
+
+        // free the filename
+        if (lib->file != NULL) {
+            free(lib->file);
+        }
+
+        // free the index of the standards
+        free_index(lib->index);
+
+        // free what is kept to parse the rest of a lazily loaded library
+        free_lazy_lib(lib->lazy);
+
+        // free everything that was allocated from the arena at once
+        arena_free(lib->arena);
+
+        // free the lib itself
+        free(lib);
+    }
+}
+
+int str_to_comp(char *str, Component *c, int n, Netlist *lib, Subsystem *s, int is_standard, int *buffer_index) {
+
+    if (str==NULL || c==NULL) {
+        return NARG;
+    }
+
+    // skip the ID prefix
+    char *_str = str+strlen(COMP_ID_PREFIX);
+
+    // read the fields
+    char *_id         = split(&_str, COMP_DELIM);
+    char *_name       = split(&_str, COMP_DELIM);
+    char *_raw_inputs = _str;
+
+    // add the id to the component
+    c->id = atoi(_id);
+
+    // check if the name of the component is a known one
+    Standard *std = find_in_lib(lib, _name);
+    if (std == NULL) {
+        fprintf(diag_stream(stdout), "Could not find component '%s' in library %s\n", _name, lib->file);
+        return UNKNOWN_COMP;
+    }
+    c->prototype = std;
+
+    // parse the inputs into the component
+    Arena *arena = s != NULL ? s->arena : NULL;
+    c->_inputc = str_to_sym_list(_raw_inputs, &(c->inputs), IN_OUT_DELIM, arena);
+
+    c->is_standard=is_standard;
+
+    // set the buffer index and increment it
+    c->buffer_index = (*buffer_index);
+    (*buffer_index)++;
+
+    // if needed, take care of the input mappings
+    if ( (s!=NULL) && is_standard ) {
+        
+        // allocate space for the list
+        c->i_maps = alloc_in(arena, sizeof(Mapping*) * c->_inputc);
+
+        // create each individual mapping
+        for (int i=0; i<c->_inputc; i++) {
+
+            // allocate space for each individual mapping
+            c->i_maps[i] = alloc_in(arena, sizeof(Mapping));
+
+            // find it
+            int _en;
+            if ( (_en=str_to_mapping(c->inputs[i], s, c->i_maps[i], strlen(c->inputs[i]))) ) return _en;
+
+        }
+    }
+
+    return 0;
+}
+
+int subsys_add_comp(Subsystem *s, Component *c) {
+    
+    if (s==NULL || c==NULL) {
+        return NARG;
+    }
+
+    // make the component into a node
+    Node *n = alloc_in(s->components->arena, sizeof(Node));
+    n->type = COMPONENT;
+    n->comp = c;
+    n->next = NULL;
+
+    // index it by id (its position is the number of components before it)
+    if (s->comp_index == NULL) {
+        s->comp_index = index_init(0);
+    }
+    index_put(s->comp_index, c->id, s->components->size, n);
+
+    // the store and the template no longer have all of the components
+    free_comp_store(s->store);
+    s->store = NULL;
+    free_flat_template(s->tmpl);
+    s->tmpl = NULL;
+
+    // add the new node to the subsystem
+    return ll_add(s->components, n);
+
+}
+
+Node *move_in_list(int x, LList* list) {
+
+    // move x positions in the list as long as they are valid
+    Node *tmp = list->head;
+    while(x > 0) {
+        if (tmp == NULL) return NULL;
+        tmp = tmp->next;
+        x--;
+    }
+
+    return tmp;
+}
+
+int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int starting_index) {
+
+    if (std==NULL || inputs==NULL) {
+        return NARG;
+    }
+
+    if (std->type != SUBSYSTEM) {
+        return NARG;
+    }
 
     int _en=0;
 
-    // copy the name, inputs and outputs of the standard into ns
-    ns->name = malloc(strlen(std->subsys->name)+1);
-    ns->components = ll_init();
+    // copy the name, inputs and outputs of the standard into ns (the names are interned, only the lists are new)
+    ns->name = std->subsys->name;
+    ns->components = ll_init_in(ns->arena);
     ns->aliases = NULL;
-    strncpy(ns->name, std->subsys->name, strlen(std->subsys->name)+1);
-
+    ns->program = NULL;
+    ns->comp_index = ns->input_index = ns->output_index = ns->alias_index = NULL;
+    ns->store = NULL;
+    ns->tmpl = NULL;
+    ns->model = NULL;
 
     ns->_inputc = std->subsys->_inputc;
-    ns->inputs = malloc(sizeof(char*) * std->subsys->_inputc);
-    for(int i=0; i<std->subsys->_inputc; i++) {
-        ns->inputs[i] = malloc(strlen(inputs[i])+1);
-        strncpy(ns->inputs[i], inputs[i], strlen(inputs[i])+1);
-    }
+    sym_list_copy(&(ns->inputs), inputs, std->subsys->_inputc, ns->arena);
 
     ns->_outputc = std->subsys->_outputc;
-    ns->outputs = malloc(sizeof(char*) * std->subsys->_outputc);
-    for(int i=0; i<std->subsys->_outputc; i++) {
-        ns->outputs[i] = malloc(strlen(std->subsys->outputs[i])+1);
-        strncpy(ns->outputs[i], std->subsys->outputs[i], strlen(std->subsys->outputs[i])+1);
-    }
+    sym_list_copy(&(ns->outputs), std->subsys->outputs, std->subsys->_outputc, ns->arena);
 
     // mark the new subsystem as non-standard
     ns->is_standard = 0;
 
-    // loop through the components of the prototype
+    // loop through the components of the prototype (in its store, where their mappings are back to back)
     int comp_id = starting_index;
-    Node *cur = std->subsys->components->head;
-    while (cur != NULL) {
+    CompStore *st = subsys_store(std->subsys);
+    for (int k=0; k<st->compc; k++) {
+
+        int inputc = st->fanin_start[k+1] - st->fanin_start[k];
 
         // allocate memory for the component
-        Component *comp = malloc(sizeof(Component));
+        Component *comp = alloc_in(ns->arena, sizeof(Component));
         comp->id = comp_id;
         comp->is_standard = 0;
-        comp->prototype = cur->comp->prototype;
+        comp->prototype = st->protos[k];
 
         // allocate memory for the inputs of the component
-        comp->inputs = malloc(sizeof(char*) * cur->comp->_inputc);
-        comp->_inputc = cur->comp->_inputc;
+        comp->inputs = alloc_in(ns->arena, sizeof(char*) * inputc);
+        comp->_inputc = inputc;
 
         // create the inputs according to the prototype's mappings
-        for (int i=0; i<cur->comp->_inputc; i++) {
+        for (int i=0; i<inputc; i++) {
             
             // find the mapping
-            Mapping *map = cur->comp->i_maps[i];
+            Mapping *map = st->fanin + st->fanin_start[k] + i;
 
             // check the type of the mapping and act accordingly
             if (map->type == SUBSYS_INPUT) {
 
                 // find the input that the mapping maps to and put its name in the corresponding slot
-                comp->inputs[i] = malloc(strlen(ns->inputs[map->index])+1);
-                strncpy(comp->inputs[i], ns->inputs[map->index], strlen(ns->inputs[map->index])+1);
+                comp->inputs[i] = ns->inputs[map->index];
 
             } else if (map->type == SUBSYS_COMP) {
 
-                // find the component that the mapping maps to
-                Component *cmap = move_in_list(map->index, ns->components)->comp;
-
-                // allocate memory for the input in the component
-                comp->inputs[i] = malloc(digits(cmap->id)+2); // +1 for the U, +1 for the null byte
-                int offset=0;
-
-                // write the ID prefix
-                if ( (_en=write_at(comp->inputs[i], COMP_ID_PREFIX, offset, strlen(COMP_ID_PREFIX))) ) return _en;
-                offset += strlen(COMP_ID_PREFIX);
-
-                // write the mapping component's ID
-                snprintf(comp->inputs[i]+offset, digits(cmap->id)+2-offset, "%d ", cmap->id);
+                // the component at that position was created with the id that follows the starting one by as much
+                char b[MAX_LINE_LEN];
+                snprintf(b, MAX_LINE_LEN, "%s%d", COMP_ID_PREFIX, starting_index + map->index);
+                comp->inputs[i] = intern(b, strlen(b));
 
             }
 
@@ -996,13 +1531,12 @@ int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int s
         if ( (_en=subsys_add_comp(ns, comp)) ) {
             return _en;
         }
-        // advance the current node in the prototype's list and increment the ID
-        cur = cur->next;
+        // increment the ID
         comp_id++;
     }
 
     // also take care of the output mappings of the subsystem
-    ns->output_mappings = malloc(sizeof(char*) * std->subsys->_outputc);
+    ns->output_mappings = alloc_in(ns->arena, sizeof(char*) * std->subsys->_outputc);
     
     for(int i=0; i<std->subsys->_outputc; i++) {
 
@@ -1013,33 +1547,31 @@ int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int s
         if (map->type == SUBSYS_INPUT) {
 
             // find the input that the mapping maps to and put its name in the corresponding slot
-            ns->output_mappings[i] = malloc(strlen(ns->output_mappings[map->index])+1);
-            strncpy(ns->output_mappings[i], ns->output_mappings[map->index], strlen(ns->output_mappings[map->index])+1);
+            ns->output_mappings[i] = ns->inputs[map->index];
 
         } else if (map->type == SUBSYS_COMP) {
 
-            // find the component that the mapping maps to
-            Component *cmap = move_in_list(map->index, ns->components)->comp;
-
-            // allocate memory for the output mapping
-            ns->output_mappings[i] = malloc(digits(cmap->id)+2); // +1 for the U, +1 for the null byte
-            int offset=0;
-
-            // write the ID prefix
-            if ( (_en=write_at(ns->output_mappings[i], COMP_ID_PREFIX, offset, strlen(COMP_ID_PREFIX))) ) return _en;
-            offset += strlen(COMP_ID_PREFIX);
-
-            // write the mapping component's ID
-            snprintf(ns->output_mappings[i]+offset, digits(cmap->id)+2-offset, "%d ", cmap->id);
+            // the output is the ID of the component at that position (see above)
+            char b[MAX_LINE_LEN];
+            snprintf(b, MAX_LINE_LEN, "%s%d", COMP_ID_PREFIX, starting_index + map->index);
+            ns->output_mappings[i] = intern(b, strlen(b));
         }
     }
 
     return comp_id;
 }
 
-void lib_to_file(Netlist *lib, char *filename, char *mode) {
+int lib_to_file(Netlist *lib, char *filename, char *mode) {
+
+    if (lib == NULL || filename == NULL || mode == NULL) {
+        return NARG;
+    }
 
     FILE *fp = fopen(filename, mode);
+    if (fp == NULL) {
+        perror("fopen");
+        return GENERIC_ERROR;
+    }
 
     // iterate through the contents of the library and print them
     for (Node *n = lib->contents->head; n!=NULL; n=n->next) {
@@ -1061,27 +1593,27 @@ void lib_to_file(Netlist *lib, char *filename, char *mode) {
         } else {
 
             // print the header line
-            char *buf = malloc(MAX_LINE_LEN);
-            subsys_hdr_to_str(n->std->subsys, buf, MAX_LINE_LEN);
+            int hdr_size = subsys_hdr_size(n->std->subsys);
+            char *buf = malloc(hdr_size);
+            subsys_hdr_to_str(n->std->subsys, buf, hdr_size);
             fprintf(fp, "%s\n", buf);
             free(buf);
 
             // print the BEGIN ... NETLIST line
             fprintf(fp, "BEGIN %s NETLIST\n", n->std->subsys->name);
 
-            // print the components
-            for (Node *n_n=n->std->subsys->components->head; n_n!=NULL; n_n=n_n->next) {
-
-                Component *comp = n_n->comp;
+            // print the components (from their store, in order)
+            CompStore *st = subsys_store(n->std->subsys);
+            for (int k=0; k<st->compc; k++) {
 
                 // print the component's ID and name
-                fprintf(fp, "U%d %s ", comp->id, comp->prototype->gate->name);
+                fprintf(fp, "U%d %s ", st->ids[k], st->protos[k]->gate->name);
 
                 // print the component's inputs (as resolved mappings)
-                for (int i=0; i<comp->_inputc; i++) {
+                for (int f=st->fanin_start[k]; f<st->fanin_start[k+1]; f++) {
 
                     // get the mapping
-                    Mapping *m = comp->i_maps[i];
+                    Mapping *m = st->fanin + f;
 
                     // resolve it
                     char *b = resolve_mapping(m, n->std->subsys);
@@ -1090,7 +1622,7 @@ void lib_to_file(Netlist *lib, char *filename, char *mode) {
                     fprintf(fp, "%s", b);
 
                     // leave some space before the next one if needed
-                    if ( !(i==comp->_inputc-1) ) {
+                    if ( !(f==st->fanin_start[k+1]-1) ) {
                         fprintf(fp, " ");
                     }
 
@@ -1130,6 +1662,7 @@ void lib_to_file(Netlist *lib, char *filename, char *mode) {
 
     fclose(fp);
 
+    return 0;
 }
 
 void subsystem_to_file(Subsystem *s, char *filename, char *mode) {
@@ -1146,16 +1679,18 @@ void subsystem_to_file(Subsystem *s, char *filename, char *mode) {
     if (starts_with(mode, "a")) fprintf(fp, "\n");
 
     // write the declaration line
-    char *line = malloc(MAX_LINE_LEN);
-    subsys_hdr_to_str(s, line, MAX_LINE_LEN);
+    int hdr_size = subsys_hdr_size(s);
+    char *line = malloc(hdr_size);
+    subsys_hdr_to_str(s, line, hdr_size);
     fprintf(fp, "%s\n", line);
 
     // write the "BEGIN NETLIST" line
     fprintf(fp, "BEGIN %s NETLIST\n", s->name);
 
     // write the components
-    for (Node *c=s->components->head; c!=NULL; c=c->next) {
-        comp_to_str(c->comp, line, MAX_LINE_LEN);
+    CompStore *st = subsys_store(s);
+    for (int k=0; k<st->compc; k++) {
+        comp_to_str(st->comps[k], line, MAX_LINE_LEN);
         fprintf(fp, "%s\n", line);
     }
 
@@ -1175,16 +1710,18 @@ void subsystem_to_file(Subsystem *s, char *filename, char *mode) {
 void s2f(Subsystem *s, FILE *fp) {
 
     // write the declaration line
-    char *line = malloc(MAX_LINE_LEN);
-    subsys_hdr_to_str(s, line, MAX_LINE_LEN);
+    int hdr_size = subsys_hdr_size(s);
+    char *line = malloc(hdr_size);
+    subsys_hdr_to_str(s, line, hdr_size);
     fprintf(fp, "%s\n", line);
 
     // write the "BEGIN NETLIST" line
     fprintf(fp, "BEGIN %s NETLIST\n", s->name);
 
     // write the components
-    for (Node *c=s->components->head; c!=NULL; c=c->next) {
-        comp_to_str(c->comp, line, MAX_LINE_LEN);
+    CompStore *st = subsys_store(s);
+    for (int k=0; k<st->compc; k++) {
+        comp_to_str(st->comps[k], line, MAX_LINE_LEN);
         fprintf(fp, "%s\n", line);
     }
 
@@ -1255,23 +1792,24 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
     // init variables that will be used in the resolution
     int input_index = -1, comp_index = -1, output_index = -1;
     Node *mapping_node;
+    Alias *alias;
     char *last = NULL;
 
     // keep the name of the referenced signal (the part after the delim)        
     char *referenced_signal = str;
 
     // find if it is an input, an alias or a component('s output) and proceed accordingly
-    if ( (input_index=contains(subsys->_inputc, subsys->inputs, referenced_signal)) != -1 ) {
+    if ( (input_index=subsys_input(subsys, referenced_signal)) != -1 ) {
 
         // then the mapping refers to one of the subsystem's inputs
         m->type = SUBSYS_INPUT;
         m->index = input_index;
         m->out_index = -1;
 
-    } else if ( (mapping_node = search_in_llist(subsys->aliases, ALIAS, referenced_signal, strlen(referenced_signal), -1, NULL)) != NULL) {
+    } else if ( (alias = subsys_find_alias(subsys, referenced_signal)) != NULL) {
 
         // then the mapping refers to another mapping (an alias)
-        Mapping *other_mapping = mapping_node->alias->mapping;
+        Mapping *other_mapping = alias->mapping;
 
         // copy everything over (note that this allows us to have an arbitrary number of aliases referring to other aliases without any fancy recursion but uses more memory. this is a possible TODO)
         m->type = other_mapping->type;
@@ -1289,14 +1827,14 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
         int id = strtol(referenced_signal+1, &last, 10);  // strtol is amazing - https://man7.org/linux/man-pages/man3/strtol.3.html
 
         // find the component with that id
-        if ( (mapping_node=search_in_llist(subsys->components, COMPONENT, NULL, -1, id, &comp_index)) == NULL) {
-            printf("could not find component '%s%d' in subsystem '%s' (referenced as a mapping in '%s'\n)", COMP_ID_PREFIX, id, subsys->name, referenced_signal);
+        if ( (mapping_node=subsys_find_comp(subsys, id, &comp_index)) == NULL) {
+            fprintf(diag_stream(stdout), "could not find component '%s%d' in subsystem '%s' (referenced as a mapping in '%s'\n)", COMP_ID_PREFIX, id, subsys->name, referenced_signal);
             return UNKNOWN_COMP;
         }
 
         // check that strtol worked properly and read some number
         if (last == referenced_signal) {
-            fprintf(stderr, "error on resolving mapping '%s'\n", referenced_signal);
+            fprintf(diag_stream(stderr), "error on resolving mapping '%s'\n", referenced_signal);
             return GENERIC_ERROR;
         }
         
@@ -1309,13 +1847,13 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
 
             // check that there is nothing after the component number (for example its not U35FOO)
             if (last[0] != 0) {
-                fprintf(stderr, "invalid reference to '%s'\n", referenced_signal);
+                fprintf(diag_stream(stderr), "invalid reference to '%s'\n", referenced_signal);
                 return GENERIC_ERROR;
             }
 
             // if this is not a gate, there should be an output specified
             if (comp->prototype->type != GATE) {
-                fprintf(stderr, "reference to '%s' which is a subsystem, but no output specified\n", referenced_signal);
+                fprintf(diag_stream(stderr), "reference to '%s' which is a subsystem, but no output specified\n", referenced_signal);
                 return GENERIC_ERROR;
             }
 
@@ -1326,7 +1864,7 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
 
             // check that the referenced subsystem is not a gate (gates dont have outputs)            
             if (comp->prototype->type == GATE) {
-                fprintf(stderr, "the input refers to a specific output of component '%s%d' which is a gate (%s)\n", COMP_ID_PREFIX, id, comp->prototype->gate->name);
+                fprintf(diag_stream(stderr), "the input refers to a specific output of component '%s%d' which is a gate (%s)\n", COMP_ID_PREFIX, id, comp->prototype->gate->name);
                 return GENERIC_ERROR;
             }
 
@@ -1334,8 +1872,8 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
             char *output_name = last+1;    // skip the underscore and go right to the output name ('_COUT' -> 'COUT')
 
             // look for the of the output in the outputs of the component
-            if ( (output_index = contains(comp->prototype->subsys->_outputc, comp->prototype->subsys->outputs, output_name)) == -1) {
-                fprintf(stderr, "the input refers to output '%s' of component '%s%d' but type '%s' has no such output\n", output_name, COMP_ID_PREFIX, id, comp->prototype->subsys->name);
+            if ( (output_index = subsys_output(comp->prototype->subsys, output_name)) == -1) {
+                fprintf(diag_stream(stderr), "the input refers to output '%s' of component '%s%d' but type '%s' has no such output\n", output_name, COMP_ID_PREFIX, id, comp->prototype->subsys->name);
                 return GENERIC_ERROR;
             }
 
@@ -1345,7 +1883,7 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n) {
         }
 
     } else {    // error
-        fprintf(stderr, "input refers to '%s' but it couldn't be resolved into an input, other component or alias!\n", referenced_signal);
+        fprintf(diag_stream(stderr), "input refers to '%s' but it couldn't be resolved into an input, other component or alias!\n", referenced_signal);
         return GENERIC_ERROR;
     }
 
@@ -1392,34 +1930,39 @@ char* resolve_mapping(Mapping *m, Subsystem *s) {
 
     } else if (m->type == SUBSYS_COMP) {
 
-        // find the node of the component that the mapping refers to
-        Node *rtcn = move_in_list(m->index, s->components);    // referred-to component node
+        // find the component that the mapping refers to (by its position)
+        CompStore *st = subsys_store(s);
+        if (m->index < 0 || m->index >= st->compc) {
+            return NULL;
+        }
+        int id = st->ids[m->index];
+        Standard *proto = st->protos[m->index];
         
         // resolve the mapping according to its type
-        if (rtcn->comp->prototype->type == GATE) {
+        if (proto->type == GATE) {
 
             // allocate as much memory as we need
-            b = malloc(strlen(COMP_ID_PREFIX)+digits(rtcn->comp->id)+1);
+            b = malloc(strlen(COMP_ID_PREFIX)+digits(id)+1);
 
             // write the component id in the string (Uxx is enough if Uxx is a gate)
-            sprintf(b, "%s%d", COMP_ID_PREFIX, rtcn->comp->id);
+            sprintf(b, "%s%d", COMP_ID_PREFIX, id);
 
-        } else if (rtcn->comp->prototype->type == SUBSYSTEM) {
+        } else if (proto->type == SUBSYSTEM) {
 
             // allocate as much memory as we need
             b = malloc(
                 strlen(COMP_ID_PREFIX)
-                +digits(rtcn->comp->id)
+                +digits(id)
                 +strlen(MAP_COMP_OUT_SEP)
-                +strlen(rtcn->comp->prototype->subsys->outputs[m->out_index])
+                +strlen(proto->subsys->outputs[m->out_index])
                 +1  // for the null byte
             );
             
             // wrtie the component id and the output name in the string (Uxx_yy)
             sprintf(b, "%s%d_%s", 
                 COMP_ID_PREFIX,
-                rtcn->comp->id,
-                rtcn->comp->prototype->subsys->outputs[m->out_index]
+                id,
+                proto->subsys->outputs[m->out_index]
             );
 
         }
@@ -1459,9 +2002,10 @@ void lib_to_file_debug(Netlist *lib, char *filename, char *mode) {
         } else {
 
             // print the header line
-            char *buf = malloc(MAX_LINE_LEN);
+            int hdr_size = subsys_hdr_size(n->std->subsys);
+            char *buf = malloc(hdr_size);
 
-            subsys_hdr_to_str(n->std->subsys, buf, MAX_LINE_LEN);
+            subsys_hdr_to_str(n->std->subsys, buf, hdr_size);
             fprintf(fp, "%s\n", buf);
             free(buf);
 
@@ -1533,54 +2077,59 @@ Subsystem *instantiate_subsys(Subsystem *std, char **inputs, int inputc, char **
     // check if null, if number of inputs/outputs the same, etc TODO
 
     // set the name
-    instance->name = malloc(strlen(std->name)+1);
+    instance->name = std->name;
     instance->is_standard = 0;
-    strncpy(instance->name, std->name, strlen(std->name)+1);
+    instance->aliases = NULL;
+    instance->program = NULL;
+    instance->comp_index = instance->input_index = instance->output_index = instance->alias_index = NULL;
+    instance->store = NULL;
+    instance->tmpl = NULL;
+    instance->model = NULL;
+    instance->arena = NULL;
 
     // set the inputs and outputs according to the given names
-    deepcopy_str_list(&(instance->inputs), inputs, inputc);
+    sym_list_copy(&(instance->inputs), inputs, inputc, NULL);
     instance->_inputc = inputc;
 
-    deepcopy_str_list(&(instance->outputs), outputs, outputc);
+    sym_list_copy(&(instance->outputs), outputs, outputc, NULL);
     instance->_outputc = outputc;
 
-    // create the components of the instance according to the standard
-    Node *nd = std->components->head;
-    instance->components = NULL;
-    while (nd != NULL) {
+    // create the components of the instance according to the standard (each one has the id and the
+    // prototype of the component of the standard at the same position, see its store)
+    CompStore *st = subsys_store(std);
+    instance->components = ll_init();
+    for (int k=0; k<st->compc; k++) {
 
         Component *comp = malloc(sizeof(Component));
 
         comp->is_standard = 0;
-        comp->id = nd->comp->id;
-        comp->prototype = nd->comp->prototype;
+        comp->id = st->ids[k];
+        comp->prototype = st->protos[k];
 
         // resolve the input mappings
         comp->inputs = malloc(sizeof(char*) * comp->prototype->subsys->_inputc);
         comp->_inputc = comp->prototype->subsys->_inputc;
         for(int i=0; i<comp->prototype->subsys->_inputc; i++) {
             
-            Mapping *m = nd->comp->i_maps[i];
+            Mapping *m = st->fanin + st->fanin_start[k] + i;
             char *tmp;
             if (m->type == SUBSYS_INPUT) {
 
                 // find the input that the mapping refers to
-                tmp = instance->inputs[m->index];
-                comp->inputs[i] = malloc(strlen(tmp)+1);
-                strncpy(comp->inputs[i], tmp, strlen(tmp)+1);
+                comp->inputs[i] = instance->inputs[m->index];
 
             } else if (m->type == SUBSYS_COMP) {
 
                 // find the component that the mapping refers to
-                Node *rtcn = move_in_list(m->index, instance->components);  // referred_to_comp_node (the node that contains the component that the mapping refers to)
+                int id = st->ids[m->index];
+                Subsystem *rts = st->protos[m->index]->subsys;    // referred-to subsystem
                 
                 // write the component id and the output name in a string
-                tmp = malloc(1+digits(rtcn->comp->id)+1+strlen(rtcn->comp->prototype->subsys->outputs[m->out_index])+2);  // allocate memory for the 'U', the ID, the '_', the output name and a null byte
-                sprintf(tmp, "U%d_%s", rtcn->comp->id, rtcn->comp->prototype->subsys->outputs[m->out_index]);
+                tmp = malloc(1+digits(id)+1+strlen(rts->outputs[m->out_index])+2);  // allocate memory for the 'U', the ID, the '_', the output name and a null byte
+                sprintf(tmp, "U%d_%s", id, rts->outputs[m->out_index]);
                 
-                // copy that string into the component's inputs (and free it)
-                comp->inputs[i] = malloc(strlen(tmp)+1);
-                strncpy(comp->inputs[i], tmp, strlen(tmp)+1);
+                // intern that string as the component's input (and free it)
+                comp->inputs[i] = intern(tmp, strlen(tmp));
                 free(tmp);
 
             }
@@ -1589,8 +2138,6 @@ Subsystem *instantiate_subsys(Subsystem *std, char **inputs, int inputc, char **
 
         // add the newly created component to the instance
         subsys_add_comp(instance, comp);
-
-        nd = nd->next;
     }
 
     // map the outputs according to the standard (resolve the mappings)
@@ -1602,21 +2149,20 @@ Subsystem *instantiate_subsys(Subsystem *std, char **inputs, int inputc, char **
         if (m->type == SUBSYS_INPUT) {
 
             // find the input that the mapping refers to
-            instance->output_mappings[i] = malloc(strlen(instance->inputs[m->index])+1);
-            strncpy(instance->output_mappings[i], instance->inputs[m->index], strlen(instance->inputs[m->index])+1);
+            instance->output_mappings[i] = instance->inputs[m->index];
         
         } else if (m->type == SUBSYS_COMP) {
         
             // find the component that the mapping refers to
-            Node *rtcn = move_in_list(m->index, instance->components);  // referred_to_comp_node (the node that contains the component that the mapping refers to)
+            int id = st->ids[m->index];
+            Subsystem *rts = st->protos[m->index]->subsys;    // referred-to subsystem
             
             // write the component id and the output name in a string
-            char *tmp = malloc(1+digits(rtcn->comp->id)+1+strlen(rtcn->comp->prototype->subsys->outputs[m->out_index])+2);  // allocate memory for the 'U', the ID, the '_', the output name and a null byte
-            sprintf(tmp, "U%d_%s", rtcn->comp->id, rtcn->comp->prototype->subsys->outputs[m->out_index]);
+            char *tmp = malloc(1+digits(id)+1+strlen(rts->outputs[m->out_index])+2);  // allocate memory for the 'U', the ID, the '_', the output name and a null byte
+            sprintf(tmp, "U%d_%s", id, rts->outputs[m->out_index]);
             
-            // copy that string into the instance's outputs (and free it)
-            instance->output_mappings[i] = malloc(strlen(tmp)+1);
-            strncpy(instance->output_mappings[i], tmp, strlen(tmp)+1);
+            // intern that string as the instance's output (and free it)
+            instance->output_mappings[i] = intern(tmp, strlen(tmp));
             free(tmp);
         }
 
@@ -1640,38 +2186,564 @@ Component *instantiate_component(Standard *std, int id, char **inputs, int input
 
     // copy the inputs
     comp->_inputc = inputc;
-    deepcopy_str_list(&(comp->inputs), inputs, inputc);
+    sym_list_copy(&(comp->inputs), inputs, inputc, NULL);
 
     return comp;
 
 }
 
-Standard *find_in_lib(Netlist *lib, char *name) {
-    
-    Standard *ret = NULL;
-    Node *nod = lib->contents->head;
-    while(nod!=NULL) {
-        if (strncmp(nod->std->subsys->name, name, strlen(name)) == 0) {
-            ret = nod->std;
-            return ret;
-        }
-        nod = nod->next;
-    }
+SymTable symbols = { NULL, 0, 0, NULL, 0, NULL };
+pthread_mutex_t symbols_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    printf("Error! Could not find a subsystem with the expected name (%s) in the subsystem library (%s)\n", name, lib->file);
-    return NULL;
+/**
+ * @brief   Find the slot of the symbol table where the given name is (or would be put).
+ *          The caller must hold symbols_lock.
+ */
+SymId *sym_slot(char *name, int n) {
+
+    // linear probing from the slot of the hash
+    SymId mask = symbols.slotc-1;
+    for (SymId i = hash_bytes(name, n) & mask; ; i = (i+1) & mask) {
+        SymId id = symbols.slots[i];
+        if (id == SYM_NONE) return &(symbols.slots[i]);
 
+        char *sym = symbols.names[id];
+        if (strncmp(sym, name, n) == 0 && sym[n] == '\0') return &(symbols.slots[i]);
+    }
 }
 
-Node* search_in_llist(LList *list, enum NODE_TYPE t, char *str, int n, int id, int *index) {
+char *intern(char *name, int n) {
 
-    if (t != COMPONENT && str == NULL) {
-        return NULL;
+    pthread_mutex_lock(&symbols_lock);
+
+    // create the table on first use
+    if (symbols.slots == NULL) {
+        symbols.slotc = SYM_TABLE_SIZE;
+        symbols.slots = malloc(sizeof(SymId) * symbols.slotc);
+        memset(symbols.slots, 0xff, sizeof(SymId) * symbols.slotc);
+        symbols.cap = SYM_TABLE_SIZE/2;
+        symbols.names = malloc(sizeof(char*) * symbols.cap);
+        symbols.arena = arena_init(0);
     }
 
-    Node *cur = list->head;
+    SymId *slot = sym_slot(name, n);
+    if (*slot != SYM_NONE) {
+        char *sym = symbols.names[*slot];
+        pthread_mutex_unlock(&symbols_lock);
+        return sym;
+    }
+
+    // store the name right after its id, so that sym_id() does not need to look for it
+    SymId id = symbols.count++;
+    char *mem = arena_alloc(symbols.arena, sizeof(SymId)+n+1);
+    memcpy(mem, &id, sizeof(SymId));
+    memcpy(mem+sizeof(SymId), name, n);
+    mem[sizeof(SymId)+n] = '\0';
+    *slot = id;
+
+    if (symbols.count > symbols.cap) {
+        symbols.cap *= 2;
+        symbols.names = realloc(symbols.names, sizeof(char*) * symbols.cap);
+    }
+    symbols.names[id] = mem+sizeof(SymId);
+
+    // keep the table at most half full, re-inserting every name in a table twice the size
+    if (symbols.count*2 > symbols.slotc) {
+        free(symbols.slots);
+        symbols.slotc *= 2;
+        symbols.slots = malloc(sizeof(SymId) * symbols.slotc);
+        memset(symbols.slots, 0xff, sizeof(SymId) * symbols.slotc);
+        for (SymId i=0; i<symbols.count; i++) {
+            *sym_slot(symbols.names[i], strlen(symbols.names[i])) = i;
+        }
+    }
+
+    pthread_mutex_unlock(&symbols_lock);
+
+    return mem+sizeof(SymId);
+}
+
+char *sym_lookup(char *name, int n) {
+
+    char *sym = NULL;
+
+    pthread_mutex_lock(&symbols_lock);
+    if (symbols.slots != NULL) {
+        SymId id = *sym_slot(name, n);
+        if (id != SYM_NONE) sym = symbols.names[id];
+    }
+    pthread_mutex_unlock(&symbols_lock);
+
+    return sym;
+}
+
+SymId sym_id(char *sym) {
+
+    SymId id;
+    memcpy(&id, sym-sizeof(SymId), sizeof(SymId));
+
+    return id;
+}
+
+char *sym_name(SymId id) {
+
+    char *sym = NULL;
+
+    pthread_mutex_lock(&symbols_lock);
+    if (id < symbols.count) sym = symbols.names[id];
+    pthread_mutex_unlock(&symbols_lock);
+
+    return sym;
+}
+
+int sym_index(int n, char **list, char *name) {
+
+    if (list == NULL || name == NULL) {
+        return NARG;
+    }
+
+    // a name that was never interned is not in any list
+    char *sym = sym_lookup(name, strlen(name));
+    if (sym == NULL) return -1;
+
+    for (int i=0; i<n; i++) {
+        if (list[i] == sym) return i;
+    }
+
+    return -1;
+}
+
+int str_to_sym_list(char *str, char ***l, char *delim, Arena *arena) {
+
+    StrView tok;
+    int i=0;
+
+    (*l) = alloc_in(arena, sizeof(char*) * (count_tokens(str, delim)+1));
+    while (next_token(&str, delim, &tok)) {
+
+        // a name never starts or ends with blanks (e.g. 'OUT: S , COUT' declares S, not 'S ')
+        while (tok.len > 0 && (tok.str[0] == ' ' || tok.str[0] == '\t')) {
+            tok.str++;
+            tok.len--;
+        }
+        while (tok.len > 0 && (tok.str[tok.len-1] == ' ' || tok.str[tok.len-1] == '\t')) {
+            tok.len--;
+        }
+
+        (*l)[i++] = intern(tok.str, tok.len);
+    }
+
+    return i;
+}
+
+int sym_list_copy(char ***dst, char **src, int n, Arena *arena) {
+
+    if (src == NULL) return NARG;
+
+    (*dst) = alloc_in(arena, sizeof(char*) * (n+1));
+    for (int i=0; i<n; i++) {
+
+        if (src[i] == NULL) return NARG;
+
+        (*dst)[i] = intern(src[i], strlen(src[i]));
+    }
+
+    return n;
+}
+
+void free_symbols() {
+
+    pthread_mutex_lock(&symbols_lock);
+    free(symbols.names);
+    free(symbols.slots);
+    arena_free(symbols.arena);
+    symbols.names = NULL;
+    symbols.slots = NULL;
+    symbols.arena = NULL;
+    symbols.count = symbols.cap = symbols.slotc = 0;
+    pthread_mutex_unlock(&symbols_lock);
+}
+
+Index *index_init(int n) {
+
+    Index *ix = malloc(sizeof(Index));
+
+    // at most half full
+    ix->cap = 16;
+    while (ix->cap < 2*n) ix->cap *= 2;
+    ix->count = 0;
+    ix->entries = malloc(sizeof(IndexEntry) * ix->cap);
+    for (int i=0; i<ix->cap; i++) {
+        ix->entries[i].key = INDEX_EMPTY;
+    }
+
+    return ix;
+}
+
+/**
+ * @brief   Find the slot of the index where the given key is (or would be put).
+ */
+IndexEntry *index_slot(Index *ix, int key) {
+
+    // mix the bits of the key (consecutive ids would otherwise fill consecutive slots), then probe linearly
+    unsigned int mask = ix->cap-1;
+    for (unsigned int i = ((unsigned int)key * 2654435761u) & mask; ; i = (i+1) & mask) {
+        if (ix->entries[i].key == key || ix->entries[i].key == INDEX_EMPTY) return &(ix->entries[i]);
+    }
+}
+
+int index_put(Index *ix, int key, int pos, void *ptr) {
+
+    IndexEntry *e = index_slot(ix, key);
+    if (e->key == key) return 1;
+
+    e->key = key;
+    e->pos = pos;
+    e->ptr = ptr;
+    ix->count++;
+
+    // keep the table at most half full, re-inserting every entry in one twice the size
+    if (ix->count*2 > ix->cap) {
+        IndexEntry *old = ix->entries;
+        int old_cap = ix->cap;
+
+        ix->cap *= 2;
+        ix->entries = malloc(sizeof(IndexEntry) * ix->cap);
+        for (int i=0; i<ix->cap; i++) {
+            ix->entries[i].key = INDEX_EMPTY;
+        }
+        for (int i=0; i<old_cap; i++) {
+            if (old[i].key != INDEX_EMPTY) *index_slot(ix, old[i].key) = old[i];
+        }
+        free(old);
+    }
+
+    return 0;
+}
+
+IndexEntry *index_get(Index *ix, int key) {
+
+    if (ix == NULL) return NULL;
+
+    IndexEntry *e = index_slot(ix, key);
+
+    return e->key == key ? e : NULL;
+}
+
+void free_index(Index *ix) {
+
+    if (ix != NULL) {
+        free(ix->entries);
+        free(ix);
+    }
+}
+
+/**
+ * @brief   Build an index of the given interned names by their ids.
+ */
+Index *sym_list_index(int n, char **list) {
+
+    Index *ix = index_init(n);
+    for (int i=0; i<n; i++) {
+        index_put(ix, sym_id(list[i]), i, NULL);
+    }
+
+    return ix;
+}
+
+void subsys_index_signals(Subsystem *s) {
+
+    if (s->input_index == NULL) {
+        s->input_index = sym_list_index(s->_inputc, s->inputs);
+    }
+    if (s->output_index == NULL) {
+        s->output_index = sym_list_index(s->_outputc, s->outputs);
+    }
+}
+
+int subsys_input(Subsystem *s, char *name) {
+
+    if (s == NULL || name == NULL) {
+        return NARG;
+    }
+
+    // a name that was never interned is not an input of anything
+    char *sym = sym_lookup(name, strlen(name));
+    if (sym == NULL) return -1;
+
+    subsys_index_signals(s);
+    IndexEntry *e = index_get(s->input_index, sym_id(sym));
+
+    return e != NULL ? e->pos : -1;
+}
+
+int subsys_output(Subsystem *s, char *name) {
+
+    if (s == NULL || name == NULL) {
+        return NARG;
+    }
+
+    char *sym = sym_lookup(name, strlen(name));
+    if (sym == NULL) return -1;
+
+    subsys_index_signals(s);
+    IndexEntry *e = index_get(s->output_index, sym_id(sym));
+
+    return e != NULL ? e->pos : -1;
+}
+
+Node *subsys_find_comp(Subsystem *s, int id, int *index) {
+
+    IndexEntry *e = index_get(s->comp_index, id);
+    if (e == NULL) {
+        if (index != NULL) *index = -1;
+        return NULL;
+    }
+
+    if (index != NULL) *index = e->pos;
+
+    return e->ptr;
+}
+
+CompStore *subsys_store(Subsystem *s) {
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    if (s->store != NULL) {
+        return s->store;
+    }
+
+    // count the components and their mappings, so that every array is allocated once
+    int compc = 0, mapc = 0;
+    for (Node *n=s->components->head; n!=NULL; n=n->next) {
+        compc++;
+        if (n->comp->i_maps != NULL) mapc += n->comp->_inputc;
+    }
+
+    CompStore *st = malloc(sizeof(CompStore));
+    st->compc = compc;
+    st->comps = malloc(sizeof(Component*) * (compc+1));   // +1 so that malloc(0) is never called
+    st->protos = malloc(sizeof(Standard*) * (compc+1));
+    st->ids = malloc(sizeof(int) * (compc+1));
+    st->buffer_index = malloc(sizeof(int) * (compc+1));
+    st->fanin_start = malloc(sizeof(int) * (compc+1));
+    st->fanin = malloc(sizeof(Mapping) * (mapc+1));
+
+    // copy every component (and its mappings, by value) in the order of the list
+    int k = 0, f = 0;
+    for (Node *n=s->components->head; n!=NULL; n=n->next, k++) {
+
+        Component *c = n->comp;
+        st->comps[k] = c;
+        st->protos[k] = c->prototype;
+        st->ids[k] = c->id;
+        st->buffer_index[k] = c->buffer_index;
+        st->fanin_start[k] = f;
+
+        if (c->i_maps != NULL) {
+            for (int i=0; i<c->_inputc; i++, f++) {
+                if (c->i_maps[i] != NULL) {
+                    st->fanin[f] = *(c->i_maps[i]);
+                } else {
+                    // a missing mapping is neither to an input nor to a component
+                    st->fanin[f].type = -1;
+                    st->fanin[f].index = -1;
+                    st->fanin[f].out_index = -1;
+                }
+            }
+        }
+    }
+    st->fanin_start[compc] = f;
+
+    s->store = st;
+
+    return st;
+}
+
+void free_comp_store(CompStore *st) {
+
+    if (st == NULL) {
+        return;
+    }
+
+    free(st->comps);
+    free(st->protos);
+    free(st->ids);
+    free(st->buffer_index);
+    free(st->fanin_start);
+    free(st->fanin);
+    free(st);
+}
+
+/**
+ * @brief   Whether the given mapping of subsystem s (whose components are in st) refers to one of its inputs or to an
+ *          output of one of its components (and, for a component that is a subsystem, to one that it has).
+*/
+int store_mapping_valid(Subsystem *s, CompStore *st, Mapping *m) {
+
+    if (m == NULL) {
+        return 0;
+    }
+
+    if (m->type == SUBSYS_INPUT) {
+        return m->index >= 0 && m->index < s->_inputc;
+    }
+
+    if (m->type != SUBSYS_COMP || m->index < 0 || m->index >= st->compc) {
+        return 0;
+    }
+
+    Standard *proto = st->protos[m->index];
+    return proto->type == GATE || (m->out_index >= 0 && m->out_index < proto->subsys->_outputc);
+}
+
+/**
+ * @brief   Sort the components of the given store topologically into order (compc entries): start from the ones that
+ *          only read inputs, and every time a component is placed, the ones that read it have one less pending driver.
+ *          The input mappings must be valid (see store_mapping_valid()).
+ * 
+ * @return  How many components were placed, less than compc if they form a cycle (the rest of order is then unset)
+*/
+int store_topo_order(CompStore *st, int *order) {
+
+    int compc = st->compc;
+    int edgec = st->fanin_start[compc];
+
+    // count the components that drive each component (its in-degree) and that each one drives (its fanout)...
+    int *indegree = calloc(compc+1, sizeof(int));
+    int *fanout_start = calloc(compc+2, sizeof(int));
+    for (int f=0; f<edgec; f++) {
+        if (st->fanin[f].type == SUBSYS_COMP) fanout_start[st->fanin[f].index+1]++;
+    }
+    for (int k=0; k<compc; k++) {
+        fanout_start[k+1] += fanout_start[k];
+    }
+
+    // ...and fill in the fanout of each component
+    int *fanout = malloc(sizeof(int) * (edgec+1));
+    int *fill = malloc(sizeof(int) * (compc+1));
+    memcpy(fill, fanout_start, sizeof(int) * (compc+1));
+    for (int k=0; k<compc; k++) {
+        for (int f=st->fanin_start[k]; f<st->fanin_start[k+1]; f++) {
+            if (st->fanin[f].type == SUBSYS_COMP) {
+                fanout[fill[st->fanin[f].index]++] = k;
+                indegree[k]++;
+            }
+        }
+    }
+
+    int head = 0, tail = 0;
+    for (int k=0; k<compc; k++) {
+        if (indegree[k] == 0) order[tail++] = k;
+    }
+    while (head < tail) {
+        int c = order[head++];
+        for (int f=fanout_start[c]; f<fanout_start[c+1]; f++) {
+            if (--indegree[fanout[f]] == 0) order[tail++] = fanout[f];
+        }
+    }
+
+    free(indegree);
+    free(fanout_start);
+    free(fanout);
+    free(fill);
+
+    return tail;
+}
+
+int subsys_add_alias(Subsystem *s, Alias *a) {
+
+    if (s == NULL || a == NULL) {
+        return NARG;
+    }
+
+    // make the alias into a node
+    Node *n = alloc_in(s->aliases->arena, sizeof(Node));
+    n->type = ALIAS;
+    n->alias = a;
+    n->next = NULL;
+
+    // index it by name
+    if (s->alias_index == NULL) {
+        s->alias_index = index_init(0);
+    }
+    index_put(s->alias_index, sym_id(a->name), s->aliases->size, a);
+
+    // add the new node to the subsystem
+    return ll_add(s->aliases, n);
+}
+
+Alias *subsys_find_alias(Subsystem *s, char *name) {
+
+    if (s == NULL || name == NULL) {
+        return NULL;
+    }
+
+    char *sym = sym_lookup(name, strlen(name));
+    if (sym == NULL) return NULL;
+
+    IndexEntry *e = index_get(s->alias_index, sym_id(sym));
+
+    return e != NULL ? e->ptr : NULL;
+}
+
+Standard *find_in_lib(Netlist *lib, char *name) {
+    
+    Standard *ret = NULL;
+    Node *nod = lib->contents->head;
+
+    // names are interned, so the name is looked up once and then only ids or pointers are compared
+    char *sym = sym_lookup(name, strlen(name));
+
+    // the standards of a library are indexed by name as they are added
+    if (sym != NULL && lib->index != NULL) {
+        IndexEntry *e = index_get(lib->index, sym_id(sym));
+        if (e != NULL) return e->ptr;
+        nod = NULL;
+    }
+
+    // a lazily loaded library may still have it in its file
+    if (sym != NULL && lib->lazy != NULL) {
+        if ( (ret=lazy_load(lib, sym)) ) return ret;
+
+        // it is there, but it could not be parsed
+        int _en = lazy_lib_error(lib, name);
+        if (_en) {
+            fprintf(diag_stream(stdout), "Error! The subsystem %s of the subsystem library (%s) could not be parsed (error %d)\n", name, lib->file, _en);
+            return NULL;
+        }
+    }
+
+    while(nod!=NULL && sym!=NULL) {
+        if ((nod->std->type == GATE ? nod->std->gate->name : nod->std->subsys->name) == sym) {
+            ret = nod->std;
+            return ret;
+        }
+        nod = nod->next;
+    }
+
+    fprintf(diag_stream(stdout), "Error! Could not find a subsystem with the expected name (%s) in the subsystem library (%s)\n", name, lib->file);
+    return NULL;
+
+}
+
+Node* search_in_llist(LList *list, enum NODE_TYPE t, char *str, int n, int id, int *index) {
+
+    if (t != COMPONENT && str == NULL) {
+        return NULL;
+    }
+
+    Node *cur = list->head;
     char *name = NULL;     // a pointer to the thing that will be compared to str
 
+    // names are interned, so str is looked up once and then only pointers are compared
+    char *sym = NULL;
+    if (t != COMPONENT && (sym = sym_lookup(str, n)) == NULL) {
+        return NULL;
+    }
+
     // reset the index counter if needed
     if (index != NULL) *index = -1;
 
@@ -1714,7 +2786,7 @@ Node* search_in_llist(LList *list, enum NODE_TYPE t, char *str, int n, int id, i
             }
 
             // do the actual comparison and return if needed
-            if (strncmp(name, str, n) == 0) {
+            if (name == sym) {
                 return cur;
             }
 
@@ -1730,23 +2802,32 @@ Node* search_in_llist(LList *list, enum NODE_TYPE t, char *str, int n, int id, i
 
 }
 
-int parse_truth_table(char *_tt) {
+int parse_truth_table(char *_tt, uint64_t **tt) {
+
+    // count the rows first, to know how many words are needed
+    int rows = 0;
+    for (char *c=_tt; *c!='\0'; c++) {
+        if (*c=='1' || *c=='0') rows++;
+    }
+
+    *tt = malloc(sizeof(uint64_t) * ((rows+63)/64 + 1));
+    memset(*tt, 0, sizeof(uint64_t) * ((rows+63)/64 + 1));
+
+    // row r is bit r%64 of word r/64
+    int r = 0;
+    for (char *c=_tt; *c!='\0'; c++) {
 
-    int truth_table_bits = 0;
-    for (int i=0; i<strlen(_tt); i++) {
-        char c = _tt[i];
-        
         // skip any non-bit characters
-        if (c!='1' && c!='0') continue;
+        if (*c!='1' && *c!='0') continue;
 
-        truth_table_bits <<= 1;
-        truth_table_bits += (c-'0');
+        (*tt)[r/64] |= (uint64_t)(*c-'0') << (r%64);
+        r++;
     }
 
-    return truth_table_bits;
+    return rows;
 }
 
-int eval_at(int tt, char *inputs) {
+int eval_at(uint64_t *tt, char *inputs) {
 
     int index = 0;
     int n = strlen(inputs);
@@ -1761,14 +2842,16 @@ int eval_at(int tt, char *inputs) {
         index += (inputs[i]-'0');
     }
 
-    int filter = one_at_index(2<<(n-1), index);
+    return eval_index(tt, index);
+}
 
-    int res = tt & filter;
+int eval_index(uint64_t *tt, int index) {
 
-    return res>>((int)(2<<(n-1))-1-index);
+    // the inputs are the number of the row, so they point straight at its bit
+    return (tt[index>>6] >> (index&63)) & 1;
 }
 
-void print_as_truth_table(int tt, int inputs) {
+void print_as_truth_table(uint64_t *tt, int inputs) {
 
     int max_n = 2<<(inputs-1);
 
@@ -1802,747 +2885,3580 @@ void print_as_truth_table(int tt, int inputs) {
 
 }
 
-int simulate(Subsystem* s, char *inputs, int *display_outs, FILE* fp) {
-
+int compile_subsystem(Subsystem *s, SimProgram **prog) {
 
-    clock_t _start = clock();    // measure time of execution - initial timestamp
-
-    if (s == NULL || inputs==NULL) {
+    if (s == NULL || prog == NULL) {
         return NARG;
     }
 
-    // parse the inputs into a list
-    char **l = NULL;
-    int ic = str_to_list(inputs, &l, SIM_INPUT_DELIM);
-
-    // check that the number of inputs is the expected one
-    if (ic != s->_inputc) {
-        fprintf(stderr, "simulation error: got %d inputs, expected %d\n", ic, s->_inputc);
-        return GENERIC_ERROR;
-    }
-
-    int *int_inputs = malloc(sizeof(int)*s->_inputc);
+    // the components are read from their store, where mappings (which hold list positions) are resolved in O(1)
+    CompStore *st = subsys_store(s);
+    int compc = st->compc;
 
-    // make the inputs integers (so that they are usable in the simulation)
-    for (int i=0; i<s->_inputc; i++) {
-        
-        // only check the first byte (suffices if everything is done right)
-        char c = l[i][0];
+    int k = 0;
+    for (k=0; k<compc; k++) {
 
-        // check that it is a bit
-        if (c!='1' && c !='0') {
-            fprintf(stderr, "unexpected (non-bit) value found for input %s of subsystem %s: '%c'\n", s->inputs[i], s->name, c);
+        // we can only compile subsystems made of gates
+        if (st->protos[k]->type != GATE) {
+            fprintf(stderr, "cannot compile subsystem %s: component %s%d is not a gate\n", s->name, COMP_ID_PREFIX, st->ids[k]);
             return GENERIC_ERROR;
         }
 
-        // convert to int
-        int_inputs[i] = c - '0';
+        // with one mapping for each input of the gate
+        if (st->fanin_start[k+1] - st->fanin_start[k] != st->protos[k]->gate->_inputc) {
+            fprintf(stderr, "cannot compile subsystem %s: component %s%d does not have a mapping for every input\n", s->name, COMP_ID_PREFIX, st->ids[k]);
+            return GENERIC_ERROR;
+        }
     }
 
+    // every input of every gate is an edge in the graph of the subsystem, the slots that the
+    // gates read are laid out just like their mappings (see CompStore)
+    int edgec = st->fanin_start[compc];
+    int *slots_of = st->fanin_start;
+
+    // allocate the program
+    SimProgram *p = malloc(sizeof(SimProgram));
+    p->slotc = s->_inputc + compc;
+    p->instrc = compc;
+    p->instrs = malloc(sizeof(SimInstr) * (compc+1));
+    p->fanin = malloc(sizeof(int) * (edgec+1));
+    p->outc = s->_outputc;
+    p->out_slots = malloc(sizeof(int) * (s->_outputc+1));
+    p->levelized = 0;
+    p->fanout_start = NULL;
+    p->fanout = NULL;
+    p->level = NULL;
+    p->levelc = 0;
+    p->native = NULL;
+    p->native_width = 0;
+    p->native_handle = NULL;
+    p->jit = NULL;
+    p->jit_width = 0;
+    p->jit_code = NULL;
+    p->jit_size = 0;
+
+    // resolve the input mappings of every component into slots
+    for (k=0; k<compc; k++) {
+
+        int offset = slots_of[k];
+        for (int i=0; i<slots_of[k+1]-offset; i++) {
+
+            Mapping *m = st->fanin + offset + i;
+
+            // the mapping is neither to an input or a component - should never happen
+            if (!store_mapping_valid(s, st, m)) {
+                fprintf(stderr, "cannot compile subsystem %s: invalid mapping in input %d of component %s%d\n", s->name, i+1, COMP_ID_PREFIX, st->ids[k]);
+                free_program(p);
+                return GENERIC_ERROR;
+            }
 
-    // find out how large the buffers need to be (#components + #outputs)
-    int max_component_index = 0;
-    for(Node *n=s->components->head; n!=NULL; n=n->next) {
-        if (n->comp->buffer_index > max_component_index) {
-            max_component_index = n->comp->buffer_index;
+            // inputs of the subsystem have the first slots, and components have one slot each after them
+            p->fanin[offset+i] = m->type == SUBSYS_INPUT ? m->index : s->_inputc + m->index;
         }
     }
 
-    // initialize the buffers
-    int *buffer1 = malloc(sizeof(int) * ((max_component_index+1) + s->_outputc));
-    int *buffer2 = malloc(sizeof(int) * ((max_component_index+1) + s->_outputc));
-
-    memset(buffer1, 0, sizeof(int)*((max_component_index+1) + s->_outputc));
-    memset(buffer2, 0, sizeof(int)*((max_component_index+1) + s->_outputc));
-
-    int *old = buffer1;
-    int *new = buffer2;
+    // resolve the output mappings of the subsystem into slots
+    for (int i=0; i<s->_outputc; i++) {
 
-    // dirty flag (whether something changed this iteration or not - this is how we know when to break)
-    int dirty = 1;
+        Mapping *m = s->o_maps[i];
 
-    int iterations = 0;
+        if (!store_mapping_valid(s, st, m)) {
+            fprintf(stderr, "cannot compile subsystem %s: invalid mapping for output %s\n", s->name, s->outputs[i]);
+            free_program(p);
+            return GENERIC_ERROR;
+        }
 
-    clock_t start = clock();    // measure time of execution - initial timestamp
+        p->out_slots[i] = m->type == SUBSYS_INPUT ? m->index : s->_inputc + m->index;
+    }
 
-    while(dirty) {
+    // sort the components topologically, if not every component got placed, there is a cycle and the list order is kept
+    int *order = malloc(sizeof(int) * (compc+1));
+    p->levelized = (store_topo_order(st, order) == compc);
+    if (!p->levelized) {
+        for (k=0; k<compc; k++) order[k] = k;
+    }
 
-        // unset the dirty flag so that it is only set if something changes
-        dirty = 0;
+    // the components get their slots in the order in which they are evaluated, so that a pass
+    // writes the slots one after the other (and, bit-packed, consecutive gates share words)
+    int *slot_of = malloc(sizeof(int) * (compc+1));
+    for (int i=0; i<compc; i++) {
+        slot_of[order[i]] = s->_inputc + i;
+    }
 
-        // increment the iteration counter
-        iterations++;
+    // create the instructions in the chosen order, with their input slots renumbered and laid out in the same order
+    int *fanin = malloc(sizeof(int) * (edgec+1));
+    int offset = 0;
+    for (int i=0; i<compc; i++) {
+        k = order[i];
+        p->instrs[i].gate = st->protos[k]->gate;
+        p->instrs[i].op = classify_truth_table(st->protos[k]->gate->truth_table, st->protos[k]->gate->_inputc);
+        p->instrs[i].in_slots = fanin + offset;
+        p->instrs[i].out_slot = slot_of[k];
+        for (int f=slots_of[k]; f<slots_of[k+1]; f++) {
+            int slot = p->fanin[f];
+            fanin[offset++] = slot < s->_inputc ? slot : slot_of[slot - s->_inputc];
+        }
+    }
+    free(p->fanin);
+    p->fanin = fanin;
 
-        // iterate through the components
-        for(Node *n=s->components->head; n!=NULL; n=n->next) {
+    for (int i=0; i<s->_outputc; i++) {
+        if (p->out_slots[i] >= s->_inputc) {
+            p->out_slots[i] = slot_of[p->out_slots[i] - s->_inputc];
+        }
+    }
 
-            // cache a reference to the component for easy access
-            Component *comp = n->comp;
+    // index the instructions that read each slot (the fanout of every signal), so that an
+    // event-driven simulation can find the gates whose inputs changed
+    p->fanout_start = malloc(sizeof(int) * (p->slotc+1));
+    p->fanout = malloc(sizeof(int) * (edgec+1));
+    memset(p->fanout_start, 0, sizeof(int) * (p->slotc+1));
+    for (int i=0; i<compc; i++) {
+        for (int j=0; j<p->instrs[i].gate->_inputc; j++) {
+            p->fanout_start[p->instrs[i].in_slots[j]+1]++;
+        }
+    }
+    for (int i=0; i<p->slotc; i++) {
+        p->fanout_start[i+1] += p->fanout_start[i];
+    }
+    int *slot_fill = malloc(sizeof(int) * (p->slotc+1));
+    memcpy(slot_fill, p->fanout_start, sizeof(int) * (p->slotc+1));
+    for (int i=0; i<compc; i++) {
+        for (int j=0; j<p->instrs[i].gate->_inputc; j++) {
+            p->fanout[slot_fill[p->instrs[i].in_slots[j]]++] = i;
+        }
+    }
 
-            // if it is not a gate something is wrong
-            if (comp->prototype->type != GATE) {
-                fprintf(stderr, "unexpected component type! we can only simulate if all components are gates\n");
-                return GENERIC_ERROR;
+    // find the level of every instruction: gates driven only by inputs are on level 0, and every
+    // other gate is one level above the highest of its drivers (only meaningful without cycles)
+    p->level = malloc(sizeof(int) * (compc+1));
+    p->levelc = (compc > 0) ? 1 : 0;
+    int *level_of_slot = malloc(sizeof(int) * (p->slotc+1));    // the level of the gate that writes each slot (-1 for inputs)
+    for (int i=0; i<p->slotc; i++) level_of_slot[i] = -1;
+    for (int i=0; i<compc; i++) {
+
+        int level = 0;
+        if (p->levelized) {
+            for (int j=0; j<p->instrs[i].gate->_inputc; j++) {
+                if (level_of_slot[p->instrs[i].in_slots[j]]+1 > level) {
+                    level = level_of_slot[p->instrs[i].in_slots[j]]+1;
+                }
             }
+        }
 
-            // find out the input values
-
-            // clear the space where they will be stored
-            char comp_ins[(comp->prototype->gate->_inputc) + 1];
-            memset(comp_ins, 0, (comp->prototype->gate->_inputc) + 1);
-
-            // get them from the old buffer according to the component's mappings
-            for (int i=0; i<comp->prototype->gate->_inputc; i++) {
-
-                // get the mapping for each input
-                Mapping *m = comp->i_maps[i];
-
-                if (m->type == SUBSYS_INPUT) {
-                    
-                    // this is the easy case, inputs dont change so just get the value from there
-                    comp_ins[i] = int_inputs[m->index] + '0';
+        p->level[i] = level;
+        level_of_slot[p->instrs[i].out_slot] = level;
+        if (level+1 > p->levelc) p->levelc = level+1;
+    }
 
-                } else if (m->type == SUBSYS_COMP) {
+    // cleanup
+    free(slot_fill);
+    free(level_of_slot);
+    free(slot_of);
+    free(order);
 
-                    // find the component
-                    Component *rtc = move_in_list(m->index, s->components)->comp; // referred-to component node
-                    
-                    // get its index in the buffer
-                    int rtc_buf_index = rtc->buffer_index;
-                    
-                    // get its old value
-                    comp_ins[i] = old[rtc_buf_index] + '0';
-                } else {
+    *prog = p;
 
-                    // the mapping is neither to an input or a component - should never happen
-                    fprintf(stderr, "unexpected error! found mapping that does not map to an input or component\n");
-                    return GENERIC_ERROR;
-                }
+    return 0;
+}
 
-            }
+void run_program_bits(SimProgram *p, uint64_t *bits) {
 
-            // find the truth value of the component with the retrieved inputs
-            int new_val = eval_at(comp->prototype->gate->truth_table, comp_ins);
+    // consecutive gates write consecutive bits, so the word that is being written is kept in
+    // cur and only stored once the gates move on to the next one (instead of once per gate)
+    uint64_t cur = 0;
+    int cur_word = -1;
 
-            // only replace the value if it differs from the old one, and also set the dirty flag
-            if (new_val != new[comp->buffer_index]) {
-                new[comp->buffer_index] = new_val;
-                dirty = 1;
-            }
+    for (int k=0; k<p->instrc; k++) {
 
+        SimInstr *in = &(p->instrs[k]);
 
+        int out_word = in->out_slot/64;
+        if (out_word != cur_word) {
+            if (cur_word >= 0) bits[cur_word] = cur;
+            cur_word = out_word;
+            cur = bits[cur_word];
         }
 
+        // pack the values of the inputs into the index of the truth table row (an input may be in cur)
+        int index = 0;
+        for (int i=0; i<in->gate->_inputc; i++) {
+            int slot = in->in_slots[i];
+            uint64_t word = (slot/64 == cur_word) ? cur : bits[slot/64];
+            index = (index << 1) | (int)((word >> (slot%64)) & 1);
+        }
 
-            // also iterate through the outputs
-            for (int i=0; i<s->_outputc; i++) {
-                
-                int new_val;
-
-                // get the mapping
-                Mapping *m = s->o_maps[i];
-
-                if (m->type == SUBSYS_INPUT) {
-                    
-                    // this is the easy case, inputs dont change so just get the value from there
-                    new_val = int_inputs[m->index] + '0';
+        // clear the bit of the output and set it to the result
+        uint64_t mask = (uint64_t)1 << (in->out_slot%64);
+        cur = (cur & ~mask) | ((uint64_t)eval_index(in->gate->truth_table, index) << (in->out_slot%64));
+    }
 
-                } else if (m->type == SUBSYS_COMP) {
+    if (cur_word >= 0) bits[cur_word] = cur;
+}
 
-                    // find the component
-                    Component *rtc = move_in_list(m->index, s->components)->comp; // referred-to component node
-                    
-                    // get its index in the buffer
-                    int rtc_buf_index = rtc->buffer_index;
-                    
-                    // get its old value
-                    new_val = old[rtc_buf_index];
+EventSim *event_sim_init(SimProgram *p) {
 
-                } else {
+    if (p == NULL || !p->levelized) {
+        return NULL;
+    }
 
-                    // the mapping is neither to an input or a component - should never happen
-                    fprintf(stderr, "unexpected error! found mapping that does not map to an input or component\n");
-                    return GENERIC_ERROR;
-                }
+    EventSim *sim = malloc(sizeof(EventSim));
+    sim->program = p;
+    sim->bits = malloc(sizeof(uint64_t) * BIT_WORDS(p->slotc+1));
+    sim->scheduled = malloc(p->instrc+1);
+    sim->bucket_start = malloc(sizeof(int) * (p->levelc+1));
+    sim->bucket_fill = malloc(sizeof(int) * (p->levelc+1));
+    sim->queue = malloc(sizeof(int) * (p->instrc+1));
+    sim->initialized = 0;
+    sim->evaluations = 0;
+
+    memset(sim->bits, 0, sizeof(uint64_t) * BIT_WORDS(p->slotc+1));
+    memset(sim->scheduled, 0, p->instrc);
+    memset(sim->bucket_fill, 0, sizeof(int) * p->levelc);
+
+    // every instruction is scheduled at most once per vector, so each level needs a bucket as large as the level
+    memset(sim->bucket_start, 0, sizeof(int) * (p->levelc+1));
+    for (int k=0; k<p->instrc; k++) {
+        sim->bucket_start[p->level[k]+1]++;
+    }
+    for (int l=0; l<p->levelc; l++) {
+        sim->bucket_start[l+1] += sim->bucket_start[l];
+    }
 
-                // only replace the value if it differs from the old one, and also set the dirty flag
-                if (new_val != new[max_component_index+1+i]) {
-                    new[max_component_index+1+i] = new_val;
-                    dirty = 1;
-                }
+    return sim;
+}
 
+void event_sim_schedule(EventSim *sim, int slot) {
 
-            }
-        
+    SimProgram *p = sim->program;
 
-        // swap the buffers
-        int *tmp = old;
-        old = new;
-        new = tmp;
+    for (int f=p->fanout_start[slot]; f<p->fanout_start[slot+1]; f++) {
 
+        int k = p->fanout[f];
+        if (sim->scheduled[k]) continue;
 
+        sim->scheduled[k] = 1;
+        sim->queue[sim->bucket_start[p->level[k]] + sim->bucket_fill[p->level[k]]++] = k;
     }
+}
 
-    clock_t end = clock();  // final timestamp
-
-    double actual_time = ((double) (end - start)) / CLOCKS_PER_SEC;
-    double total_time = ((double) (end - _start)) / CLOCKS_PER_SEC;
+int event_sim_step(EventSim *sim, int *inputs) {
 
-    // print the results
-    for(int i=0; i<s->_inputc; i++) {
-        fprintf(fp!=NULL?fp:stderr, "%-5d", int_inputs[i]);
+    if (sim == NULL || inputs == NULL) {
+        return NARG;
     }
 
-    // print the delimiter
-    fprintf(fp!=NULL?fp:stderr, "%-5c", '|');
+    SimProgram *p = sim->program;
+    int inputc = p->slotc - p->instrc;
 
-    for(int i=0; i<s->_outputc; i++) {
-        if (display_outs[i]) {
-            fprintf(fp!=NULL?fp:stderr, "%-5d", old[max_component_index+1+i]);
+    // the first vector has nothing to compare against, so settle everything once
+    if (!sim->initialized) {
+        for (int i=0; i<inputc; i++) {
+            sim->bits[i/64] |= (uint64_t)(inputs[i] & 1) << (i%64);
         }
+        run_program_bits(p, sim->bits);
+        sim->initialized = 1;
+        sim->evaluations += p->instrc;
+        return p->instrc;
     }
 
-    fprintf(fp!=NULL?fp:stderr, "\t [%d iterations, %.3f msec of iterating, %.3f msec in total]\n", iterations, actual_time*1000, total_time*1000);
-
-    // cleanup
-    free(int_inputs);
-    free_str_list(l, ic);
-    free(buffer1);
-    free(buffer2);
-
-    return 0;
-}
-
-int parse_tb_from_file(Testbench *tb, char *filename, char *mode) {
-
-    FILE *fp = fopen(filename, mode);
+    // apply the inputs that toggled and schedule the gates that read them
+    for (int i=0; i<inputc; i++) {
+        if (SLOT_BIT(sim->bits, i) != inputs[i]) {
+            sim->bits[i/64] ^= (uint64_t)1 << (i%64);
+            event_sim_schedule(sim, i);
+        }
+    }
 
-    char *line = NULL;  // no need to malloc it, getline() does that for us (and also reallocs if needed) 
-    int line_no = 0;
-    int nread = 0;
-    int offset = 0;
-    size_t len = 0;
+    // process the levels in ascending order, a gate only schedules gates of higher levels
+    int evaluations = 0;
+    for (int l=0; l<p->levelc; l++) {
 
-    // initialize the values field of the testbench struct
-    tb->values = malloc(sizeof(char**) * tb->uut->_inputc);
-    tb->outs_display = malloc(sizeof(int)*tb->uut->_outputc);
-    memset(tb->outs_display, 0, sizeof(int)*tb->uut->_outputc);
+        int *bucket = sim->queue + sim->bucket_start[l];
+        for (int q=0; q<sim->bucket_fill[l]; q++) {
 
-    tb->v_c = -1;
+            SimInstr *in = &(p->instrs[bucket[q]]);
+            sim->scheduled[bucket[q]] = 0;
 
-    // loop through the lines of the file and get the contents
-    while((nread = read_line_from_file(&line, filename, &len, offset)) != -1) {
-        
-        line_no++;
-        offset += nread;
+            // pack the values of the inputs into the index of the truth table row
+            int index = 0;
+            for (int i=0; i<in->gate->_inputc; i++) {
+                index = (index << 1) | SLOT_BIT(sim->bits, in->in_slots[i]);
+            }
+            evaluations++;
 
-        if (strlen(line) != 0) {
-            
-            if (starts_with(line, TESTBENCH_IN)) {
+            // only an output that changed is an event for the gates that it drives
+            int value = eval_index(in->gate->truth_table, index);
+            if (value != SLOT_BIT(sim->bits, in->out_slot)) {
+                sim->bits[in->out_slot/64] ^= (uint64_t)1 << (in->out_slot%64);
+                event_sim_schedule(sim, in->out_slot);
+            }
+        }
 
-                while (1) {
+        sim->bucket_fill[l] = 0;
+    }
 
-                    // read the next line
-                    if ( (nread = read_line_from_file(&line, filename, &len, offset)) == -1 ) {
-                        printf("%s:%d: Error! File ended unexpectedly\n",filename, line_no);
-                        return UNEXPECTED_EOF;
-                    }
-                    line_no++;
-                    offset += nread;
+    sim->evaluations += evaluations;
 
-                    // check if we need to stop
-                    if (starts_with(line, TESTBENCH_OUT)) break;
+    return evaluations;
+}
 
-                    // keep a reference to be able to split
-                    char *_line = line;
+void free_event_sim(EventSim *sim) {
 
-                    // split the line into its contents
-                    char *name = split(&_line, TB_GENERAL_DELIM);
-                    char *vals = _line;
+    if (sim == NULL) {
+        return;
+    }
 
+    free(sim->bits);
+    free(sim->scheduled);
+    free(sim->bucket_start);
+    free(sim->bucket_fill);
+    free(sim->queue);
+    free(sim);
+}
 
-                    int in_index = -1;
-                    if ( (in_index = contains(tb->uut->_inputc, tb->uut->inputs, name)) == -1 ) {
-                        fprintf(stderr, "unknown input in testbench! uut of type %s has no input named %s\n", tb->uut->name, name);
-                        return GENERIC_ERROR;
-                    }
+/**
+ * @brief   Whether the given subsystem only has gates (and so is simulated with a program, not a model).
+*/
+int subsys_gate_only(Subsystem *s) {
 
+    CompStore *st = subsys_store(s);
+    for (int k=0; k<st->compc; k++) {
+        if (st->protos[k]->type != GATE) return 0;
+    }
 
-                    // put the given values into a list
-                    tb->values[in_index] = NULL;
-                    int v_c = str_to_list(vals, &(tb->values[in_index]), TB_IN_VAL_DELIM);
+    return 1;
+}
 
-                    if (tb->v_c == -1 || v_c < tb->v_c) {
-                        tb->v_c = v_c;
-                    }
+Simulator *simulator_init(Subsystem *s) {
 
-                }
-    
-            } 
-            
-            if (starts_with(line, TESTBENCH_OUT)) {
+    if (s == NULL) {
+        return NULL;
+    }
 
-                while ((nread = read_line_from_file(&line, filename, &len, offset)) != -1) {
-                    
-                    line_no++;
-                    offset += nread;
+    // a subsystem that instantiates subsystems is simulated through their shared models, instead of flattening it
+    if (!subsys_gate_only(s)) {
 
+        SimModel *m = subsys_model(s);
+        if (m == NULL) {
+            return NULL;
+        }
 
-                    int out_index = -1;
-                    if ( (out_index = contains(tb->uut->_outputc, tb->uut->outputs, line)) == -1 ) {
-                        fprintf(stderr, "unknown input in testbench! uut of type %s has no input named '%s'\n", tb->uut->name, line);
-                        return GENERIC_ERROR;
-                    }
+        Simulator *sim = malloc(sizeof(Simulator));
+        sim->subsys = s;
+        sim->program = NULL;
+        sim->model = m;
+        sim->words = m->frame_words;
+        sim->bits = malloc(sizeof(uint64_t) * sim->words);
+        sim->prev = NULL;
+        sim->iterations = 0;
 
-                    tb->outs_display[out_index] = 1;
+        memset(sim->bits, 0, sizeof(uint64_t) * sim->words);
 
-                }
-            }
+        return sim;
+    }
 
-        }
+    // compile the subsystem the first time it is simulated
+    if (s->program == NULL && compile_subsystem(s, &(s->program))) {
+        return NULL;
     }
 
-    free(line);
-    fclose(fp);
+    Simulator *sim = malloc(sizeof(Simulator));
+    sim->subsys = s;
+    sim->program = s->program;
+    sim->model = NULL;
+    sim->words = BIT_WORDS(s->program->slotc+1);
+    sim->bits = malloc(sizeof(uint64_t) * sim->words);
+    sim->prev = malloc(sizeof(uint64_t) * sim->words);
+    sim->iterations = 0;
 
-    return 0;
+    memset(sim->bits, 0, sizeof(uint64_t) * sim->words);
+
+    return sim;
 }
 
-int execute_tb(Testbench *tb, char *output_file, char *mode) {
+int simulator_run(Simulator *sim, uint64_t *in_bits, uint64_t *out_bits) {
 
-    if (tb == NULL || output_file == NULL || mode == NULL) {
+    if (sim == NULL || in_bits == NULL || out_bits == NULL) {
         return NARG;
     }
 
-    // open the file
-    FILE *fp = fopen(output_file, mode);
-    if (fp == NULL) {
-        fprintf(stderr, "execute_tb() encountered an error opening the file\n");
-        return GENERIC_ERROR;
-    }
-
-    // print the header
+    SimProgram *p = sim->program;
+    int inputc = sim->subsys->_inputc;
 
-    // print the inputs
-    for (int i=0; i<tb->uut->_inputc; i++) {
-        fprintf(fp, "%-5s", tb->uut->inputs[i]);
+    // the input slots come first, so they are packed just like the inputs: whole words are copied,
+    // and only the bits of the inputs are taken from the last one (the rest belong to gates)
+    memcpy(sim->bits, in_bits, sizeof(uint64_t) * (inputc/64));
+    if (inputc%64) {
+        uint64_t mask = ((uint64_t)1 << (inputc%64)) - 1;
+        sim->bits[inputc/64] = (sim->bits[inputc/64] & ~mask) | (in_bits[inputc/64] & mask);
     }
 
-    // print the delimiter
-    fprintf(fp, "%-5c", '|');
+    if (sim->model != NULL) {
 
-    // print the outputs
-    for(int i=0; i<tb->uut->_outputc; i++) {
-        if (tb->outs_display[i]) {
-            fprintf(fp, "%-5s", tb->uut->outputs[i]);
-        }
-    }
+        // a model has no cycles, so one pass over its components (and theirs) settles every signal
+        run_model_bits(sim->model, sim->bits);
+        sim->iterations = 1;
 
-    // print a newline
-    fprintf(fp, "\n");
+        memset(out_bits, 0, sizeof(uint64_t) * BIT_WORDS(sim->model->outc));
+        for (int i=0; i<sim->model->outc; i++) {
+            out_bits[i/64] |= (uint64_t)SLOT_BIT(sim->bits, sim->model->out_slots[i]) << (i%64);
+        }
 
+        return 0;
 
+    } else if (p->levelized) {
 
-    // iterate over the tests
-    for (int test_no=0; test_no<tb->v_c; test_no++) {
+        // there are no cycles, so one pass over the (sorted) gates settles every signal
+        run_program_bits(p, sim->bits);
+        sim->iterations = 1;
 
-        // get the inputs for each test in a format that simulate() understands
-        char *inputs = malloc((tb->uut->_inputc)*3+1);    // <= 3 bytes per input: the value, a comma and a space
+    } else {
 
-        // get the value of each input for the particular test number (assuming that the bit we want is the first in each value - the values are only strs because the function to parse a str into a list of strs was already written, technically they should be chars)
-        for(int i=0; i<tb->uut->_inputc; i++) {
-            sprintf(inputs+(i*3), "%c, ", tb->values[i][test_no][0]);
+        // there is a cycle, so start from all gates at 0 and iterate until nothing changes
+        for (int i=inputc; i<p->slotc; i++) {
+            sim->bits[i/64] &= ~((uint64_t)1 << (i%64));
         }
-
-        // hack to remove the last comma
-        inputs[tb->uut->_inputc*3-2] = '\0';
-
-        // call simulate
-        simulate(tb->uut, inputs, tb->outs_display, fp);
-
-        // test is over, free the inputs
-        free(inputs);
+        sim->iterations = 0;
+        do {
+            memcpy(sim->prev, sim->bits, sizeof(uint64_t) * sim->words);
+            run_program_bits(p, sim->bits);
+            sim->iterations++;
+        } while (memcmp(sim->prev, sim->bits, sizeof(uint64_t) * sim->words));
     }
 
-    fclose(fp);
+    // pack the outputs
+    memset(out_bits, 0, sizeof(uint64_t) * BIT_WORDS(p->outc));
+    for (int i=0; i<p->outc; i++) {
+        out_bits[i/64] |= (uint64_t)SLOT_BIT(sim->bits, p->out_slots[i]) << (i%64);
+    }
 
     return 0;
 }
 
+void free_simulator(Simulator *sim) {
 
-/**
- * Given a netlist (in the form of a library in order to avoid creating another
- * struct), parse the subsystems in it, and create a netlist for each one using
- * only gates (translate each subsystem all the way down to the gates it is defined
- * as in the library it is defined in).
- * 
- * Stores the translated compponents in dest, which is assumed to be allocated.
- * 
- * Starts the component ID numbering from the given one.
- * 
- * Returns:
- *  - 0 on success
- *  - -1 on failure
-*/
-int netlist_to_gate_only(Netlist *dest, Netlist *netlist, int component_id) {
+    if (sim == NULL) {
+        return;
+    }
 
-    /*******************************************************************************************\
-    *                                                                                           *
-    * The process of translating a system to gates is basically the core of a CAD tool and thus *
-    * deserves a text explanation to help in understanding the code.                            *
-    *                                                                                           *
-    * The following terms are used throughout this explanation:                                 *
-    *      - the "target subsystem" is the subsystem that we seek to translate to gates         *
-    *      - the "final subsystem" is the subsystem that we are creating, i.e. the one that     *
-    *        only contains gates.                                                               *
-    *      - "translated" refers to something (a subsystem mainly) that has been compiled down  *
-    *        to gates.                                                                          *
-    *                                                                                           *
-    * The steps are roughly the following:                                                      *
-    *      1) We initialize the final subsystem and copy into it the trivial details of         *
-    *         the target (name, input and output names and counts)                              *
-    *      2) We iterate through the components of the target subsystem. For each one:          *
-    *          2.1) we resolve its input mappings. This process differs for each type of        *
-    *               mapping:                                                                    *
-    *                 2.1.1) if an input maps to an input of the (target) subsystem,            *
-    *                        resolving it is trivial: we just fetch the name of that            *
-    *                        particular input.                                                  *
-    *                 2.1.2) if an input maps to an output of another component of the          *
-    *                        (target) subsystem, we want to find the mapping for this output    *
-    *                        in the final one. In order to do that we have to keep some         *
-    *                        information relating the components of the target subsystem to     *
-    *                        the gates that implement them in the final one. (We have to        *
-    *                        somehow know that U35 has become {U3897, U3898, U3899, U3900}      *
-    *                        in the final subsystem, and also that U35_COUT is mapped to        *
-    *                        what is U3900 in the final subsystem).                             *
-    *                        For details of how this is implemented see below (step 2.4).       *
-    *          2.2) once we have its inputs (now resolved to an array of strings), we can       *
-    *               create (an instance of) a subsystem of the same type, with those exact      *
-    *               inputs. We want the components of this instance to be numbered according    *
-    *               to the ID sequence of the final subsystem (see next steps to see why).      *
-    *          2.3) we now add every component of the subsystem created in step 2.2) to the     *
-    *               final subsystem.                                                            *
-    *          2.4) we mentioned before that we have to somehow relate the subsystems of        *
-    *               the target to the gates that implement them in the final. We achieve this   *
-    *               by keeping every translated component in an intermediate list, so we can    *
-    *               reference it through its position in the target (which is also its          *
-    *               position in the list). That way we can access its mappings, which in turn   *
-    *               contain the names of to its components, which are identical to the ones     * <- notice the "contains the name of" - we are looking at strings, not mappings
-    *               in the final subsystem.                                                     *
-    *               That way if we see a mapping to output x of component y of the target, we   *
-    *               can find the x'th element of the intermediate list and resolve the mapping  *
-    *               of its y'th output, effectively finding out the (final) ID of the gate      *
-    *               that the mapping actually points to.                                        *
-    *      3) We iterate through the output mappings of the target, resolving them              *
-    *         following the same process as above. We set the corresponding output of each      *
-    *         mapping to the result of that resolution.                                         *
-    *                                                                                           *
-    * A limitation of the above process (and a possible TODO) is that it assumes at most 1      *
-    * level of depth: we can only translate subsystems that contain subsystems that are made    *
-    * of gates, not other subsystems. For example, if we had the following setup:               *
-    *  - a half adder made from gates                                                           *
-    *  - a single bit full adder made from half adders                                          *
-    *  - an n-bit full adder made from single bit full adders                                   *
-    * we would not be able to translate the n-bit full adder to gates.                          *
-    *                                                                                           *
-    \*******************************************************************************************/
-
-
-    // set the destination library info
-    dest->contents = ll_init();
-    dest->file = NULL;
-    dest->type = SUBSYSTEM;
+    free(sim->bits);
+    free(sim->prev);
+    free(sim);
+}
 
-    // iterate over the contents of the netlist
-    Node *node_ptr = netlist->contents->head;
-    while (node_ptr!=NULL) {
+void run_program_lanes(SimProgram *p, uint64_t *slots) {
+    run_program_words(p, slots, 1);
+}
 
-        // this is the subsystem whose netlist we want to boil down to just gates
-        Subsystem *target = node_ptr->std->subsys;
+void run_program_words(SimProgram *p, uint64_t *slots, int width) {
+
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        int inputc = in->gate->_inputc;
+        uint64_t *out = slots + (size_t)in->out_slot*width;
+
+        // apply the operation of the gate on all the lanes of its inputs, one word at a time
+        for (int w=0; w<width; w++) {
+
+            uint64_t res = 0;
+
+            switch (in->op) {
+                case OP_CONST0:
+                    res = 0;
+                    break;
+                case OP_CONST1:
+                    res = ~(uint64_t)0;
+                    break;
+                case OP_BUF:
+                    res = slots[(size_t)in->in_slots[0]*width+w];
+                    break;
+                case OP_NOT:
+                    res = ~slots[(size_t)in->in_slots[0]*width+w];
+                    break;
+                case OP_AND:
+                case OP_NAND:
+                    res = ~(uint64_t)0;
+                    for (int i=0; i<inputc; i++) res &= slots[(size_t)in->in_slots[i]*width+w];
+                    if (in->op == OP_NAND) res = ~res;
+                    break;
+                case OP_OR:
+                case OP_NOR:
+                    for (int i=0; i<inputc; i++) res |= slots[(size_t)in->in_slots[i]*width+w];
+                    if (in->op == OP_NOR) res = ~res;
+                    break;
+                case OP_XOR:
+                case OP_XNOR:
+                    for (int i=0; i<inputc; i++) res ^= slots[(size_t)in->in_slots[i]*width+w];
+                    if (in->op == OP_XNOR) res = ~res;
+                    break;
+                default: {
+                    // gather the inputs and evaluate the truth table itself
+                    uint64_t ins[inputc];
+                    for (int i=0; i<inputc; i++) ins[i] = slots[(size_t)in->in_slots[i]*width+w];
+                    res = eval_lanes(in->gate->truth_table, inputc, ins);
+                    break;
+                }
+            }
 
-        // count the compponents in the target subsystem
-        int subsys_count = 0;
-        Node *_comp = target->components->head;
-        while (_comp != NULL) {
-            _comp = _comp->next;
-            subsys_count++;
+            out[w] = res;
         }
+    }
+}
 
-        // allocate space for the new, gate only subsystem
-        Subsystem *only_gates_sub = malloc(sizeof(Subsystem));
-        only_gates_sub->aliases = NULL;
+enum GATE_OP classify_truth_table(uint64_t *tt, int inputc) {
 
-        // initialize the fields of the new subsystem to match the old one
-        only_gates_sub->is_standard = 0;
-        only_gates_sub->name = malloc(strlen(target->name)+1);
-        strncpy(only_gates_sub->name, target->name, strlen(target->name)+1);
-        only_gates_sub->_inputc = target->_inputc;
-        only_gates_sub->inputs = malloc(sizeof(char*) * target->_inputc);
-        only_gates_sub->_outputc = target->_outputc;
-        only_gates_sub->outputs = malloc(sizeof(char*) * target->_outputc);
-        for(int i=0; i<target->_inputc; i++){
-            only_gates_sub->inputs[i] = malloc(strlen(target->inputs[i])+1);
-            strncpy(only_gates_sub->inputs[i], target->inputs[i], strlen(target->inputs[i])+1);
-        }
-        for(int i=0; i<target->_outputc; i++){
-            only_gates_sub->outputs[i] = malloc(strlen(target->outputs[i])+1);
-            strncpy(only_gates_sub->outputs[i], target->outputs[i], strlen(target->outputs[i])+1);
-        }
-        only_gates_sub->components = ll_init();
+    int rows = 1<<inputc;
 
+    // gather some facts about the table
+    int ones = 0;                   // how many rows are 1
+    int is_xor = 1, is_xnor = 1;    // whether every row is the parity of its inputs (or its inverse)
+    for (int r=0; r<rows; r++) {
 
-        // every translated component will be added to this intermediate list so
-        // that any references to the output of a component can be resolved
-        LList *intermediate_components = ll_init();
+        int v = eval_index(tt, r);
+        ones += v;
 
-        // iterate over the components of the old subsystem, resolving input mappings
-        // like UXX_S0 to the gate that is mapped to output S0 of component XX
-        _comp = target->components->head;
+        int parity = __builtin_popcount(r) & 1;
+        if (v != parity) is_xor = 0;
+        if (v == parity) is_xnor = 0;
+    }
 
-        while (_comp != NULL) {
+    // match the facts to the well known functions
+    if (ones == 0) return OP_CONST0;
+    if (ones == rows) return OP_CONST1;
 
-            // the component (we use the nodes to iterate)
-            Component *comp = _comp->comp;
+    if (inputc == 1) {
+        return eval_index(tt, 1) ? OP_BUF : OP_NOT;
+    }
 
-            // the (resolved) inputs that will be passed to to create_custom()
-            char **inputs = malloc(sizeof(char*) * comp->_inputc);
+    if (ones == 1 && eval_index(tt, rows-1)) return OP_AND;
+    if (ones == rows-1 && !eval_index(tt, rows-1)) return OP_NAND;
+    if (ones == rows-1 && !eval_index(tt, 0)) return OP_OR;
+    if (ones == 1 && eval_index(tt, 0)) return OP_NOR;
+    if (is_xor) return OP_XOR;
+    if (is_xnor) return OP_XNOR;
 
-            // iterate over the inputs of the component
-            for (int i=0; i<comp->_inputc; i++)  {
+    return OP_LUT;
+}
 
-                // find the mapping for each input
-                Mapping *map = comp->i_maps[i];
+uint64_t eval_lanes(uint64_t *tt, int inputc, uint64_t *inputs) {
 
-                // if it maps to another component
-                if (map->type == SUBSYS_COMP) {
-        
-                    // find out the component that it maps to
-                    Node *_n = move_in_list(map->index, intermediate_components);
-
-                    if (_n->type == SUBSYSTEM_N) {
-                        
-                            // take advantage of the hack we did when putting the subsystems in the intermediate components (search for COMP_HACK)
-                            Subsystem *_s = (Subsystem *)(_n->subsys);
-
-                            // check that the out_index is valid
-                            if (map->out_index < 0) {
-                                char *b = malloc(BUFSIZ);
-                                mapping_to_str(map, b, BUFSIZ);
-                                fprintf(stderr, "invalid output index %d in mapping '%s' to subsystem of type '%s'\n", map->out_index, b, _s->name);
-                                free(b);
-                                return GENERIC_ERROR;
-                            }
-                            
-                            // find the corresponding output mapping
-                            char *m = _s->output_mappings[map->out_index];
-
-                            // put it in the input list
-                            inputs[i] = malloc(strlen(m)+1); // +1 for the null byte
-                            strncpy(inputs[i], m, strlen(m)+1);
-
-                        
-                    } else {
-
-                        Component *c = _n->comp;
-
-                        inputs[i] = malloc(strlen(COMP_ID_PREFIX)+digits(c->id)+2);
-                        sprintf(inputs[i], "%s%d", COMP_ID_PREFIX, c->id);
-                    }
+    // a wide table is looked up once per lane, reducing it would take 2^inputc steps
+    if (inputc > LUT_REDUCE_MAX_INPUTS) {
 
-                } else if (map->type == SUBSYS_INPUT) {
+        uint64_t res = 0;
+        for (int l=0; l<64; l++) {
 
-                    // find the input of the subsystem that the mapping maps to
-                    char *m = target->inputs[map->index];
-                    
-                    // put it in the input list
-                    inputs[i] = malloc(strlen(m)+1); // +1 for the null byte
-                    strncpy(inputs[i], m, strlen(m)+1);
+            int index = 0;
+            for (int i=0; i<inputc; i++) {
+                index = (index << 1) | ((inputs[i] >> l) & 1);
+            }
 
-                }
+            res |= (uint64_t)eval_index(tt, index) << l;
+        }
 
-            }
-            
+        return res;
+    }
 
-            /*
-            Useful for debugging, can print the inputs of each subsystem and see if the gates are ok
-            */
-            
-            fprintf(stderr, "inputs for U%d, %s are the following: ", comp->id, comp->prototype->subsys->name);
-            for (int i=0; i<comp->_inputc; i++) {
-                fprintf(stderr, "%s ", inputs[i]);
-            }
-            fprintf(stderr, "\n");
-            
-            /*
-                we now have a complete list of inputs for each component
-                we need to create the netlist of that component with the inputs we now have
-                and add it to the subsystems array, unless it is a gate, in which case we just
-                have to add it to the new subsystem (the gate-only one). but then how will we
-                resolve mappings that need that gate's output? add an else in line 1319
-            */
-            if (comp->prototype->type == GATE) {
+    int rows = 1<<inputc;
 
-                // create a gate component just like the one in the target subsystem
-                Component *nc = malloc(sizeof(Component));
-                nc->i_maps = NULL;
-                nc->id = component_id++;
-                nc->_inputc = deepcopy_str_list(&(nc->inputs), inputs, comp->_inputc);
-                nc->is_standard = 0;
-                nc->prototype = comp->prototype;
-
-                // add it to the gates-only subsystem
-                subsys_add_comp(only_gates_sub, nc);
-
-                // also add it to the list of components of the target subsystems, so
-                // that any references to it can be resolved
-                Node *nn = malloc(sizeof(Node));
-                nn->type = COMPONENT;
-                nn->comp = nc;
-                nn->next = NULL;
-                ll_add(intermediate_components, nn);
+    // start with every row of the table as a constant across all lanes
+    uint64_t v[rows];
+    for (int r=0; r<rows; r++) {
+        v[r] = eval_index(tt, r) ? ~(uint64_t)0 : 0;
+    }
 
-            } else {
+    // the last input is the LSB of the row index, so rows 2j and 2j+1 only differ in it.
+    // selecting between them with that input halves the table, and so on for every input.
+    for (int i=inputc-1; i>=0; i--) {
+        uint64_t x = inputs[i];
+        rows >>= 1;
+        for (int j=0; j<rows; j++) {
+            v[j] = (x & v[2*j+1]) | (~x & v[2*j]);
+        }
+    }
 
+    return v[0];
+}
 
-                Subsystem *just_translated = malloc(sizeof(Subsystem));
+#if defined(__x86_64__) || defined(__i386__)
 
-                component_id = create_custom(just_translated, comp->prototype, comp->_inputc, inputs, component_id);
-                
+/*
+    The SIMD kernels are compiled for their instruction set with target attributes, so the
+    rest of the library (and the simulate binary) is still built for the baseline CPU. They
+    are only ever called after select_kernel() has checked (with CPUID) that the CPU running
+    the program supports them.
+*/
 
-                // free the input list
-                for(int i=0; i<comp->_inputc; i++) free(inputs[i]);
+__attribute__((target("avx2")))
+void run_program_avx2(SimProgram *p, uint64_t *slots) {
+
+    const __m256i ones = _mm256_set1_epi64x(-1);
+
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        int inputc = in->gate->_inputc;
+        __m256i res = _mm256_setzero_si256();
+
+        // every slot is 4 words (256 lanes), which is exactly one register
+        #define AVX2_SLOT(i) _mm256_loadu_si256((__m256i*)(slots + (size_t)in->in_slots[i]*4))
+
+        switch (in->op) {
+            case OP_CONST0:
+                break;
+            case OP_CONST1:
+                res = ones;
+                break;
+            case OP_BUF:
+                res = AVX2_SLOT(0);
+                break;
+            case OP_NOT:
+                res = _mm256_xor_si256(AVX2_SLOT(0), ones);
+                break;
+            case OP_AND:
+            case OP_NAND:
+                res = ones;
+                for (int i=0; i<inputc; i++) res = _mm256_and_si256(res, AVX2_SLOT(i));
+                if (in->op == OP_NAND) res = _mm256_xor_si256(res, ones);
+                break;
+            case OP_OR:
+            case OP_NOR:
+                for (int i=0; i<inputc; i++) res = _mm256_or_si256(res, AVX2_SLOT(i));
+                if (in->op == OP_NOR) res = _mm256_xor_si256(res, ones);
+                break;
+            case OP_XOR:
+            case OP_XNOR:
+                for (int i=0; i<inputc; i++) res = _mm256_xor_si256(res, AVX2_SLOT(i));
+                if (in->op == OP_XNOR) res = _mm256_xor_si256(res, ones);
+                break;
+            default: {
+                // wide tables are looked up one lane at a time, one word at a time (see eval_lanes())
+                if (inputc > LUT_REDUCE_MAX_INPUTS) {
+                    uint64_t words[4], ins[inputc];
+                    for (int w=0; w<4; w++) {
+                        for (int i=0; i<inputc; i++) ins[i] = slots[(size_t)in->in_slots[i]*4 + w];
+                        words[w] = eval_lanes(in->gate->truth_table, inputc, ins);
+                    }
+                    res = _mm256_loadu_si256((__m256i*)words);
+                    break;
+                }
 
-                // add every gate to the gate-only subsystem, freeing the used nodes in the process
-                Node *c_c = just_translated->components->head;
-                while (c_c != NULL) {
-                    subsys_add_comp(only_gates_sub, c_c->comp);
-                    Node *tmp = c_c->next;
-                    char *b = malloc(BUFSIZ);
-                    comp_to_str(c_c->comp, b, BUFSIZ);
-                    free(b);
-                    c_c = tmp;
+                // the same reduction as eval_lanes(), 256 lanes at a time
+                int rows = 1<<inputc;
+                __m256i v[rows];
+                for (int r=0; r<rows; r++) {
+                    v[r] = eval_index(in->gate->truth_table, r) ? ones : _mm256_setzero_si256();
+                }
+                for (int i=inputc-1; i>=0; i--) {
+                    __m256i x = AVX2_SLOT(i);
+                    rows >>= 1;
+                    for (int j=0; j<rows; j++) {
+                        v[j] = _mm256_or_si256(_mm256_and_si256(x, v[2*j+1]), _mm256_andnot_si256(x, v[2*j]));
+                    }
                 }
+                res = v[0];
+                break;
+            }
+        }
 
-                // also add it to the list of components of the target subsystems, so
-                // that any references to it can be resolved
-                Node *nn = malloc(sizeof(Node));
-                nn->type = SUBSYSTEM_N;
-                nn->subsys = just_translated;    // -----: components cannot represent subsystems and putting the subsystem in the prototype field would be a violation of the field's logic, so we just use C's very static typing instead
-                nn->next = NULL;
-                ll_add(intermediate_components, nn);
+        #undef AVX2_SLOT
 
-            }
+        _mm256_storeu_si256((__m256i*)(slots + (size_t)in->out_slot*4), res);
+    }
+}
 
-            FILE *fp = fopen("koka", "w");
-            Node *c = only_gates_sub->components->head;
-            while(c!=NULL) {
-                
-                char *b = malloc(BUFSIZ);
-                comp_to_str(c->comp, b, BUFSIZ);
-                fprintf(fp, "%s\n", b);
-                free(b);
-                c = c->next;
-            }
-            fclose(fp);
+__attribute__((target("avx512f")))
+void run_program_avx512(SimProgram *p, uint64_t *slots) {
+
+    const __m512i ones = _mm512_set1_epi64(-1);
+
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        int inputc = in->gate->_inputc;
+        __m512i res = _mm512_setzero_si512();
+
+        // every slot is 8 words (512 lanes), which is exactly one register
+        #define AVX512_SLOT(i) _mm512_loadu_si512((void*)(slots + (size_t)in->in_slots[i]*8))
+
+        switch (in->op) {
+            case OP_CONST0:
+                break;
+            case OP_CONST1:
+                res = ones;
+                break;
+            case OP_BUF:
+                res = AVX512_SLOT(0);
+                break;
+            case OP_NOT:
+                res = _mm512_xor_si512(AVX512_SLOT(0), ones);
+                break;
+            case OP_AND:
+            case OP_NAND:
+                res = ones;
+                for (int i=0; i<inputc; i++) res = _mm512_and_si512(res, AVX512_SLOT(i));
+                if (in->op == OP_NAND) res = _mm512_xor_si512(res, ones);
+                break;
+            case OP_OR:
+            case OP_NOR:
+                for (int i=0; i<inputc; i++) res = _mm512_or_si512(res, AVX512_SLOT(i));
+                if (in->op == OP_NOR) res = _mm512_xor_si512(res, ones);
+                break;
+            case OP_XOR:
+            case OP_XNOR:
+                for (int i=0; i<inputc; i++) res = _mm512_xor_si512(res, AVX512_SLOT(i));
+                if (in->op == OP_XNOR) res = _mm512_xor_si512(res, ones);
+                break;
+            default: {
+                // wide tables are looked up one lane at a time, one word at a time (see eval_lanes())
+                if (inputc > LUT_REDUCE_MAX_INPUTS) {
+                    uint64_t words[8], ins[inputc];
+                    for (int w=0; w<8; w++) {
+                        for (int i=0; i<inputc; i++) ins[i] = slots[(size_t)in->in_slots[i]*8 + w];
+                        words[w] = eval_lanes(in->gate->truth_table, inputc, ins);
+                    }
+                    res = _mm512_loadu_si512((void*)words);
+                    break;
+                }
 
-            // move on to the next subsystem
-            _comp = _comp->next;
-            for(int i=0; i<comp->_inputc; i++){
-                //free(inputs[i]);
+                // the same reduction as eval_lanes(), 512 lanes at a time (0xCA is the ternary logic code for a ? b : c)
+                int rows = 1<<inputc;
+                __m512i v[rows];
+                for (int r=0; r<rows; r++) {
+                    v[r] = eval_index(in->gate->truth_table, r) ? ones : _mm512_setzero_si512();
+                }
+                for (int i=inputc-1; i>=0; i--) {
+                    __m512i x = AVX512_SLOT(i);
+                    rows >>= 1;
+                    for (int j=0; j<rows; j++) {
+                        v[j] = _mm512_ternarylogic_epi64(x, v[2*j+1], v[2*j], 0xCA);
+                    }
+                }
+                res = v[0];
+                break;
             }
-            free(inputs);
-
         }
-        
-        // we have now filled the subsystems array with subsystems whose components are gates and numbered consistently
 
-        // now we need to map the outputs of target to gate only things
-        only_gates_sub->output_mappings = malloc(sizeof(char*) * only_gates_sub->_outputc); // +1 for the null byte
+        #undef AVX512_SLOT
 
-        for(int i=0; i<target->_outputc; i++) {
-            
-            Mapping *om = target->o_maps[i];
+        _mm512_storeu_si512((void*)(slots + (size_t)in->out_slot*8), res);
+    }
+}
 
-            // resolve the mapping according to its type
-            if (om->type == SUBSYS_INPUT) {
+int cpu_has_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
 
-                // then all we need to do is put the name of the input in the output mapping list
-                only_gates_sub->output_mappings[i] = malloc(strlen(target->inputs[om->index])+1); // +1 for the null byte
-                strncpy(only_gates_sub->output_mappings[i], target->inputs[om->index], strlen(target->inputs[om->index])+1);
+int cpu_has_avx512() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+}
 
-            } else if (om->type == SUBSYS_COMP) {
+#endif
 
-                // find out the component that the mapping maps to, which will now be in intermediate_components
-                Node *rtcn = move_in_list(om->index, intermediate_components); // referred-to component node
+void run_program_words4(SimProgram *p, uint64_t *slots) {
+    run_program_words(p, slots, 4);
+}
+
+void run_program_words8(SimProgram *p, uint64_t *slots) {
+    run_program_words(p, slots, 8);
+}
+
+/*
+    Every width has a portable kernel, so that any width can be asked for on any CPU, and
+    possibly a faster one that needs some instruction set. The kernels are listed by width,
+    and the SIMD kernel of a width right after the portable one, so that the last supported
+    kernel of a width is the fastest one.
+*/
+SimKernel sim_kernels[] = {
+    {"scalar",      1, run_program_lanes,   NULL},
+    {"portable256", 4, run_program_words4,  NULL},
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx2",        4, run_program_avx2,    cpu_has_avx2},
+#endif
+    {"portable512", 8, run_program_words8,  NULL},
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx512",      8, run_program_avx512,  cpu_has_avx512},
+#endif
+    {NULL,          0, NULL,                NULL}
+};
+
+SimKernel *select_kernel(int width) {
+
+    // if any width goes, the plain 64-lane kernel is used unless the CPU has a SIMD one
+    SimKernel *best = (width == 0) ? &(sim_kernels[0]) : NULL;
+
+    for (SimKernel *k=sim_kernels; k->name!=NULL; k++) {
+
+        // skip the kernels that this CPU cannot run
+        if (k->supported != NULL && !k->supported()) continue;
+
+        // keep the last one of the requested width, or the widest SIMD one if any width goes
+        if (k->width == width || (width == 0 && k->supported != NULL)) {
+            best = k;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Write the expression of the rows [first, first+rows) of the truth table of the given
+ * instruction, where the inputs before the given one are already decided: a tree of muxes
+ * on the remaining inputs, with the parts of the table that are constant folded away.
+*/
+void lut_expr_to_c(SimInstr *in, int input, int first, int rows, FILE *fp) {
+
+    uint64_t *tt = in->gate->truth_table;
+    int half = rows/2;
+
+    // count the ones in the half where the input is 0 and in the half where it is 1, and check if the halves are the same
+    int lo_ones = 0, hi_ones = 0, same = 1;
+    for (int r=0; r<half; r++) {
+        lo_ones += eval_index(tt, first+r);
+        hi_ones += eval_index(tt, first+half+r);
+        if (eval_index(tt, first+r) != eval_index(tt, first+half+r)) same = 0;
+    }
+
+    if (lo_ones+hi_ones == 0) {
+        fprintf(fp, "(uint64_t)0");
+    } else if (lo_ones+hi_ones == rows) {
+        fprintf(fp, "~(uint64_t)0");
+    } else if (lo_ones == 0 && hi_ones == half) {
+        fprintf(fp, "S(%d)", in->in_slots[input]);
+    } else if (lo_ones == half && hi_ones == 0) {
+        fprintf(fp, "~S(%d)", in->in_slots[input]);
+    } else if (same) {
+        // the input does not matter here
+        lut_expr_to_c(in, input+1, first, half, fp);
+    } else if (hi_ones == half || hi_ones == 0) {
+        // the half where the input is 1 is constant, so only the other half is left
+        fprintf(fp, (hi_ones == half) ? "(S(%d) | " : "(~S(%d) & ", in->in_slots[input]);
+        lut_expr_to_c(in, input+1, first, half, fp);
+        fprintf(fp, ")");
+    } else if (lo_ones == half || lo_ones == 0) {
+        // the same, with the half where the input is 0
+        fprintf(fp, (lo_ones == half) ? "(~S(%d) | " : "(S(%d) & ", in->in_slots[input]);
+        lut_expr_to_c(in, input+1, first+half, half, fp);
+        fprintf(fp, ")");
+    } else {
+        fprintf(fp, "((S(%d) & ", in->in_slots[input]);
+        lut_expr_to_c(in, input+1, first+half, half, fp);
+        fprintf(fp, ") | (~S(%d) & ", in->in_slots[input]);
+        lut_expr_to_c(in, input+1, first, half, fp);
+        fprintf(fp, "))");
+    }
+}
+
+int program_to_c(SimProgram *p, int width, FILE *fp) {
+
+    if (p == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    fprintf(fp, "/* generated by program_to_c(), %d slots, %d gates */\n", p->slotc, p->instrc);
+    fprintf(fp, "#include <stdint.h>\n\n");
+    fprintf(fp, "#define W %d\n", width);
+    fprintf(fp, "#define S(i) slots[(i)*W+w]\n\n");
+
+    // the wide truth tables are looked up, so they are written as constant tables
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        if (in->op != OP_LUT || in->gate->_inputc <= LUT_REDUCE_MAX_INPUTS) continue;
+
+        fprintf(fp, "static const uint64_t tt_%d[] = {", k);
+        for (int i=0; i<TT_WORDS(in->gate->_inputc); i++) {
+            fprintf(fp, "%s0x%016llxULL", i ? ", " : "", (unsigned long long) in->gate->truth_table[i]);
+        }
+        fprintf(fp, "};\n");
+    }
+
+    fprintf(fp, "\nvoid sim_kernel(uint64_t *slots) {\n");
+
+    // one statement per gate, in the order of the program
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        int inputc = in->gate->_inputc;
+
+        // the operator that joins the inputs, and whether the result is inverted
+        char *op = NULL;
+        int invert = 0;
+        switch (in->op) {
+            case OP_AND:  op = " & "; break;
+            case OP_NAND: op = " & "; invert = 1; break;
+            case OP_OR:   op = " | "; break;
+            case OP_NOR:  op = " | "; invert = 1; break;
+            case OP_XOR:  op = " ^ "; break;
+            case OP_XNOR: op = " ^ "; invert = 1; break;
+            default: break;
+        }
+
+        if (in->op == OP_LUT && inputc > LUT_REDUCE_MAX_INPUTS) {
+
+            // look up the row of every lane on its own (see eval_lanes())
+            fprintf(fp, "    for (int w=0; w<W; w++) {\n");
+            fprintf(fp, "        uint64_t res = 0;\n");
+            fprintf(fp, "        for (int l=0; l<64; l++) {\n");
+            fprintf(fp, "            int x = 0");
+            for (int i=0; i<inputc; i++) {
+                fprintf(fp, " | (int)(((S(%d) >> l) & 1) << %d)", in->in_slots[i], inputc-1-i);
+            }
+            fprintf(fp, ";\n");
+            fprintf(fp, "            res |= ((tt_%d[x >> 6] >> (x & 63)) & 1) << l;\n", k);
+            fprintf(fp, "        }\n");
+            fprintf(fp, "        S(%d) = res;\n", in->out_slot);
+            fprintf(fp, "    }\n");
+            continue;
+        }
+
+        fprintf(fp, "    for (int w=0; w<W; w++) S(%d) = ", in->out_slot);
+
+        switch (in->op) {
+            case OP_CONST0:
+                fprintf(fp, "(uint64_t)0");
+                break;
+            case OP_CONST1:
+                fprintf(fp, "~(uint64_t)0");
+                break;
+            case OP_BUF:
+                fprintf(fp, "S(%d)", in->in_slots[0]);
+                break;
+            case OP_NOT:
+                fprintf(fp, "~S(%d)", in->in_slots[0]);
+                break;
+            case OP_LUT:
+                lut_expr_to_c(in, 0, 0, 1<<inputc, fp);
+                break;
+            default:
+                fprintf(fp, "%s(", invert ? "~" : "");
+                for (int i=0; i<inputc; i++) {
+                    fprintf(fp, "%sS(%d)", i ? op : "", in->in_slots[i]);
+                }
+                fprintf(fp, ")");
+                break;
+        }
+
+        fprintf(fp, ";\n");
+    }
+
+    fprintf(fp, "}\n");
+
+    return 0;
+}
+
+/**
+ * @brief   Write what identifies the CPU that native code is compiled for (-march=native) to the
+ *          given stream: its vendor, family/model, feature flags and brand string.
+*/
+void cpu_identity_to_file(FILE *fp) {
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int regs[4] = {0};
+    unsigned int leaves[] = {0, 1, 7, 0x80000001, 0x80000002, 0x80000003, 0x80000004};
+
+    for (int i=0; i<(int)(sizeof(leaves)/sizeof(leaves[0])); i++) {
+        memset(regs, 0, sizeof(regs));
+        __get_cpuid_count(leaves[i], 0, &regs[0], &regs[1], &regs[2], &regs[3]);
+
+        // the initial APIC id (in ebx of leaf 1) differs between cores of the same CPU
+        if (leaves[i] == 1) regs[1] &= 0x00ffffff;
+        fwrite(regs, sizeof(regs), 1, fp);
+    }
+#else
+    // elsewhere only the architecture is known
+    struct utsname u;
+    if (uname(&u) == 0) fprintf(fp, "%s\n", u.machine);
+#endif
+}
+
+/**
+ * @brief   Run the given C compiler (which may be a command with arguments, like "ccache gcc") with
+ *          NATIVE_CFLAGS to compile c_path into the shared object out_path. The compiler is run
+ *          directly, not through a shell, so the paths may contain any character.
+ *          Return the exit status of the compiler, -1 if it could not be run.
+*/
+int run_native_cc(char *cc, char *out_path, char *c_path) {
+
+    // split the compiler command and the flags on whitespace
+    char words[strlen(cc)+strlen(NATIVE_CFLAGS)+2];
+    sprintf(words, "%s %s", cc, NATIVE_CFLAGS);
+
+    char *argv[strlen(words)/2+5];
+    int argc = 0;
+    char *save = NULL;
+    for (char *w=strtok_r(words, " \t", &save); w!=NULL; w=strtok_r(NULL, " \t", &save)) {
+        argv[argc++] = w;
+    }
+    argv[argc++] = "-o";
+    argv[argc++] = out_path;
+    argv[argc++] = c_path;
+    argv[argc] = NULL;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int compile_program_native(SimProgram *p, int width, char *cache_dir) {
+
+    if (p == NULL || cache_dir == NULL) {
+        return NARG;
+    }
+
+    if (!p->levelized) {
+        fprintf(stderr, "only programs without cycles can be compiled to native code\n");
+        return GENERIC_ERROR;
+    }
+
+    char *cc = getenv("CC");
+    if (cc == NULL || cc[0] == '\0') {
+        cc = NATIVE_CC;
+    }
+
+    // generate the source in memory first
+    char *src = NULL;
+    size_t src_len = 0;
+    FILE *mem = open_memstream(&src, &src_len);
+    program_to_c(p, width, mem);
+    fclose(mem);
+
+    // the name of the shared object is a hash of everything that the machine code depends on:
+    // the source, the compiler, its flags and the CPU that -march=native compiles for
+    char *key = NULL;
+    size_t key_len = 0;
+    mem = open_memstream(&key, &key_len);
+    fprintf(mem, "%s\n%s\n", cc, NATIVE_CFLAGS);
+    cpu_identity_to_file(mem);
+    fwrite(src, 1, src_len, mem);
+    fclose(mem);
+
+    unsigned long long hash = hash_bytes(key, key_len);
+    free(key);
+
+    // the cache directory may already exist, any other problem shows up when it is written to
+    mkdir(cache_dir, 0755);
+
+    char so_path[strlen(cache_dir)+64];
+    sprintf(so_path, "%s/sim_%016llx.so", cache_dir, hash);
+
+    // compile only if this source has not been compiled before
+    if (access(so_path, R_OK) != 0) {
+
+        // work on files named after the process, and only rename the finished object into place,
+        // so that simulations running at the same time never load half of one
+        char c_path[strlen(cache_dir)+64], tmp_path[strlen(cache_dir)+64];
+        sprintf(c_path, "%s/sim_%016llx.%d.c", cache_dir, hash, getpid());
+        sprintf(tmp_path, "%s/sim_%016llx.%d.so", cache_dir, hash, getpid());
+
+        FILE *fp = fopen(c_path, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "could not write the generated source to %s\n", c_path);
+            free(src);
+            return GENERIC_ERROR;
+        }
+        fwrite(src, 1, src_len, fp);
+        fclose(fp);
+
+        int rc = run_native_cc(cc, tmp_path, c_path);
+
+        remove(c_path);
+
+        if (rc != 0 || rename(tmp_path, so_path) != 0) {
+            fprintf(stderr, "could not compile the generated source (%s %s -o %s %s)\n", cc, NATIVE_CFLAGS, tmp_path, c_path);
+            remove(tmp_path);
+            free(src);
+            return GENERIC_ERROR;
+        }
+    }
+
+    free(src);
+
+    // load the compiled code
+    void *handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "could not load %s: %s\n", so_path, dlerror());
+        return GENERIC_ERROR;
+    }
+
+    void (*native)(uint64_t*) = (void (*)(uint64_t*)) dlsym(handle, "sim_kernel");
+    if (native == NULL) {
+        fprintf(stderr, "%s does not contain a simulation kernel\n", so_path);
+        dlclose(handle);
+        return GENERIC_ERROR;
+    }
+
+    // replace any code that was loaded before (e.g. with another width)
+    if (p->native_handle != NULL) {
+        dlclose(p->native_handle);
+    }
+
+    p->native = native;
+    p->native_width = width;
+    p->native_handle = handle;
+
+    return 0;
+}
+
+void run_program_native(SimProgram *p, uint64_t *slots) {
+    p->native(slots);
+}
+
+/**
+ * The machine code of jit_compile_program(), as it is being written.
+*/
+typedef struct jit_buf {
+    unsigned char *code;    // the bytes written so far
+    size_t len;             // how many they are
+    size_t cap;             // how many fit in code
+} JitBuf;
+
+/**
+ * Append n bytes to the code (and grow it if needed).
+*/
+void jit_emit(JitBuf *b, unsigned char *bytes, int n) {
+
+    if (b->len + n > b->cap) {
+        b->cap = 2*b->cap + n;
+        b->code = realloc(b->code, b->cap);
+    }
+
+    memcpy(b->code + b->len, bytes, n);
+    b->len += n;
+}
+
+/**
+ * Append an instruction with a 4 byte immediate or displacement after its opcode bytes.
+*/
+void jit_emit_imm32(JitBuf *b, unsigned char *op, int n, int32_t imm) {
+    jit_emit(b, op, n);
+    jit_emit(b, (unsigned char*) &imm, 4);
+}
+
+/**
+ * Append an instruction with an 8 byte immediate after its opcode bytes.
+*/
+void jit_emit_imm64(JitBuf *b, unsigned char *op, int n, uint64_t imm) {
+    jit_emit(b, op, n);
+    jit_emit(b, (unsigned char*) &imm, 8);
+}
+
+int jit_compile_program(SimProgram *p, int width) {
+
+    if (p == NULL) {
+        return NARG;
+    }
+
+    // whatever happens, the fallback works with this width
+    if (p->jit_code != NULL) {
+        munmap(p->jit_code, p->jit_size);
+    }
+    p->jit = NULL;
+    p->jit_code = NULL;
+    p->jit_size = 0;
+    p->jit_width = width;
+
+#if defined(__x86_64__)
+
+    if (!p->levelized) {
+        fprintf(stderr, "only programs without cycles can be translated to machine code\n");
+        return GENERIC_ERROR;
+    }
+
+    JitBuf b = {NULL, 0, 0};
+
+    // the slots are kept in rbx (callee-saved, so the calls to jit_eval_lut() leave it alone), and
+    // pushing it also keeps the stack aligned to 16 bytes for those calls
+    jit_emit(&b, (unsigned char[]){0x53}, 1);                   // push rbx
+    jit_emit(&b, (unsigned char[]){0x48, 0x89, 0xFB}, 3);       // mov rbx, rdi
+
+    // the operand of every memory access is [rbx + disp32], the address of one word of a slot
+    #define JIT_DISP(slot, w) ((int32_t) (((size_t)(slot)*width + (w)) * sizeof(uint64_t)))
+
+    for (int k=0; k<p->instrc; k++) {
+
+        SimInstr *in = &(p->instrs[k]);
+        int inputc = in->gate->_inputc;
+
+        if (in->op == OP_LUT) {
+
+            // jit_eval_lut(in, slots, width)
+            jit_emit_imm64(&b, (unsigned char[]){0x48, 0xBF}, 2, (uint64_t) in);               // mov rdi, in
+            jit_emit(&b, (unsigned char[]){0x48, 0x89, 0xDE}, 3);                               // mov rsi, rbx
+            jit_emit_imm32(&b, (unsigned char[]){0xBA}, 1, width);                              // mov edx, width
+            jit_emit_imm64(&b, (unsigned char[]){0x48, 0xB8}, 2, (uint64_t) jit_eval_lut);     // mov rax, jit_eval_lut
+            jit_emit(&b, (unsigned char[]){0xFF, 0xD0}, 2);                                     // call rax
+            continue;
+        }
+
+        // the opcode that combines rax with the next input, and whether the result is inverted
+        unsigned char combine = 0;
+        int invert = (in->op == OP_NOT || in->op == OP_NAND || in->op == OP_NOR || in->op == OP_XNOR);
+        switch (in->op) {
+            case OP_AND: case OP_NAND: combine = 0x23; break;
+            case OP_OR:  case OP_NOR:  combine = 0x0B; break;
+            case OP_XOR: case OP_XNOR: combine = 0x33; break;
+            default: break;
+        }
+
+        for (int w=0; w<width; w++) {
+
+            if (in->op == OP_CONST0) {
+                jit_emit(&b, (unsigned char[]){0x31, 0xC0}, 2);                                 // xor eax, eax
+            } else if (in->op == OP_CONST1) {
+                jit_emit_imm32(&b, (unsigned char[]){0x48, 0xC7, 0xC0}, 3, -1);                 // mov rax, -1
+            } else {
+
+                jit_emit_imm32(&b, (unsigned char[]){0x48, 0x8B, 0x83}, 3, JIT_DISP(in->in_slots[0], w));  // mov rax, [rbx+disp]
+                for (int i=1; i<inputc && combine; i++) {
+                    jit_emit_imm32(&b, (unsigned char[]){0x48, combine, 0x83}, 3, JIT_DISP(in->in_slots[i], w));  // and/or/xor rax, [rbx+disp]
+                }
+
+                if (invert) {
+                    jit_emit(&b, (unsigned char[]){0x48, 0xF7, 0xD0}, 3);                       // not rax
+                }
+            }
+
+            jit_emit_imm32(&b, (unsigned char[]){0x48, 0x89, 0x83}, 3, JIT_DISP(in->out_slot, w));          // mov [rbx+disp], rax
+        }
+    }
+
+    #undef JIT_DISP
+
+    jit_emit(&b, (unsigned char[]){0x5B}, 1);   // pop rbx
+    jit_emit(&b, (unsigned char[]){0xC3}, 1);   // ret
+
+    // copy the code into its own pages, which are made executable (and no longer writable) once it is there
+    void *code = mmap(NULL, b.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        fprintf(stderr, "could not map memory for the jit code\n");
+        free(b.code);
+        return GENERIC_ERROR;
+    }
+
+    memcpy(code, b.code, b.len);
+    free(b.code);
+
+    if (mprotect(code, b.len, PROT_READ | PROT_EXEC) != 0) {
+        fprintf(stderr, "could not make the jit code executable\n");
+        munmap(code, b.len);
+        return GENERIC_ERROR;
+    }
+
+    p->jit = (void (*)(uint64_t*)) code;
+    p->jit_code = code;
+    p->jit_size = b.len;
+
+    return 0;
+
+#else
+
+    fprintf(stderr, "the jit only generates x86-64 code\n");
+    return GENERIC_ERROR;
+
+#endif
+}
+
+void run_program_jit(SimProgram *p, uint64_t *slots) {
+
+    if (p->jit != NULL) {
+        p->jit(slots);
+    } else {
+        run_program_words(p, slots, p->jit_width);
+    }
+}
+
+void jit_eval_lut(SimInstr *in, uint64_t *slots, int width) {
+
+    int inputc = in->gate->_inputc;
+    uint64_t ins[inputc+1];
+
+    for (int w=0; w<width; w++) {
+        for (int i=0; i<inputc; i++) ins[i] = slots[(size_t)in->in_slots[i]*width+w];
+        slots[(size_t)in->out_slot*width+w] = eval_lanes(in->gate->truth_table, inputc, ins);
+    }
+}
+
+int jit_check(Subsystem *s, int vectors, unsigned int seed) {
+
+    if (s == NULL) {
+        return NARG;
+    }
+
+    // the reference
+    Simulator *sim = simulator_init(s);
+    if (sim == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    // only gates can be translated, a subsystem that instantiates subsystems has a model instead
+    SimProgram *p = s->program;
+    if (sim->model != NULL || (p->jit == NULL && jit_compile_program(p, JIT_WIDTH))) {
+        free_simulator(sim);
+        return GENERIC_ERROR;
+    }
+
+    int width = p->jit_width;
+    int inputc = s->_inputc;
+    uint64_t *slots = malloc(sizeof(uint64_t) * ((size_t)p->slotc*width+1));
+    uint64_t *in_bits = malloc(sizeof(uint64_t) * (inputc/64 + 1));
+    uint64_t *out_bits = malloc(sizeof(uint64_t) * (s->_outputc/64 + 1));
+
+    srand(seed);
+
+    int mismatches = 0;
+    for (int first=0; first<vectors; first+=64*width) {
+
+        // random inputs in every lane
+        for (int i=0; i<inputc*width; i++) {
+            slots[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+        }
+
+        run_program_jit(p, slots);
+
+        // every lane (that is a vector to be checked) must agree with the simulator
+        int lanes = (vectors-first < 64*width) ? vectors-first : 64*width;
+        for (int l=0; l<lanes; l++) {
+
+            memset(in_bits, 0, sizeof(uint64_t) * (inputc/64 + 1));
+            for (int i=0; i<inputc; i++) {
+                in_bits[i/64] |= ((slots[(size_t)i*width + l/64] >> (l%64)) & 1) << (i%64);
+            }
+
+            simulator_run(sim, in_bits, out_bits);
+
+            for (int o=0; o<s->_outputc; o++) {
+
+                int expected = (out_bits[o/64] >> (o%64)) & 1;
+                int got = (slots[(size_t)p->out_slots[o]*width + l/64] >> (l%64)) & 1;
+
+                if (expected != got) {
+                    fprintf(stderr, "jit mismatch in vector %d, output %s: expected %d, got %d\n", first+l, s->outputs[o], expected, got);
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(slots);
+    free(in_bits);
+    free(out_bits);
+    free_simulator(sim);
+
+    return mismatches;
+}
+
+int extract_truth_tables(Subsystem *s, uint64_t ***tables) {
+
+    if (s == NULL || tables == NULL) {
+        return NARG;
+    }
+
+    int inputc = s->_inputc;
+    if (inputc > MAX_EXTRACT_INPUTS) {
+        fprintf(stderr, "subsystem %s has %d inputs, truth tables can only be extracted for up to %d\n", s->name, inputc, MAX_EXTRACT_INPUTS);
+        return GENERIC_ERROR;
+    }
+
+    // a subsystem that instantiates subsystems is enumerated through a flattened copy of it
+    if (!subsys_gate_only(s)) {
+
+        Arena *arena = arena_init(0);
+        Subsystem *flat = subsys_flatten(s, 1, arena);
+        int _en = flat != NULL ? extract_truth_tables(flat, tables) : GENERIC_ERROR;
+        if (flat != NULL) free_subsystem(flat, 1);
+        arena_free(arena);
+
+        return _en;
+    }
+
+    // compile the subsystem the first time it is simulated
+    if (s->program == NULL) {
+        int _en;
+        if ( (_en=compile_subsystem(s, &(s->program))) ) return _en;
+    }
+
+    SimProgram *p = s->program;
+    if (!p->levelized) {
+        fprintf(stderr, "subsystem %s has a combinational cycle, its truth tables cannot be extracted\n", s->name);
+        return GENERIC_ERROR;
+    }
+
+    // the widest kernel that this CPU supports does the enumeration
+    SimKernel *kernel = select_kernel(0);
+    int width = kernel->width;
+
+    int rows = 1<<inputc;
+    int words = (rows+63)/64;
+
+    *tables = malloc(sizeof(uint64_t*) * (s->_outputc+1));
+    for (int o=0; o<s->_outputc; o++) {
+        (*tables)[o] = malloc(sizeof(uint64_t) * (words+1));
+    }
+
+    // the value of input bit b (counting from the LSB of the row) in the lanes of a word
+    const uint64_t patterns[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+
+    uint64_t *slots = malloc(sizeof(uint64_t) * ((size_t)p->slotc*width+1));
+
+    // every pass simulates the rows of width consecutive words of the tables
+    for (int first=0; first<words; first+=width) {
+
+        for (int i=0; i<inputc; i++) {
+
+            // the first input is the MSB of the row
+            int bit = inputc-1-i;
+
+            for (int w=0; w<width; w++) {
+                if (bit < 6) {
+                    slots[(size_t)i*width+w] = patterns[bit];
+                } else {
+                    // rows 64*(first+w) to 64*(first+w)+63 all have the same value in the higher bits
+                    slots[(size_t)i*width+w] = ((((size_t)(first+w))*64 >> bit) & 1) ? ~(uint64_t)0 : 0;
+                }
+            }
+        }
+
+        kernel->run(p, slots);
+
+        for (int o=0; o<s->_outputc; o++) {
+            for (int w=0; w<width && first+w<words; w++) {
+                (*tables)[o][first+w] = slots[(size_t)p->out_slots[o]*width+w];
+            }
+        }
+    }
+
+    // a table of less than 64 rows only keeps the lanes that are actual rows
+    if (rows < 64) {
+        for (int o=0; o<s->_outputc; o++) {
+            (*tables)[o][0] &= ((uint64_t)1 << rows) - 1;
+        }
+    }
+
+    free(slots);
+
+    return 0;
+}
+
+int collapse_to_luts(Subsystem *s, Netlist *gate_lib) {
+
+    if (s == NULL || gate_lib == NULL) {
+        return NARG;
+    }
+
+    if (!s->is_standard || s->_inputc > MAX_GATE_INPUTS) {
+        fprintf(stderr, "subsystem %s cannot be collapsed into LUT gates (it must be a standard subsystem with up to %d inputs)\n", s->name, MAX_GATE_INPUTS);
+        return GENERIC_ERROR;
+    }
+
+    uint64_t **tables = NULL;
+    int _en;
+    if ( (_en=extract_truth_tables(s, &tables)) ) return _en;
+
+    // the old gates (and everything that was derived from them) are no longer needed
+    ll_free(s->components, 1);
+    s->components = ll_init_in(s->arena);
+    free_index(s->comp_index);
+    s->comp_index = NULL;
+    free_comp_store(s->store);
+    s->store = NULL;
+    free_flat_template(s->tmpl);
+    s->tmpl = NULL;
+    if (s->aliases != NULL) {
+        ll_free(s->aliases, 1);
+        s->aliases = NULL;
+    }
+    free_index(s->alias_index);
+    s->alias_index = NULL;
+    free_program(s->program);
+    s->program = NULL;
+    free_model(s->model);
+    s->model = NULL;
+
+    for (int o=0; o<s->_outputc; o++) {
+
+        // create the LUT gate of the output (in the arena of the gate library, if it has one)...
+        Gate *g = alloc_in(gate_lib->arena, sizeof(Gate));
+        char *name = malloc(strlen(s->name)+strlen(s->outputs[o])+strlen("_LUT_")+1);
+        sprintf(name, "%s_LUT_%s", s->name, s->outputs[o]);
+        g->name = intern(name, strlen(name));
+        free(name);
+        g->_inputc = sym_list_copy(&(g->inputs), s->inputs, s->_inputc, gate_lib->arena);
+        g->truth_table = tables[o];
+        if (gate_lib->arena != NULL) {
+            g->truth_table = arena_alloc(gate_lib->arena, sizeof(uint64_t) * TT_WORDS(s->_inputc));
+            memcpy(g->truth_table, tables[o], sizeof(uint64_t) * TT_WORDS(s->_inputc));
+            free(tables[o]);
+        }
+
+        // ...add it to the gate library...
+        Standard *std = alloc_in(gate_lib->arena, sizeof(Standard));
+        std->type = GATE;
+        std->gate = g;
+        std->defined_in = gate_lib;
+        if ( (_en=add_to_lib(gate_lib, std, 1, GATE)) ) return _en;
+
+        // ...and make it the component that drives the output, reading all the inputs of the subsystem
+        Component *c = alloc_in(s->arena, sizeof(Component));
+        c->id = o+1;
+        c->prototype = std;
+        c->is_standard = 1;
+        c->_inputc = sym_list_copy(&(c->inputs), s->inputs, s->_inputc, s->arena);
+        c->buffer_index = o;
+        c->i_maps = alloc_in(s->arena, sizeof(Mapping*) * (s->_inputc+1));
+        for (int i=0; i<s->_inputc; i++) {
+            c->i_maps[i] = alloc_in(s->arena, sizeof(Mapping));
+            c->i_maps[i]->type = SUBSYS_INPUT;
+            c->i_maps[i]->index = i;
+            c->i_maps[i]->out_index = 0;
+        }
+        if ( (_en=subsys_add_comp(s, c)) ) return _en;
+
+        // the output is now the output of the LUT (the components are in the order of the outputs)
+        char b[MAX_LINE_LEN];
+        snprintf(b, MAX_LINE_LEN, "%s%d", COMP_ID_PREFIX, c->id);
+        s->output_mappings[o] = intern(b, strlen(b));
+        s->o_maps[o]->type = SUBSYS_COMP;
+        s->o_maps[o]->index = o;
+        s->o_maps[o]->out_index = 0;
+    }
+
+    // the tables now belong to the gates
+    free(tables);
+
+    return 0;
+}
+
+int truth_tables_to_file(Subsystem *s, FILE *fp) {
+
+    if (s == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    clock_t start = clock();    // measure time of execution - initial timestamp
+
+    uint64_t **tables = NULL;
+    int _en;
+    if ( (_en=extract_truth_tables(s, &tables)) ) return _en;
+
+    clock_t end = clock();  // final timestamp
+    double actual_time = ((double) (end - start)) / CLOCKS_PER_SEC;
+
+    // print the header, just like execute_tb()
+    for (int i=0; i<s->_inputc; i++) {
+        fprintf(fp, "%-5s", s->inputs[i]);
+    }
+    fprintf(fp, "%-5c", '|');
+    for (int o=0; o<s->_outputc; o++) {
+        fprintf(fp, "%-5s", s->outputs[o]);
+    }
+    fprintf(fp, "\n");
+
+    // print every row
+    for (int r=0; r<(1<<s->_inputc); r++) {
+
+        for (int i=0; i<s->_inputc; i++) {
+            fprintf(fp, "%-5d", (r >> (s->_inputc-1-i)) & 1);
+        }
+
+        fprintf(fp, "%-5c", '|');
+
+        for (int o=0; o<s->_outputc; o++) {
+            fprintf(fp, "%-5d", eval_index(tables[o], r));
+        }
+
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "[%d rows, %.3f msec of enumerating]\n", 1<<s->_inputc, actual_time*1000);
+
+    // cleanup
+    for (int o=0; o<s->_outputc; o++) {
+        free(tables[o]);
+    }
+    free(tables);
+
+    return 0;
+}
+
+int gate_to_file(Gate *g, FILE *fp) {
+
+    if (g == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    fprintf(fp, "%s%s%s%s", DECL_DESIGNATION, g->name, GENERAL_DELIM, INPUT_DESIGNATION);
+
+    for (int i=0; i<g->_inputc; i++) {
+        fprintf(fp, "%s%s", i ? IN_OUT_DELIM : "", g->inputs[i]);
+    }
+
+    fprintf(fp, "%s", GENERAL_DELIM);
+
+    for (int r=0; r<(1<<g->_inputc); r++) {
+        fprintf(fp, "%s%d", r ? IN_OUT_DELIM : "", eval_index(g->truth_table, r));
+    }
+
+    fprintf(fp, "\n");
+
+    return 0;
+}
+
+void free_program(SimProgram *p) {
+
+    if (p != NULL) {
+
+        if (p->instrs != NULL) free(p->instrs);
+        if (p->fanin != NULL) free(p->fanin);
+        if (p->out_slots != NULL) free(p->out_slots);
+        if (p->fanout_start != NULL) free(p->fanout_start);
+        if (p->fanout != NULL) free(p->fanout);
+        if (p->level != NULL) free(p->level);
+        if (p->native_handle != NULL) dlclose(p->native_handle);
+        if (p->jit_code != NULL) munmap(p->jit_code, p->jit_size);
+
+        free(p);
+    }
+}
+
+int simulate(Subsystem* s, char *inputs, int *display_outs, FILE* fp) {
+
+
+    clock_t _start = clock();    // measure time of execution - initial timestamp
+
+    if (s == NULL || inputs==NULL) {
+        return NARG;
+    }
+
+    // the inputs are only looked at once, there is no need to copy them into a list
+    int ic = count_tokens(inputs, SIM_INPUT_DELIM);
+
+    // check that the number of inputs is the expected one
+    if (ic != s->_inputc) {
+        fprintf(stderr, "simulation error: got %d inputs, expected %d\n", ic, s->_inputc);
+        return GENERIC_ERROR;
+    }
+
+    int *int_inputs = malloc(sizeof(int)*s->_inputc);
+
+    // make the inputs integers (so that they are usable in the simulation)
+    StrView tok;
+    char *_inputs = inputs;
+    for (int i=0; i<s->_inputc; i++) {
+        
+        // only check the first byte (suffices if everything is done right)
+        next_token(&_inputs, SIM_INPUT_DELIM, &tok);
+        char c = tok.len > 0 ? tok.str[0] : '\0';
+
+        // check that it is a bit
+        if (c!='1' && c !='0') {
+            fprintf(stderr, "unexpected (non-bit) value found for input %s of subsystem %s: '%c'\n", s->inputs[i], s->name, c);
+            return GENERIC_ERROR;
+        }
+
+        // convert to int
+        int_inputs[i] = c - '0';
+    }
+
+
+    // everything that does not depend on the inputs is prepared by the simulator
+    Simulator *sim = simulator_init(s);
+    if (sim == NULL) {
+        fprintf(stderr, "subsystem %s cannot be simulated\n", s->name);
+        return GENERIC_ERROR;
+    }
+
+    // pack the inputs into bits
+    uint64_t in_bits[s->_inputc/64 + 1];
+    uint64_t out_bits[s->_outputc/64 + 1];
+    memset(in_bits, 0, sizeof(in_bits));
+    for (int i=0; i<s->_inputc; i++) {
+        in_bits[i/64] |= (uint64_t)int_inputs[i] << (i%64);
+    }
+
+    clock_t start = clock();    // measure time of execution - initial timestamp
+
+    simulator_run(sim, in_bits, out_bits);
+
+    clock_t end = clock();  // final timestamp
+
+    double actual_time = ((double) (end - start)) / CLOCKS_PER_SEC;
+    double total_time = ((double) (end - _start)) / CLOCKS_PER_SEC;
+
+    // print the results
+    for(int i=0; i<s->_inputc; i++) {
+        fprintf(fp!=NULL?fp:stderr, "%-5d", int_inputs[i]);
+    }
+
+    // print the delimiter
+    fprintf(fp!=NULL?fp:stderr, "%-5c", '|');
+
+    for(int i=0; i<s->_outputc; i++) {
+        if (display_outs[i]) {
+            fprintf(fp!=NULL?fp:stderr, "%-5d", (int)((out_bits[i/64] >> (i%64)) & 1));
+        }
+    }
+
+    fprintf(fp!=NULL?fp:stderr, "\t [%d iterations, %.3f msec of iterating, %.3f msec in total]\n", sim->iterations, actual_time*1000, total_time*1000);
+
+    // cleanup
+    free(int_inputs);
+    free_simulator(sim);
+
+    return 0;
+}
+
+int parse_tb_from_file(Testbench *tb, char *filename, char *mode) {
+
+    // open the file once, the lines are read from memory
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    char *line = NULL;  // belongs to the reader, no need to malloc or free it
+    int line_no = 0;
+
+    // initialize the values field of the testbench struct
+    tb->values = malloc(sizeof(char**) * tb->uut->_inputc);
+    memset(tb->values, 0, sizeof(char**) * tb->uut->_inputc);
+    tb->arena = arena_init(0);
+    tb->outs_display = malloc(sizeof(int)*tb->uut->_outputc);
+    memset(tb->outs_display, 0, sizeof(int)*tb->uut->_outputc);
+
+    tb->v_c = -1;
+
+    // loop through the lines of the file and get the contents
+    while(lr_next(r, &line) != -1) {
+        
+        line_no++;
+
+        if (strlen(line) != 0) {
+            
+            if (starts_with(line, TESTBENCH_IN)) {
+
+                while (1) {
+
+                    // read the next line
+                    if ( lr_next(r, &line) == -1 ) {
+                        printf("%s:%d: Error! File ended unexpectedly\n",filename, line_no);
+                        return UNEXPECTED_EOF;
+                    }
+                    line_no++;
+
+                    // check if we need to stop
+                    if (starts_with(line, TESTBENCH_OUT)) break;
+
+                    // keep a reference to be able to split
+                    char *_line = line;
+
+                    // split the line into its contents
+                    char *name = split(&_line, TB_GENERAL_DELIM);
+                    char *vals = _line;
+
+
+                    int in_index = -1;
+                    if ( (in_index = subsys_input(tb->uut, name)) == -1 ) {
+                        fprintf(stderr, "unknown input in testbench! uut of type %s has no input named %s\n", tb->uut->name, name);
+                        return GENERIC_ERROR;
+                    }
+
+
+                    // put the given values into a list, copied only once into the arena
+                    int v_c = str_to_arena_list(vals, &(tb->values[in_index]), TB_IN_VAL_DELIM, tb->arena);
+
+                    if (tb->v_c == -1 || v_c < tb->v_c) {
+                        tb->v_c = v_c;
+                    }
+
+                }
+    
+            } 
+            
+            if (starts_with(line, TESTBENCH_OUT)) {
+
+                while (lr_next(r, &line) != -1) {
+                    
+                    line_no++;
+
+
+                    int out_index = -1;
+                    if ( (out_index = subsys_output(tb->uut, line)) == -1 ) {
+                        fprintf(stderr, "unknown input in testbench! uut of type %s has no input named '%s'\n", tb->uut->name, line);
+                        return GENERIC_ERROR;
+                    }
+
+                    tb->outs_display[out_index] = 1;
+
+                }
+            }
+
+        }
+    }
+
+    lr_close(r);
+
+    return 0;
+}
+
+int execute_tb(Testbench *tb, char *output_file, char *mode) {
+
+    if (tb == NULL || output_file == NULL || mode == NULL) {
+        return NARG;
+    }
+
+    // open the file
+    FILE *fp = fopen(output_file, mode);
+    if (fp == NULL) {
+        fprintf(stderr, "execute_tb() encountered an error opening the file\n");
+        return GENERIC_ERROR;
+    }
+
+    // print the header
+
+    // print the inputs
+    for (int i=0; i<tb->uut->_inputc; i++) {
+        fprintf(fp, "%-5s", tb->uut->inputs[i]);
+    }
+
+    // print the delimiter
+    fprintf(fp, "%-5c", '|');
+
+    // print the outputs
+    for(int i=0; i<tb->uut->_outputc; i++) {
+        if (tb->outs_display[i]) {
+            fprintf(fp, "%-5s", tb->uut->outputs[i]);
+        }
+    }
+
+    // print a newline
+    fprintf(fp, "\n");
+
+    // run the tests, on many threads if asked to
+    int _en = (tb->threads > 1 && tb->v_c > 1) ? execute_tb_parallel(tb, fp) : execute_tb_vectors(tb, fp);
+
+    fclose(fp);
+
+    return _en;
+}
+
+int execute_tb_vectors(Testbench *tb, FILE *fp) {
+
+    if (tb == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    // a UUT that instantiates subsystems is simulated hierarchically, one test at a time (see subsys_model())
+    if (tb->mode != SIM_SCALAR && !subsys_gate_only(tb->uut)) {
+        fprintf(stderr, "subsystem %s instantiates subsystems, falling back to scalar (hierarchical) simulation\n", tb->uut->name);
+
+    // simulate 64 tests at a time, natively or event-driven if asked to (and if the UUT has no cycles)
+    } else if (tb->mode != SIM_SCALAR) {
+
+        int _en = 0;
+        if (tb->uut->program == NULL && (_en=compile_subsystem(tb->uut, &(tb->uut->program))) ) {
+            return _en;
+        }
+
+        if (tb->uut->program->levelized) {
+            return (tb->mode == SIM_EVENT) ? execute_tb_events(tb, fp) : execute_tb_bit_parallel(tb, fp);
+        }
+
+        fprintf(stderr, "subsystem %s has a combinational cycle, falling back to scalar simulation\n", tb->uut->name);
+    }
+
+    // one simulator for all the tests, so that nothing is allocated or parsed per test
+    Simulator *sim = simulator_init(tb->uut);
+    if (sim == NULL) {
+        fprintf(stderr, "subsystem %s cannot be simulated\n", tb->uut->name);
+        return GENERIC_ERROR;
+    }
+
+    int inputc = tb->uut->_inputc;
+    uint64_t *in_bits = malloc(sizeof(uint64_t) * (inputc/64 + 1));
+    uint64_t *out_bits = malloc(sizeof(uint64_t) * (tb->uut->_outputc/64 + 1));
+
+    // iterate over the tests
+    for (int test_no=0; test_no<tb->v_c; test_no++) {
+
+        clock_t _start = clock();    // measure time of execution - initial timestamp
+
+        // pack the value of each input for the particular test number into bits (assuming that the bit we want is the first in each value - the values are only strs because the function to parse a str into a list of strs was already written, technically they should be chars)
+        memset(in_bits, 0, sizeof(uint64_t) * (inputc/64 + 1));
+        for(int i=0; i<inputc; i++) {
+
+            char c = tb->values[i][test_no][0];
+            if (c!='1' && c!='0') {
+                fprintf(stderr, "unexpected (non-bit) value found for input %s of subsystem %s: '%c'\n", tb->uut->inputs[i], tb->uut->name, c);
+                free(in_bits);
+                free(out_bits);
+                free_simulator(sim);
+                return GENERIC_ERROR;
+            }
+
+            in_bits[i/64] |= (uint64_t)(c-'0') << (i%64);
+        }
+
+        clock_t start = clock();    // the time spent on the gates alone
+
+        simulator_run(sim, in_bits, out_bits);
+
+        clock_t end = clock();  // final timestamp
+        double actual_time = ((double) (end - start)) / CLOCKS_PER_SEC;
+        double total_time = ((double) (end - _start)) / CLOCKS_PER_SEC;
+
+        // print the results, in the same format as simulate()
+        for (int i=0; i<inputc; i++) {
+            fprintf(fp, "%-5d", (int)((in_bits[i/64] >> (i%64)) & 1));
+        }
+
+        fprintf(fp, "%-5c", '|');
+
+        for (int i=0; i<tb->uut->_outputc; i++) {
+            if (tb->outs_display[i]) {
+                fprintf(fp, "%-5d", (int)((out_bits[i/64] >> (i%64)) & 1));
+            }
+        }
+
+        fprintf(fp, "\t [%d iterations, %.3f msec of iterating, %.3f msec in total]\n", sim->iterations, actual_time*1000, total_time*1000);
+    }
+
+    // cleanup
+    free(in_bits);
+    free(out_bits);
+    free_simulator(sim);
+
+    return 0;
+}
+
+/**
+ * Make sure that the UUT of the given testbench is compiled to native code with the width
+ * that the testbench asks for (compiling it, or loading it from the cache, if it is not).
+*/
+int compile_tb_native(Testbench *tb) {
+
+    SimProgram *p = tb->uut->program;
+    int width = (tb->width > 0) ? tb->width : NATIVE_WIDTH;
+
+    if (p->native != NULL && p->native_width == width) {
+        return 0;
+    }
+
+    return compile_program_native(p, width, (tb->cache_dir != NULL) ? tb->cache_dir : NATIVE_CACHE_DIR);
+}
+
+/**
+ * Make sure that the UUT of the given testbench is translated to jit code with the width
+ * that the testbench asks for. If it cannot be, the interpreter is used instead.
+*/
+void compile_tb_jit(Testbench *tb) {
+
+    SimProgram *p = tb->uut->program;
+    int width = (tb->width > 0) ? tb->width : JIT_WIDTH;
+
+    if (p->jit_width == width) {
+        return;
+    }
+
+    if (jit_compile_program(p, width)) {
+        fprintf(stderr, "subsystem %s could not be translated to machine code, falling back to the interpreter\n", tb->uut->name);
+    }
+}
+
+/**
+ * The work that the threads of execute_tb_parallel() share: the chunks of the
+ * testbench and where the output of each one goes.
+*/
+typedef struct tb_pool {
+    Testbench *chunks;      // one testbench per chunk, each with a subset of the tests
+    char **out_bufs;        // the output of each chunk (see open_memstream())
+    size_t *out_lens;       // the length of the output of each chunk
+    int *results;           // the return value of execute_tb_vectors() for each chunk
+    int chunkc;             // the number of chunks
+} TbPool;
+
+/**
+ * Run chunk c for execute_tb_parallel() (see run_pool()).
+*/
+void tb_task(void *ctx, int c, Arena *arena, void **local) {
+
+    TbPool *pool = (TbPool*) ctx;
+
+    // run it into its own buffer, so that the outputs can be put back in order
+    FILE *out = open_memstream(&(pool->out_bufs[c]), &(pool->out_lens[c]));
+    pool->results[c] = execute_tb_vectors(&(pool->chunks[c]), out);
+    fclose(out);
+}
+
+int execute_tb_parallel(Testbench *tb, FILE *fp) {
+
+    if (tb == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    // the program (or the models of a UUT that instantiates subsystems) is shared between the
+    // threads, so it must be compiled before they start
+    int _en = 0;
+    enum SIM_MODE mode = tb->mode;
+    if (!subsys_gate_only(tb->uut)) {
+
+        if (subsys_model(tb->uut) == NULL) {
+            fprintf(stderr, "subsystem %s cannot be simulated\n", tb->uut->name);
+            return GENERIC_ERROR;
+        }
+
+        // warn about the fallback only once, instead of once per chunk
+        if (mode != SIM_SCALAR) {
+            fprintf(stderr, "subsystem %s instantiates subsystems, falling back to scalar (hierarchical) simulation\n", tb->uut->name);
+            mode = SIM_SCALAR;
+        }
+
+    } else if (tb->uut->program == NULL && (_en=compile_subsystem(tb->uut, &(tb->uut->program))) ) {
+        return _en;
+    }
+
+    // warn about the fallback only once, instead of once per chunk
+    if (mode != SIM_SCALAR && !tb->uut->program->levelized) {
+        fprintf(stderr, "subsystem %s has a combinational cycle, falling back to scalar simulation\n", tb->uut->name);
+        mode = SIM_SCALAR;
+    }
+
+    // the native code is shared too, so it is loaded before the threads start
+    if (mode == SIM_NATIVE && (_en=compile_tb_native(tb)) ) {
+        return _en;
+    }
+    if (mode == SIM_JIT) {
+        compile_tb_jit(tb);
+    }
+
+    // a few chunks per thread keeps all of them busy until the end, and chunks that are multiples
+    // of 512 tests keep the batches of the bit-parallel kernels full
+    int threads = (tb->threads < tb->v_c) ? tb->threads : tb->v_c;
+    int chunk_size = (tb->v_c + 4*threads - 1) / (4*threads);
+    if (mode == SIM_BIT_PARALLEL) {
+        chunk_size = (chunk_size + 511) / 512 * 512;
+    }
+
+    TbPool pool;
+    pool.chunkc = (tb->v_c + chunk_size - 1) / chunk_size;
+    pool.chunks = malloc(sizeof(Testbench) * pool.chunkc);
+    pool.out_bufs = malloc(sizeof(char*) * pool.chunkc);
+    pool.out_lens = malloc(sizeof(size_t) * pool.chunkc);
+    pool.results = malloc(sizeof(int) * pool.chunkc);
+
+    // every chunk is a copy of the testbench that only sees its own tests
+    for (int c=0; c<pool.chunkc; c++) {
+
+        int first = c*chunk_size;
+
+        pool.chunks[c] = *tb;
+        pool.chunks[c].mode = mode;
+        pool.chunks[c].threads = 1;
+        pool.chunks[c].v_c = (tb->v_c-first < chunk_size) ? tb->v_c-first : chunk_size;
+        pool.chunks[c].values = malloc(sizeof(char**) * (tb->uut->_inputc+1));
+        for (int i=0; i<tb->uut->_inputc; i++) {
+            pool.chunks[c].values[i] = tb->values[i] + first;
+        }
+
+        pool.out_bufs[c] = NULL;
+        pool.out_lens[c] = 0;
+        pool.results[c] = 0;
+    }
+
+    // run the chunks, which allocate nothing that outlives them
+    run_pool(&pool, tb_task, NULL, pool.chunkc, threads, NULL);
+
+    // write the outputs of the chunks in the original order of the tests
+    for (int c=0; c<pool.chunkc; c++) {
+
+        if (pool.results[c] && !_en) {
+            _en = pool.results[c];
+        }
+
+        if (!_en) {
+            fwrite(pool.out_bufs[c], 1, pool.out_lens[c], fp);
+        }
+
+        free(pool.out_bufs[c]);
+        free(pool.chunks[c].values);
+    }
+
+    // cleanup
+    free(pool.chunks);
+    free(pool.out_bufs);
+    free(pool.out_lens);
+    free(pool.results);
+
+    return _en;
+}
+
+int execute_tb_bit_parallel(Testbench *tb, FILE *fp) {
+
+    if (tb == NULL || fp == NULL || tb->uut->program == NULL) {
+        return NARG;
+    }
+
+    SimProgram *p = tb->uut->program;
+    int inputc = tb->uut->_inputc;
+
+    // choose the kernel that will do the work (this is where the CPU is checked), or compile one
+    SimKernel native_kernel = {"native", 0, run_program_native, NULL};
+    SimKernel jit_kernel = {"jit", 0, run_program_jit, NULL};
+    SimKernel *kernel = NULL;
+    if (tb->mode == SIM_NATIVE) {
+
+        int _en;
+        if ( (_en=compile_tb_native(tb)) ) return _en;
+
+        native_kernel.width = p->native_width;
+        kernel = &native_kernel;
+
+    } else if (tb->mode == SIM_JIT) {
+
+        compile_tb_jit(tb);
+
+        jit_kernel.width = p->jit_width;
+        if (p->jit == NULL) jit_kernel.name = "jit fallback";
+        kernel = &jit_kernel;
+
+    } else {
+
+        kernel = select_kernel(tb->width);
+        if (kernel == NULL) {
+            fprintf(stderr, "there is no simulation kernel that is %d words wide\n", tb->width);
+            return GENERIC_ERROR;
+        }
+    }
+
+    int width = kernel->width;
+    int batch = 64*width;
+
+    // width words per slot, each bit of which belongs to a different test
+    uint64_t *slots = malloc(sizeof(uint64_t) * ((size_t)p->slotc*width+1));
+
+    // iterate over the tests, one batch at a time
+    for (int first=0; first<tb->v_c; first+=batch) {
+
+        int lanes = (tb->v_c-first < batch) ? tb->v_c-first : batch;
+
+        clock_t start = clock();    // measure time of execution - initial timestamp
+
+        // pack the value of each input in every test of the batch into the input's slot
+        memset(slots, 0, sizeof(uint64_t) * inputc * width);
+        for (int i=0; i<inputc; i++) {
+
+            uint64_t *words = slots + (size_t)i*width;
+            for (int l=0; l<lanes; l++) {
+
+                // only check the first byte (see execute_tb())
+                char c = tb->values[i][first+l][0];
+                if (c!='1' && c!='0') {
+                    fprintf(stderr, "unexpected (non-bit) value found for input %s of subsystem %s: '%c'\n", tb->uut->inputs[i], tb->uut->name, c);
+                    free(slots);
+                    return GENERIC_ERROR;
+                }
+
+                words[l/64] |= (uint64_t)(c-'0') << (l%64);
+            }
+        }
+
+        // one pass simulates the whole batch
+        kernel->run(p, slots);
+
+        clock_t end = clock();  // final timestamp
+        double batch_time = ((double) (end - start)) / CLOCKS_PER_SEC;
+
+        // unpack and print the results of every test in the batch
+        for (int l=0; l<lanes; l++) {
+
+            for (int i=0; i<inputc; i++) {
+                fprintf(fp, "%-5d", (int)((slots[(size_t)i*width + l/64] >> (l%64)) & 1));
+            }
+
+            // print the delimiter
+            fprintf(fp, "%-5c", '|');
+
+            for (int i=0; i<tb->uut->_outputc; i++) {
+                if (tb->outs_display[i]) {
+                    fprintf(fp, "%-5d", (int)((slots[(size_t)p->out_slots[i]*width + l/64] >> (l%64)) & 1));
+                }
+            }
+
+            fprintf(fp, "\t [1 iterations, batch of %d tests (%s kernel), %.3f msec of iterating]\n", lanes, kernel->name, batch_time*1000);
+        }
+    }
+
+    free(slots);
+
+    return 0;
+}
+
+int execute_tb_events(Testbench *tb, FILE *fp) {
+
+    if (tb == NULL || fp == NULL || tb->uut->program == NULL) {
+        return NARG;
+    }
+
+    SimProgram *p = tb->uut->program;
+    int inputc = tb->uut->_inputc;
+
+    EventSim *sim = event_sim_init(p);
+    if (sim == NULL) {
+        fprintf(stderr, "subsystem %s cannot be simulated event-driven\n", tb->uut->name);
+        return GENERIC_ERROR;
+    }
+
+    int *inputs = malloc(sizeof(int) * inputc + 1);
+
+    // iterate over the tests, each one starts from the state that the previous one left behind
+    for (int test_no=0; test_no<tb->v_c; test_no++) {
+
+        clock_t start = clock();    // measure time of execution - initial timestamp
+
+        for (int i=0; i<inputc; i++) {
+
+            // only check the first byte (see execute_tb())
+            char c = tb->values[i][test_no][0];
+            if (c!='1' && c!='0') {
+                fprintf(stderr, "unexpected (non-bit) value found for input %s of subsystem %s: '%c'\n", tb->uut->inputs[i], tb->uut->name, c);
+                free(inputs);
+                free_event_sim(sim);
+                return GENERIC_ERROR;
+            }
+            inputs[i] = c-'0';
+        }
+
+        int evaluations = event_sim_step(sim, inputs);
+
+        clock_t end = clock();  // final timestamp
+        double test_time = ((double) (end - start)) / CLOCKS_PER_SEC;
+
+        // print the inputs and the outputs that should be displayed
+        for (int i=0; i<inputc; i++) {
+            fprintf(fp, "%-5d", inputs[i]);
+        }
+
+        fprintf(fp, "%-5c", '|');
+
+        for (int i=0; i<tb->uut->_outputc; i++) {
+            if (tb->outs_display[i]) {
+                fprintf(fp, "%-5d", SLOT_BIT(sim->bits, p->out_slots[i]));
+            }
+        }
+
+        fprintf(fp, "\t [%d evaluations, %.3f msec of iterating]\n", evaluations, test_time*1000);
+    }
+
+    free(inputs);
+    free_event_sim(sim);
+
+    return 0;
+}
+
+
+/**
+ * A table of a library image as it is being written: entries of one type, one after the other.
+*/
+typedef struct img_buf {
+    char *data;     // the entries written so far
+    size_t len;     // their size in bytes
+    size_t cap;     // how many bytes fit in data
+} ImgBuf;
+
+/**
+ * All the tables of a library image as it is being written (see lib_image_to_file()).
+*/
+typedef struct img_writer {
+    ImgBuf strings, string_offs, names, words, gates, subsystems, comps, maps, aliases;
+    uint32_t *refs;     // the position in string_offs of every interned name (by SymId), IMG_NONE if it is not written yet
+    SymId refc;         // the number of names in refs
+} ImgWriter;
+
+/**
+ * @brief   Append n entries of the given size to a table of an image, and return the position of the first one.
+*/
+uint32_t img_put(ImgBuf *b, void *entries, size_t size, int n) {
+
+    if (b->len + size*n > b->cap) {
+        b->cap = b->cap ? b->cap : 4096;
+        while (b->len + size*n > b->cap) b->cap *= 2;
+        b->data = realloc(b->data, b->cap);
+    }
+
+    uint32_t pos = b->len / size;
+    memcpy(b->data + b->len, entries, size*n);
+    b->len += size*n;
+
+    return pos;
+}
+
+/**
+ * @brief   Return the position in string_offs of an (interned) name, writing it to the image the first time it is met.
+*/
+uint32_t img_name(ImgWriter *w, char *sym) {
+
+    if (sym == NULL) {
+        return IMG_NONE;
+    }
+
+    SymId id = sym_id(sym);
+    if (id >= w->refc) {
+        return IMG_NONE;
+    }
+
+    if (w->refs[id] == IMG_NONE) {
+        uint32_t off = w->strings.len;
+        img_put(&(w->strings), sym, 1, strlen(sym)+1);
+        w->refs[id] = img_put(&(w->string_offs), &off, sizeof(uint32_t), 1);
+    }
+
+    return w->refs[id];
+}
+
+/**
+ * @brief   Write a list of n names to the names table of an image, and return the position of the first one.
+*/
+uint32_t img_names(ImgWriter *w, char **list, int n) {
+
+    if (list == NULL) {
+        return IMG_NONE;
+    }
+
+    uint32_t first = w->names.len / sizeof(uint32_t);
+    for (int i=0; i<n; i++) {
+        uint32_t ref = img_name(w, list[i]);
+        img_put(&(w->names), &ref, sizeof(uint32_t), 1);
+    }
+
+    return first;
+}
+
+/**
+ * @brief   Write a list of n mappings to the mappings table of an image, and return the position of the first one.
+*/
+uint32_t img_mappings(ImgWriter *w, Mapping **maps, int n) {
+
+    if (maps == NULL) {
+        return IMG_NONE;
+    }
+
+    uint32_t first = w->maps.len / sizeof(ImgMapping);
+    for (int i=0; i<n; i++) {
+        ImgMapping m = { -1, 0, 0 };
+        if (maps[i] != NULL) {
+            m.type = maps[i]->type;
+            m.index = maps[i]->index;
+            m.out_index = maps[i]->out_index;
+        }
+        img_put(&(w->maps), &m, sizeof(ImgMapping), 1);
+    }
+
+    return first;
+}
+
+/**
+ * @brief   Return the position of a standard in the given library (the one that find_in_lib() finds
+ *          for its name), -1 if it is not that one.
+*/
+int img_proto(Netlist *lib, Standard *std) {
+
+    char *name = std->type == GATE ? std->gate->name : std->subsys->name;
+    IndexEntry *e = index_get(lib->index, sym_id(name));
+
+    return e != NULL && e->ptr == std ? e->pos : -1;
+}
+
+int lib_image_to_file(Netlist *gate_lib, Netlist *subsys_lib, uint64_t gate_hash, uint64_t subsys_hash, char *filename) {
+
+    if (gate_lib == NULL || subsys_lib == NULL || filename == NULL) {
+        return NARG;
+    }
+
+    // only what is parsed would be written
+    if (gate_lib->lazy != NULL || subsys_lib->lazy != NULL) {
+        fprintf(stderr, "a lazily loaded library cannot be written as an image\n");
+        return GENERIC_ERROR;
+    }
+
+    int _en = 0;
+
+    ImgWriter w;
+    memset(&w, 0, sizeof(ImgWriter));
+    w.refc = symbols.count;
+    w.refs = malloc(sizeof(uint32_t) * (w.refc+1));
+    memset(w.refs, 0xff, sizeof(uint32_t) * (w.refc+1));
+
+    // the gates, in the order of their library
+    for (Node *n=gate_lib->contents->head; n!=NULL && !_en; n=n->next) {
+
+        if (n->type != STANDARD || n->std->type != GATE) {
+            fprintf(stderr, "%s is not a gate library, it cannot be written as an image\n", gate_lib->file);
+            _en = GENERIC_ERROR;
+            break;
+        }
+
+        Gate *g = n->std->gate;
+        ImgGate ig;
+        ig.name = img_name(&w, g->name);
+        ig.inputc = g->_inputc;
+        ig.inputs = img_names(&w, g->inputs, g->_inputc);
+        ig.tt = img_put(&(w.words), g->truth_table, sizeof(uint64_t), TT_WORDS(g->_inputc));
+        img_put(&(w.gates), &ig, sizeof(ImgGate), 1);
+    }
+
+    // the subsystems, each followed by its components and aliases in their tables
+    for (Node *n=subsys_lib->contents->head; n!=NULL && !_en; n=n->next) {
+
+        if (n->type != STANDARD || n->std->type != SUBSYSTEM) {
+            fprintf(stderr, "%s is not a subsystem library, it cannot be written as an image\n", subsys_lib->file);
+            _en = GENERIC_ERROR;
+            break;
+        }
+
+        Subsystem *s = n->std->subsys;
+        ImgSubsys is;
+        is.name = img_name(&w, s->name);
+        is.inputc = s->_inputc;
+        is.inputs = img_names(&w, s->inputs, s->_inputc);
+        is.outputc = s->_outputc;
+        is.outputs = img_names(&w, s->outputs, s->_outputc);
+        is.output_mappings = img_names(&w, s->output_mappings, s->_outputc);
+        is.o_maps = s->is_standard ? img_mappings(&w, s->o_maps, s->_outputc) : IMG_NONE;
+        is.is_standard = s->is_standard;
+
+        is.comps = w.comps.len / sizeof(ImgComp);
+        is.compc = 0;
+        for (Node *c_n=s->components->head; c_n!=NULL; c_n=c_n->next) {
+
+            Component *c = c_n->comp;
+            ImgComp ic;
+            ic.id = c->id;
+
+            // the prototype is referred to by its position in its library
+            int proto = -1;
+            if (c->prototype->defined_in == gate_lib) {
+                ic.lib = GATE;
+                proto = img_proto(gate_lib, c->prototype);
+            } else if (c->prototype->defined_in == subsys_lib) {
+                ic.lib = SUBSYSTEM;
+                proto = img_proto(subsys_lib, c->prototype);
+            }
+            if (proto == -1) {
+                fprintf(stderr, "component U%d of %s is not an instance of anything in the given libraries\n", c->id, s->name);
+                _en = GENERIC_ERROR;
+                break;
+            }
+            ic.proto = proto;
+
+            ic.inputc = c->_inputc;
+            ic.inputs = img_names(&w, c->inputs, c->_inputc);
+            ic.i_maps = c->is_standard ? img_mappings(&w, c->i_maps, c->_inputc) : IMG_NONE;
+            ic.buffer_index = c->buffer_index;
+            ic.is_standard = c->is_standard;
+            img_put(&(w.comps), &ic, sizeof(ImgComp), 1);
+            is.compc++;
+        }
+
+        is.aliases = w.aliases.len / sizeof(ImgAlias);
+        is.aliasc = 0;
+        if (s->aliases != NULL) {
+            for (Node *a_n=s->aliases->head; a_n!=NULL; a_n=a_n->next) {
+                ImgAlias ia;
+                ia.name = img_name(&w, a_n->alias->name);
+                ia.mapping = img_mappings(&w, &(a_n->alias->mapping), 1);
+                img_put(&(w.aliases), &ia, sizeof(ImgAlias), 1);
+                is.aliasc++;
+            }
+        }
+
+        img_put(&(w.subsystems), &is, sizeof(ImgSubsys), 1);
+    }
+
+    if (!_en) {
+
+        // lay the tables out after the header, each one starting at a multiple of 8 bytes
+        LibImageHeader h;
+        memset(&h, 0, sizeof(LibImageHeader));
+        memcpy(h.magic, LIB_IMAGE_MAGIC, sizeof(h.magic));
+        h.version = LIB_IMAGE_VERSION;
+        h.gate_hash = gate_hash;
+        h.subsys_hash = subsys_hash;
+
+        ImgBuf *bufs[] = { &w.strings, &w.string_offs, &w.names, &w.words, &w.gates, &w.subsystems, &w.comps, &w.maps, &w.aliases };
+        ImgTable *tables[] = { &h.strings, &h.string_offs, &h.names, &h.words, &h.gates, &h.subsystems, &h.comps, &h.maps, &h.aliases };
+        size_t sizes[] = { 1, sizeof(uint32_t), sizeof(uint32_t), sizeof(uint64_t), sizeof(ImgGate), sizeof(ImgSubsys), sizeof(ImgComp), sizeof(ImgMapping), sizeof(ImgAlias) };
+        int tablec = sizeof(bufs) / sizeof(bufs[0]);
+
+        uint64_t offset = (sizeof(LibImageHeader) + 7) & ~7ULL;
+        for (int t=0; t<tablec; t++) {
+            tables[t]->offset = offset;
+            tables[t]->count = bufs[t]->len / sizes[t];
+            offset += (bufs[t]->len + 7) & ~7ULL;
+        }
+        h.size = offset;
+
+        // write a file named after the process, and only rename the finished image into place,
+        // so that processes reading the image at the same time never map half of one
+        char tmp_path[strlen(filename)+32];
+        sprintf(tmp_path, "%s.%d.tmp", filename, getpid());
+
+        FILE *fp = fopen(tmp_path, "wb");
+        if (fp == NULL) {
+            fprintf(stderr, "could not write the library image to %s\n", tmp_path);
+            _en = GENERIC_ERROR;
+        } else {
+
+            char zeros[8] = { 0 };
+            int ok = fwrite(&h, sizeof(LibImageHeader), 1, fp) == 1;
+            ok = ok && fwrite(zeros, 1, tables[0]->offset - sizeof(LibImageHeader), fp) == tables[0]->offset - sizeof(LibImageHeader);
+            for (int t=0; t<tablec && ok; t++) {
+                size_t pad = ((bufs[t]->len + 7) & ~7ULL) - bufs[t]->len;
+                ok = fwrite(bufs[t]->data, 1, bufs[t]->len, fp) == bufs[t]->len && fwrite(zeros, 1, pad, fp) == pad;
+            }
+            ok = (fclose(fp) == 0) && ok;
+
+            if (!ok || rename(tmp_path, filename) != 0) {
+                fprintf(stderr, "could not write the library image to %s\n", filename);
+                remove(tmp_path);
+                _en = GENERIC_ERROR;
+            }
+        }
+    }
+
+    // cleanup
+    free(w.refs);
+    free(w.strings.data);
+    free(w.string_offs.data);
+    free(w.names.data);
+    free(w.words.data);
+    free(w.gates.data);
+    free(w.subsystems.data);
+    free(w.comps.data);
+    free(w.maps.data);
+    free(w.aliases.data);
+
+    return _en;
+}
+
+/**
+ * @brief   Whether a table of count entries of the given size at the given offset fits in a file of the given size.
+*/
+int img_table_fits(ImgTable t, size_t entry, size_t size) {
+    return t.offset <= size && t.offset % 8 == 0 && t.count <= (size - t.offset) / entry;
+}
+
+/**
+ * @brief   Whether a run of n entries that starts at the given position lies within a table of count entries.
+*/
+int img_run_fits(uint32_t first, uint64_t n, uint64_t count) {
+    return first <= count && n <= count - first;
+}
+
+/**
+ * @brief   Whether the n names that start at the given position of the names table are all names (or IMG_NONE, if the list may hold NULLs).
+*/
+int img_names_valid(LibImageHeader *h, uint32_t *names, uint32_t first, uint64_t n, int nullable) {
+
+    if (!img_run_fits(first, n, h->names.count)) return 0;
+
+    for (uint64_t i=0; i<n; i++) {
+        if (names[first+i] == IMG_NONE ? !nullable : names[first+i] >= h->string_offs.count) return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief   Whether the n mappings that start at the given position (IMG_NONE for none) are all in the mappings table.
+*/
+int img_mappings_valid(LibImageHeader *h, uint32_t first, uint64_t n) {
+    return first == IMG_NONE || img_run_fits(first, n, h->maps.count);
+}
+
+/**
+ * @brief   Whether every position that the tables of the given image hold refers to an entry of the
+ *          table that it points into, so that libs_from_image() never reads outside of them.
+*/
+int img_positions_valid(LibImageHeader *h, char *data) {
+
+    char *strings = data + h->strings.offset;
+    uint32_t *string_offs = (uint32_t*) (data + h->string_offs.offset);
+    uint32_t *names = (uint32_t*) (data + h->names.offset);
+    ImgGate *gates = (ImgGate*) (data + h->gates.offset);
+    ImgSubsys *subsystems = (ImgSubsys*) (data + h->subsystems.offset);
+    ImgComp *comps = (ImgComp*) (data + h->comps.offset);
+    ImgMapping *maps = (ImgMapping*) (data + h->maps.offset);
+    ImgAlias *aliases = (ImgAlias*) (data + h->aliases.offset);
+
+    // every name starts in strings, which ends with a null byte so that none of them runs past it
+    if (h->string_offs.count > 0 && (h->strings.count == 0 || strings[h->strings.count-1] != '\0')) return 0;
+    for (uint64_t i=0; i<h->string_offs.count; i++) {
+        if (string_offs[i] >= h->strings.count) return 0;
+    }
+
+    for (uint64_t i=0; i<h->gates.count; i++) {
+        ImgGate *ig = gates + i;
+        if (ig->name >= h->string_offs.count || ig->inputc > MAX_GATE_INPUTS
+            || !img_names_valid(h, names, ig->inputs, ig->inputc, 0)
+            || !img_run_fits(ig->tt, TT_WORDS(ig->inputc), h->words.count)) return 0;
+    }
+
+    for (uint64_t i=0; i<h->subsystems.count; i++) {
+        ImgSubsys *is = subsystems + i;
+        if (is->name >= h->string_offs.count
+            || !img_names_valid(h, names, is->inputs, is->inputc, 0) || !img_names_valid(h, names, is->outputs, is->outputc, 0)
+            || (is->output_mappings != IMG_NONE && !img_names_valid(h, names, is->output_mappings, is->outputc, 1))
+            || !img_mappings_valid(h, is->o_maps, is->outputc)
+            || !img_run_fits(is->comps, is->compc, h->comps.count) || !img_run_fits(is->aliases, is->aliasc, h->aliases.count)) return 0;
+    }
+
+    for (uint64_t i=0; i<h->comps.count; i++) {
+        ImgComp *ic = comps + i;
+        if ((ic->lib != GATE || ic->proto >= h->gates.count) && (ic->lib != SUBSYSTEM || ic->proto >= h->subsystems.count)) return 0;
+        if (!img_names_valid(h, names, ic->inputs, ic->inputc, 1) || !img_mappings_valid(h, ic->i_maps, ic->inputc)) return 0;
+    }
+
+    for (uint64_t i=0; i<h->maps.count; i++) {
+        if (maps[i].type != -1 && maps[i].type != SUBSYS_INPUT && maps[i].type != SUBSYS_COMP) return 0;
+    }
+
+    for (uint64_t i=0; i<h->aliases.count; i++) {
+        ImgAlias *ia = aliases + i;
+        if (ia->name >= h->string_offs.count || !img_mappings_valid(h, ia->mapping, 1)) return 0;
+    }
+
+    return 1;
+}
+
+LibImage *lib_image_open(char *filename) {
+
+    if (filename == NULL) {
+        return NULL;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(LibImageHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    // shared and read-only, so every process that uses the image reads the same pages
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    // only trust an image of this version that is as big as it says and whose tables fit in it
+    LibImageHeader *h = (LibImageHeader*) data;
+    size_t size = st.st_size;
+    if (memcmp(h->magic, LIB_IMAGE_MAGIC, sizeof(h->magic)) != 0 || h->version != LIB_IMAGE_VERSION || h->size != size
+        || !img_table_fits(h->strings, 1, size) || !img_table_fits(h->string_offs, sizeof(uint32_t), size)
+        || !img_table_fits(h->names, sizeof(uint32_t), size) || !img_table_fits(h->words, sizeof(uint64_t), size)
+        || !img_table_fits(h->gates, sizeof(ImgGate), size) || !img_table_fits(h->subsystems, sizeof(ImgSubsys), size)
+        || !img_table_fits(h->comps, sizeof(ImgComp), size) || !img_table_fits(h->maps, sizeof(ImgMapping), size)
+        || !img_table_fits(h->aliases, sizeof(ImgAlias), size)) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    // nor one where a table refers to anything outside of another one
+    if (!img_positions_valid(h, data)) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    LibImage *img = malloc(sizeof(LibImage));
+    img->data = data;
+    img->size = size;
+    img->header = h;
+
+    return img;
+}
+
+void lib_image_close(LibImage *img) {
+
+    if (img != NULL) {
+        munmap(img->data, img->size);
+        free(img);
+    }
+}
+
+/**
+ * @brief   Return a list of the n (interned) names that refs refer to, allocated from the given arena.
+*/
+char **img_sym_list(char **syms, uint32_t *refs, int n, Arena *arena) {
+
+    char **list = arena_alloc(arena, sizeof(char*) * (n+1));
+    for (int i=0; i<n; i++) {
+        list[i] = refs[i] == IMG_NONE ? NULL : syms[refs[i]];
+    }
+
+    return list;
+}
+
+/**
+ * @brief   Return a list of the n mappings that start at the given position (NULL if the position is IMG_NONE), allocated from the given arena.
+*/
+Mapping **img_mapping_list(ImgMapping *maps, uint32_t first, int n, Arena *arena) {
+
+    if (first == IMG_NONE) {
+        return NULL;
+    }
+
+    Mapping **list = arena_alloc(arena, sizeof(Mapping*) * (n+1));
+    for (int i=0; i<n; i++) {
+        ImgMapping *m = maps + first + i;
+        if (m->type == -1) {
+            list[i] = NULL;
+        } else {
+            list[i] = arena_alloc(arena, sizeof(Mapping));
+            list[i]->type = m->type;
+            list[i]->index = m->index;
+            list[i]->out_index = m->out_index;
+        }
+    }
+
+    return list;
+}
+
+int libs_from_image(LibImage *img, Netlist *gate_lib, char *gate_file, Netlist *subsys_lib, char *subsys_file) {
+
+    if (img == NULL || gate_lib == NULL || gate_file == NULL || subsys_lib == NULL || subsys_file == NULL) {
+        return NARG;
+    }
+
+    LibImageHeader *h = img->header;
+    char *strings = img->data + h->strings.offset;
+    uint32_t *string_offs = (uint32_t*) (img->data + h->string_offs.offset);
+    uint32_t *names = (uint32_t*) (img->data + h->names.offset);
+    uint64_t *words = (uint64_t*) (img->data + h->words.offset);
+    ImgGate *gates = (ImgGate*) (img->data + h->gates.offset);
+    ImgSubsys *subsystems = (ImgSubsys*) (img->data + h->subsystems.offset);
+    ImgComp *comps = (ImgComp*) (img->data + h->comps.offset);
+    ImgMapping *maps = (ImgMapping*) (img->data + h->maps.offset);
+    ImgAlias *aliases = (ImgAlias*) (img->data + h->aliases.offset);
+
+    // every name is interned once, everything else refers to it by position
+    char **syms = malloc(sizeof(char*) * (h->string_offs.count+1));
+    for (uint64_t i=0; i<h->string_offs.count; i++) {
+        char *str = strings + string_offs[i];
+        syms[i] = intern(str, strlen(str));
+    }
+
+    // the gate library
+    gate_lib->file = malloc(strlen(gate_file)+1);
+    strncpy(gate_lib->file, gate_file, strlen(gate_file)+1);
+    gate_lib->type = GATE;
+    gate_lib->arena = arena_init(0);
+    gate_lib->contents = ll_init_in(gate_lib->arena);
+    gate_lib->index = NULL;
+    gate_lib->lazy = NULL;
+    Arena *arena = gate_lib->arena;
+
+    Standard **gate_stds = malloc(sizeof(Standard*) * (h->gates.count+1));
+    for (uint64_t i=0; i<h->gates.count; i++) {
+
+        ImgGate *ig = gates + i;
+        Gate *g = arena_alloc(arena, sizeof(Gate));
+        g->name = syms[ig->name];
+        g->_inputc = ig->inputc;
+        g->inputs = img_sym_list(syms, names + ig->inputs, ig->inputc, arena);
+        g->truth_table = arena_alloc(arena, sizeof(uint64_t) * TT_WORDS(ig->inputc));
+        memcpy(g->truth_table, words + ig->tt, sizeof(uint64_t) * TT_WORDS(ig->inputc));
+
+        Standard *std = arena_alloc(arena, sizeof(Standard));
+        std->type = GATE;
+        std->gate = g;
+        std->defined_in = gate_lib;
+        add_to_lib(gate_lib, std, 1, GATE);
+        gate_stds[i] = std;
+    }
+
+    // the subsystem library, all subsystems are created before their components so that these can be instances of any of them
+    subsys_lib->file = malloc(strlen(subsys_file)+1);
+    strncpy(subsys_lib->file, subsys_file, strlen(subsys_file)+1);
+    subsys_lib->type = SUBSYSTEM;
+    subsys_lib->arena = arena_init(0);
+    subsys_lib->contents = ll_init_in(subsys_lib->arena);
+    subsys_lib->index = NULL;
+    subsys_lib->lazy = NULL;
+    arena = subsys_lib->arena;
+
+    Standard **subsys_stds = malloc(sizeof(Standard*) * (h->subsystems.count+1));
+    for (uint64_t i=0; i<h->subsystems.count; i++) {
+
+        ImgSubsys *is = subsystems + i;
+        Subsystem *s = arena_alloc(arena, sizeof(Subsystem));
+        s->arena = arena;
+        s->name = syms[is->name];
+        s->_inputc = is->inputc;
+        s->inputs = img_sym_list(syms, names + is->inputs, is->inputc, arena);
+        s->_outputc = is->outputc;
+        s->outputs = img_sym_list(syms, names + is->outputs, is->outputc, arena);
+        s->output_mappings = is->output_mappings == IMG_NONE ? NULL : img_sym_list(syms, names + is->output_mappings, is->outputc, arena);
+        s->is_standard = is->is_standard;
+        s->o_maps = img_mapping_list(maps, is->o_maps, is->outputc, arena);
+        s->components = ll_init_in(arena);
+        s->aliases = ll_init_in(arena);
+        s->program = NULL;
+        s->comp_index = s->input_index = s->output_index = s->alias_index = NULL;
+    s->store = NULL;
+    s->tmpl = NULL;
+    s->model = NULL;
+
+        Standard *std = arena_alloc(arena, sizeof(Standard));
+        std->type = SUBSYSTEM;
+        std->subsys = s;
+        std->defined_in = subsys_lib;
+        add_to_lib(subsys_lib, std, 1, SUBSYSTEM);
+        subsys_stds[i] = std;
+    }
+
+    for (uint64_t i=0; i<h->subsystems.count; i++) {
+
+        ImgSubsys *is = subsystems + i;
+        Subsystem *s = subsys_stds[i]->subsys;
+
+        for (uint32_t j=0; j<is->compc; j++) {
+
+            ImgComp *ic = comps + is->comps + j;
+            Component *c = arena_alloc(arena, sizeof(Component));
+            c->id = ic->id;
+            c->prototype = ic->lib == GATE ? gate_stds[ic->proto] : subsys_stds[ic->proto];
+            c->is_standard = ic->is_standard;
+            c->_inputc = ic->inputc;
+            c->inputs = img_sym_list(syms, names + ic->inputs, ic->inputc, arena);
+            c->i_maps = img_mapping_list(maps, ic->i_maps, ic->inputc, arena);
+            c->buffer_index = ic->buffer_index;
+            subsys_add_comp(s, c);
+        }
+
+        for (uint32_t j=0; j<is->aliasc; j++) {
+
+            ImgAlias *ia = aliases + is->aliases + j;
+            Alias *a = arena_alloc(arena, sizeof(Alias));
+            a->name = syms[ia->name];
+            Mapping **m = img_mapping_list(maps, ia->mapping, 1, arena);
+            a->mapping = m != NULL ? m[0] : NULL;
+            subsys_add_alias(s, a);
+        }
+    }
+
+    // cleanup
+    free(syms);
+    free(gate_stds);
+    free(subsys_stds);
+
+    return 0;
+}
+
+int libs_from_files_cached(char *gate_file, Netlist *gate_lib, char *subsys_file, Netlist *subsys_lib, char *image_file, int threads) {
+
+    if (gate_file == NULL || gate_lib == NULL || subsys_file == NULL || subsys_lib == NULL || image_file == NULL) {
+        return NARG;
+    }
+
+    int _en;
+
+    // the image is only used if it was compiled from files with the same contents
+    unsigned long long gate_hash, subsys_hash;
+    int hashed = !hash_file(gate_file, &gate_hash) && !hash_file(subsys_file, &subsys_hash);
+
+    LibImage *img = hashed ? lib_image_open(image_file) : NULL;
+    if (img != NULL && img->header->gate_hash == gate_hash && img->header->subsys_hash == subsys_hash) {
+        _en = libs_from_image(img, gate_lib, gate_file, subsys_lib, subsys_file);
+        lib_image_close(img);
+        return _en;
+    }
+    lib_image_close(img);
+
+    // the image is missing or out of date, read the text files and compile them for the next time
+    if ( (_en=gate_lib_from_file(gate_file, gate_lib)) ) return _en;
+    if ( (_en=subsys_lib_from_file_parallel(subsys_file, subsys_lib, gate_lib, threads)) ) return _en;
+
+    // the libraries are fine even if the image cannot be written, it will be tried again next time
+    if (hashed) {
+        lib_image_to_file(gate_lib, subsys_lib, gate_hash, subsys_hash, image_file);
+    }
+
+    return 0;
+}
+
+
+/**
+ * A gate-only netlist as it is being flattened, where every signal is an integer net: nets 0 to
+ * inputc-1 are the inputs of the subsystem and net inputc+g is the output of gate g.
+*/
+typedef struct flat_netlist {
+    int inputc;         // the number of inputs of the subsystem that is flattened
+    int gatec;          // the number of gates so far
+    int gate_cap;       // how many gates fit in protos and fanin_start
+    Standard **protos;  // the gate that each gate is an instance of
+    int *fanin_start;   // where the input nets of each gate start in fanin (gatec+1 entries)
+    int *fanin;         // the input nets of all the gates, back to back
+    int fanin_cap;      // how many nets fit in fanin
+} FlatNetlist;
+
+/**
+ * @brief   Start an empty flat netlist.
+*/
+void flat_init(FlatNetlist *f) {
+    memset(f, 0, sizeof(FlatNetlist));
+    f->fanin_start = malloc(sizeof(int));
+    f->fanin_start[0] = 0;
+}
+
+/**
+ * @brief   Make room in the given flat netlist for gates more gates with nets more input nets (in total).
+*/
+void flat_reserve(FlatNetlist *f, int gates, int nets) {
+
+    // grow the arrays geometrically, so that adding a gate takes O(1) amortized
+    if (f->gatec + gates > f->gate_cap) {
+        while (f->gatec + gates > f->gate_cap) {
+            f->gate_cap = f->gate_cap > 0 ? 2*f->gate_cap : 64;
+        }
+        f->protos = realloc(f->protos, sizeof(Standard*) * f->gate_cap);
+        f->fanin_start = realloc(f->fanin_start, sizeof(int) * (f->gate_cap+1));
+    }
+    if (f->fanin_start[f->gatec] + nets > f->fanin_cap) {
+        while (f->fanin_start[f->gatec] + nets > f->fanin_cap) {
+            f->fanin_cap = f->fanin_cap > 0 ? 2*f->fanin_cap : 256;
+        }
+        f->fanin = realloc(f->fanin, sizeof(int) * f->fanin_cap);
+    }
+}
+
+/**
+ * @brief   Append a gate with n inputs to the given flat netlist, and return where its input nets go (only valid until the next gate is added).
+*/
+int *flat_add_gate(FlatNetlist *f, Standard *proto, int n) {
+
+    flat_reserve(f, 1, n);
+
+    int *nets = f->fanin + f->fanin_start[f->gatec];
+    f->protos[f->gatec] = proto;
+    f->fanin_start[f->gatec+1] = f->fanin_start[f->gatec] + n;
+    f->gatec++;
+
+    return nets;
+}
+
+/**
+ * @brief   Append a copy of the given template to the given flat netlist, reading in_nets as its inputs, and write the nets of its outputs in out_nets.
+*/
+void flat_add_template(FlatNetlist *f, FlatTemplate *t, int *in_nets, int *out_nets) {
+
+    flat_reserve(f, t->gatec, t->fanin_start[t->gatec]);
+
+    // the gates and where their nets start are copied as blocks, only moved after the ones so far
+    int first = f->gatec, fanin_base = f->fanin_start[first];
+    if (t->gatec > 0) {
+        memcpy(f->protos + first, t->protos, sizeof(Standard*) * t->gatec);
+    }
+    for (int g=1; g<=t->gatec; g++) {
+        f->fanin_start[first+g] = fanin_base + t->fanin_start[g];
+    }
+
+    // the nets of the inputs become the ones that the instance reads, the nets of the gates are moved by as much as the gates
+    int offset = f->inputc + first - t->inputc;
+    int *nets = f->fanin + fanin_base;
+    for (int i=0; i<t->fanin_start[t->gatec]; i++) {
+        nets[i] = t->fanin[i] < t->inputc ? in_nets[t->fanin[i]] : offset + t->fanin[i];
+    }
+    for (int o=0; o<t->outputc; o++) {
+        out_nets[o] = t->out_nets[o] < t->inputc ? in_nets[t->out_nets[o]] : offset + t->out_nets[o];
+    }
+
+    f->gatec += t->gatec;
+}
+
+/**
+ * @brief   Free the arrays of the given flat netlist.
+*/
+void flat_free(FlatNetlist *f) {
+    free(f->protos);
+    free(f->fanin_start);
+    free(f->fanin);
+}
+
+/**
+ * @brief   Flatten the given (standard) subsystem into f, down to its gates, and write the nets of its outputs in out_nets.
+ *
+ * @details Every component of the target is visited once, and every subsystem that it instantiates is
+ *          copied from its template (see subsys_template()), which is only flattened the first time, so
+ *          this takes time linear in the number of gates of the result. The nets of
+ *          the outputs of each component of the target are kept in one array (one net for a gate, one per
+ *          output for a subsystem), so that a mapping is resolved to a net with two lookups.
+*/
+int flatten_subsys(Subsystem *target, FlatNetlist *f, int *out_nets) {
+
+    CompStore *st = subsys_store(target);
+    f->inputc = target->_inputc;
+    f->gatec = 0;
+
+    // where the nets of the outputs of each component start in comp_nets, and the most inputs that any component has
+    int *comp_start = malloc(sizeof(int) * (st->compc+1));
+    int netc = 0, max_inputs = 0;
+    for (int k=0; k<st->compc; k++) {
+        comp_start[k] = netc;
+        netc += st->protos[k]->type == GATE ? 1 : st->protos[k]->subsys->_outputc;
+        if (st->fanin_start[k+1] - st->fanin_start[k] > max_inputs) {
+            max_inputs = st->fanin_start[k+1] - st->fanin_start[k];
+        }
+    }
+    comp_start[st->compc] = netc;
+    int *comp_nets = malloc(sizeof(int) * (netc+1));
+    int *in_nets = malloc(sizeof(int) * (max_inputs+1));
+
+    int _en = 0;
+    for (int k=0; k<st->compc && !_en; k++) {
+
+        // resolve the inputs of the component to nets (the components that it reads come before it)
+        int inputc = st->fanin_start[k+1] - st->fanin_start[k];
+        for (int i=0; i<inputc; i++) {
+
+            Mapping *m = st->fanin + st->fanin_start[k] + i;
+            if (m->type == SUBSYS_INPUT && m->index >= 0 && m->index < target->_inputc) {
+                in_nets[i] = m->index;
+            } else if (m->type == SUBSYS_COMP && m->index >= 0 && m->index < k) {
+                in_nets[i] = comp_nets[comp_start[m->index] + (m->out_index > 0 ? m->out_index : 0)];
+            } else {
+                fprintf(stderr, "cannot flatten subsystem %s: invalid mapping in input %d of component %s%d\n", target->name, i+1, COMP_ID_PREFIX, st->ids[k]);
+                _en = GENERIC_ERROR;
+                break;
+            }
+        }
+        if (_en) break;
+
+        if (st->protos[k]->type == GATE) {
+
+            // a gate is copied as it is
+            int *nets = flat_add_gate(f, st->protos[k], inputc);
+            memcpy(nets, in_nets, sizeof(int) * inputc);
+            comp_nets[comp_start[k]] = f->inputc + f->gatec - 1;
+            continue;
+        }
+
+        // a subsystem is replaced by a copy of its gates, flattened once for all of its instances
+        Subsystem *sub = st->protos[k]->subsys;
+        if (inputc != sub->_inputc) {
+            fprintf(stderr, "cannot flatten subsystem %s: component %s%d has %d inputs, %s has %d\n", target->name, COMP_ID_PREFIX, st->ids[k], inputc, sub->name, sub->_inputc);
+            _en = GENERIC_ERROR;
+            break;
+        }
+
+        FlatTemplate *t = subsys_template(sub);
+        if (t == NULL) {
+            fprintf(stderr, "cannot flatten subsystem %s: component %s%d (%s) cannot be flattened\n", target->name, COMP_ID_PREFIX, st->ids[k], sub->name);
+            _en = GENERIC_ERROR;
+            break;
+        }
+        flat_add_template(f, t, in_nets, comp_nets + comp_start[k]);
+    }
+
+    // the outputs of the target are the nets that they are mapped to
+    for (int o=0; o<target->_outputc && !_en; o++) {
+
+        Mapping *m = target->o_maps[o];
+        if (m->type == SUBSYS_INPUT && m->index >= 0 && m->index < target->_inputc) {
+            out_nets[o] = m->index;
+        } else if (m->type == SUBSYS_COMP && m->index >= 0 && m->index < st->compc) {
+            out_nets[o] = comp_nets[comp_start[m->index] + (m->out_index > 0 ? m->out_index : 0)];
+        } else {
+            fprintf(stderr, "cannot flatten subsystem %s: invalid mapping for output %s\n", target->name, target->outputs[o]);
+            _en = GENERIC_ERROR;
+        }
+    }
+
+    free(comp_start);
+    free(comp_nets);
+    free(in_nets);
+
+    return _en;
+}
+
+/**
+ * A subsystem on the work stack of build_bottom_up(), with the position of the next of its components
+ * that it checks.
+*/
+typedef struct flat_frame {
+    Subsystem *s;   // the subsystem that will be built
+    int k;          // its next component to check
+} FlatFrame;
 
-                if (rtcn->type == COMPONENT) {  // then, according to the hack (search COMP_HACK) it is a gate
-                    fprintf(stderr, "tha doume ti tha kanoume\n");
-                    
-                    // then all we need to do is put the ID of the gate in the output mapping list (it is consistent with the numbering of the final)
-                    only_gates_sub->output_mappings[i] = malloc(strlen(COMP_ID_PREFIX)+digits(rtcn->comp->id)+1); // +1 for the null byte
-                    sprintf(only_gates_sub->output_mappings[i], "%s%d", COMP_ID_PREFIX, rtcn->comp->id);
+/**
+ * @brief   Call build() on s and on every subsystem below it for which built() is false, bottom up: a subsystem
+ *          is only built once all the subsystems that it instantiates are. The subsystems are walked with a stack
+ *          instead of recursion, and one that instantiates itself is reported (as one that cannot be <what>ed).
+*/
+int build_bottom_up(Subsystem *s, int (*built)(Subsystem*), int (*build)(Subsystem*), char *what) {
 
-                } else if (rtcn->type == SUBSYSTEM_N) {
+    int top = 0, cap = 16, _en = 0;
+    FlatFrame *stack = malloc(sizeof(FlatFrame) * cap);
+    stack[top++] = (FlatFrame){s, 0};
 
-                    // use the hack (search COMP_HACK)
-                    Subsystem *mapped = (Subsystem*)(rtcn->comp);
+    while (top > 0 && !_en) {
 
-                    // check that the out_index is valid
-                    if (om->out_index < 0) {
-                        char *b = malloc(BUFSIZ);
-                        mapping_to_str(om, b, BUFSIZ);
-                        fprintf(stderr, "invalid output index %d in mapping '%s' to subsystem of type '%s'\n", om->out_index, b, mapped->name);
-                        free(b);
-                        return GENERIC_ERROR;
-                    }
+        // find the next component of the subsystem on the top that is a subsystem that is not built
+        FlatFrame *fr = stack + top - 1;
+        CompStore *st = subsys_store(fr->s);
+        while (fr->k < st->compc && (st->protos[fr->k]->type == GATE || built(st->protos[fr->k]->subsys))) {
+            fr->k++;
+        }
 
-                    // find the corresponding output mapping
-                    char *m = mapped->output_mappings[om->out_index];
+        // with none left, all of the subsystems that it instantiates are built, so it can be too
+        if (fr->k == st->compc) {
+            _en = build(fr->s);
+            top--;
+            continue;
+        }
 
-                    // put it in the output list
-                    only_gates_sub->output_mappings[i] = malloc(strlen(m)+1); // +1 for the null byte
-                    strncpy(only_gates_sub->output_mappings[i], m, strlen(m)+1);
+        // a subsystem that is already on the stack instantiates itself, through the ones above it
+        Subsystem *sub = st->protos[fr->k]->subsys;
+        for (int j=0; j<top; j++) {
+            if (stack[j].s == sub) {
+                fprintf(stderr, "cannot %s subsystem %s: it instantiates itself (", what, s->name);
+                for (int i=j; i<top; i++) {
+                    fprintf(stderr, "%s -> ", stack[i].s->name);
                 }
-            } else {
-
-                // should never reach here, since all mappings map either to inputs or other component('s outputs)
-                char *b = malloc(BUFSIZ);
-                mapping_to_str(om, b, BUFSIZ);
-                fprintf(stderr, "invalid mapping type: %s\n", b);
-                free(b);
-                return GENERIC_ERROR;
+                fprintf(stderr, "%s)\n", sub->name);
+                _en = GENERIC_ERROR;
+                break;
             }
+        }
+        if (_en) break;
 
+        if (top == cap) {
+            cap *= 2;
+            stack = realloc(stack, sizeof(FlatFrame) * cap);
         }
+        stack[top++] = (FlatFrame){sub, 0};
+    }
 
-        // add the gate-only subsystem to the destination library
-        int _en=0;
-        if ( (_en=add_to_lib(dest, only_gates_sub, 0, SUBSYSTEM)) ) return _en;
+    free(stack);
 
-        // cleanup the array that was used for the components of this subsystem
-        Node *n = intermediate_components->head;
-        while (n!=NULL) {
-            Node *t = n->next;
-            if (n->type == SUBSYSTEM_N) {
-                free_subsystem(n->subsys, 0);
-            } else if (n->type == COMPONENT) {
-                // dont free
-            } else {
-                printf("nothing...?\n");
-            }
-            free(n);
-            n = t;
+    return _en;
+}
+
+/**
+ * @brief   Flatten the given subsystem into a new template, once all the subsystems that it instantiates have one.
+*/
+FlatTemplate *template_from_subsys(Subsystem *s) {
+
+    FlatNetlist f;
+    flat_init(&f);
+    int *out_nets = malloc(sizeof(int) * (s->_outputc+1));
+    if (flatten_subsys(s, &f, out_nets)) {
+        flat_free(&f);
+        free(out_nets);
+        return NULL;
+    }
+
+    // the template keeps the arrays of the flat netlist
+    FlatTemplate *t = malloc(sizeof(FlatTemplate));
+    t->inputc = s->_inputc;
+    t->outputc = s->_outputc;
+    t->gatec = f.gatec;
+    t->protos = f.protos;
+    t->fanin_start = f.fanin_start;
+    t->fanin = f.fanin;
+    t->out_nets = out_nets;
+
+    // the gates of each level are its own ones and those one level up in the templates of its subsystems
+    CompStore *st = subsys_store(s);
+    t->depth = 0;
+    for (int k=0; k<st->compc; k++) {
+        if (st->protos[k]->type != GATE && st->protos[k]->subsys->tmpl->depth + 1 > t->depth) {
+            t->depth = st->protos[k]->subsys->tmpl->depth + 1;
+        }
+    }
+    t->level_gatec = calloc(t->depth+1, sizeof(int));
+    for (int k=0; k<st->compc; k++) {
+        if (st->protos[k]->type == GATE) {
+            t->level_gatec[0]++;
+            continue;
+        }
+        FlatTemplate *sub = st->protos[k]->subsys->tmpl;
+        for (int d=0; d<=sub->depth; d++) {
+            t->level_gatec[d+1] += sub->level_gatec[d];
         }
+    }
+
+    return t;
+}
+
+/**
+ * @brief   Whether the given subsystem has a template (see build_bottom_up()).
+*/
+int template_built(Subsystem *s) {
+    return s->tmpl != NULL;
+}
+
+/**
+ * @brief   Build the template of the given subsystem (see build_bottom_up()).
+*/
+int build_template(Subsystem *s) {
+    s->tmpl = template_from_subsys(s);
+    return s->tmpl == NULL ? GENERIC_ERROR : 0;
+}
+
+FlatTemplate *subsys_template(Subsystem *s) {
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    // the subsystems below s are flattened first, so that s is a copy of their templates
+    if (s->tmpl == NULL && build_bottom_up(s, template_built, build_template, "flatten")) {
+        return NULL;
+    }
+
+    return s->tmpl;
+}
 
-        free(intermediate_components);
-        // advance to the next subsystem to be translated
-        node_ptr = node_ptr->next;
+int gate_levels_to_file(Subsystem *s, FILE *fp) {
 
+    if (s == NULL || fp == NULL) {
+        return NARG;
+    }
+
+    FlatTemplate *t = subsys_template(s);
+    if (t == NULL) {
+        return GENERIC_ERROR;
+    }
 
+    fprintf(fp, "%s: %d gates in %d levels\n", s->name, t->gatec, t->depth+1);
+    for (int d=0; d<=t->depth; d++) {
+        fprintf(fp, "    level %d: %d gates\n", d, t->level_gatec[d]);
     }
+
     return 0;
 }
 
+void free_flat_template(FlatTemplate *t) {
+
+    if (t == NULL) {
+        return;
+    }
+
+    free(t->protos);
+    free(t->fanin_start);
+    free(t->fanin);
+    free(t->out_nets);
+    free(t->level_gatec);
+    free(t);
+}
+
+/**
+ * @brief   Point m at the given net of a flat netlist (an input of the subsystem or the output of a gate).
+*/
+void net_to_mapping(int net, int inputc, Mapping *m) {
+
+    if (net < inputc) {
+        m->type = SUBSYS_INPUT;
+        m->index = net;
+    } else {
+        m->type = SUBSYS_COMP;
+        m->index = net - inputc;
+    }
+    m->out_index = -1;
+}
+
+/**
+ * @brief   Turn the flattened form of target into a new (standard) subsystem allocated from the given
+ *          arena, whose gates are numbered from first_id and refer to each other with mappings.
+*/
+Subsystem *flat_to_subsys(FlatNetlist *f, Subsystem *target, int *out_nets, int first_id, Arena *arena) {
+
+    Subsystem *s = arena_alloc(arena, sizeof(Subsystem));
+    s->arena = arena;
+    s->name = target->name;
+    s->_inputc = sym_list_copy(&(s->inputs), target->inputs, target->_inputc, arena);
+    s->_outputc = sym_list_copy(&(s->outputs), target->outputs, target->_outputc, arena);
+    s->is_standard = 1;
+    s->components = ll_init_in(arena);
+    s->aliases = NULL;
+    s->output_mappings = NULL;
+    s->program = NULL;
+    s->comp_index = s->input_index = s->output_index = s->alias_index = NULL;
+    s->store = NULL;
+    s->tmpl = NULL;
+    s->model = NULL;
+
+    // all the components and their mappings are allocated at once
+    int mapc = f->fanin_start[f->gatec];
+    Component *comps = arena_alloc(arena, sizeof(Component) * (f->gatec+1));
+    Mapping *maps = arena_alloc(arena, sizeof(Mapping) * (mapc + target->_outputc + 1));
+    Mapping **map_ptrs = arena_alloc(arena, sizeof(Mapping*) * (mapc + target->_outputc + 1));
+    for (int m=0; m<mapc+target->_outputc; m++) {
+        map_ptrs[m] = maps + m;
+    }
+
+    for (int g=0; g<f->gatec; g++) {
+
+        Component *c = comps + g;
+        c->id = first_id + g;
+        c->prototype = f->protos[g];
+        c->is_standard = 1;
+        c->_inputc = f->fanin_start[g+1] - f->fanin_start[g];
+        c->inputs = NULL;
+        c->i_maps = map_ptrs + f->fanin_start[g];
+        c->buffer_index = g;
+        for (int i=0; i<c->_inputc; i++) {
+            net_to_mapping(f->fanin[f->fanin_start[g]+i], f->inputc, c->i_maps[i]);
+        }
+        subsys_add_comp(s, c);
+    }
+
+    s->o_maps = map_ptrs + mapc;
+    for (int o=0; o<s->_outputc; o++) {
+        net_to_mapping(out_nets[o], f->inputc, s->o_maps[o]);
+    }
+
+    return s;
+}
+
+Subsystem *subsys_flatten(Subsystem *s, int first_id, Arena *arena) {
+
+    if (s == NULL || arena == NULL) {
+        return NULL;
+    }
+
+    FlatTemplate *t = subsys_template(s);
+    if (t == NULL) {
+        return NULL;
+    }
+
+    // the template already is the flat netlist of s, it is only read
+    FlatNetlist f;
+    f.inputc = t->inputc;
+    f.gatec = f.gate_cap = t->gatec;
+    f.protos = t->protos;
+    f.fanin_start = t->fanin_start;
+    f.fanin = t->fanin;
+    f.fanin_cap = t->fanin_start[t->gatec];
+
+    return flat_to_subsys(&f, s, t->out_nets, first_id, arena);
+}
+
+int netlist_to_gate_only(Netlist *dest, Netlist *netlist, int component_id) {
+
+    if (dest == NULL || netlist == NULL) {
+        return NARG;
+    }
+
+    // set the destination library info (the flattened subsystems are allocated from its arena)
+    dest->arena = arena_init(0);
+    dest->contents = ll_init_in(dest->arena);
+    dest->file = NULL;
+    dest->index = NULL;
+    dest->lazy = NULL;
+    dest->type = SUBSYSTEM;
+
+    // every subsystem is flattened into the same (reused) arrays
+    FlatNetlist f;
+    flat_init(&f);
+
+    int _en = 0;
+    for (Node *n=netlist->contents->head; n!=NULL && !_en; n=n->next) {
+
+        if (n->type != STANDARD || n->std->type != SUBSYSTEM) {
+            continue;
+        }
+
+        // flatten the subsystem to gates on integer nets...
+        Subsystem *target = n->std->subsys;
+        int *out_nets = malloc(sizeof(int) * (target->_outputc+1));
+        if ( (_en=flatten_subsys(target, &f, out_nets)) ) {
+            free(out_nets);
+            break;
+        }
+
+        // ...and only then turn it into a subsystem (its names are only resolved when it is written, see lib_to_file())
+        Subsystem *s = flat_to_subsys(&f, target, out_nets, component_id, dest->arena);
+        component_id += f.gatec;
+        free(out_nets);
+
+        Standard *std = arena_alloc(dest->arena, sizeof(Standard));
+        std->type = SUBSYSTEM;
+        std->subsys = s;
+        std->defined_in = dest;
+        _en = add_to_lib(dest, std, 1, SUBSYSTEM);
+    }
+
+    flat_free(&f);
+
+    return _en;
+}
+
+/**
+ * The work that the threads of netlist_to_gate_only_parallel() share: the subsystems that are flattened,
+ * the id of the first gate of each one and what each one was flattened into.
+*/
+typedef struct flat_pool {
+    int targetc;            // the number of subsystems that are flattened
+    Subsystem **targets;    // the subsystems, in the order of the netlist
+    int *first_ids;         // the id of the first gate of each subsystem
+    Subsystem **results;    // what each subsystem was flattened into
+    int *errors;            // what flattening each subsystem returned (set beforehand for those that cannot be)
+} FlatPool;
+
+/**
+ * @brief   Flatten subsystem t for netlist_to_gate_only_parallel() (see run_pool()). Every thread flattens
+ *          into arrays of its own, kept in its local.
+*/
+void flat_task(void *ctx, int t, Arena *arena, void **local) {
+
+    FlatPool *pool = (FlatPool*) ctx;
+
+    if (pool->errors[t]) {
+        return;
+    }
+
+    if (*local == NULL) {
+        *local = malloc(sizeof(FlatNetlist));
+        flat_init(*local);
+    }
+    FlatNetlist *f = *local;
+
+    Subsystem *target = pool->targets[t];
+    int *out_nets = malloc(sizeof(int) * (target->_outputc+1));
+    if ( !(pool->errors[t]=flatten_subsys(target, f, out_nets)) ) {
+        pool->results[t] = flat_to_subsys(f, target, out_nets, pool->first_ids[t], arena);
+    }
+    free(out_nets);
+}
+
+/**
+ * @brief   Free the arrays that a thread of netlist_to_gate_only_parallel() flattened into (see flat_task()).
+*/
+void flat_task_done(void *ctx, void *local) {
+
+    if (local != NULL) {
+        flat_free(local);
+        free(local);
+    }
+}
+
+int netlist_to_gate_only_parallel(Netlist *dest, Netlist *netlist, int component_id, int threads) {
+
+    if (threads <= 1) {
+        return netlist_to_gate_only(dest, netlist, component_id);
+    }
+
+    if (dest == NULL || netlist == NULL) {
+        return NARG;
+    }
+
+    // set the destination library info (the flattened subsystems end up in its arena)
+    dest->arena = arena_init(0);
+    dest->contents = ll_init_in(dest->arena);
+    dest->file = NULL;
+    dest->index = NULL;
+    dest->lazy = NULL;
+    dest->type = SUBSYSTEM;
+
+    FlatPool pool;
+    pool.targetc = 0;
+    for (Node *n=netlist->contents->head; n!=NULL; n=n->next) {
+        if (n->type == STANDARD && n->std->type == SUBSYSTEM) pool.targetc++;
+    }
+    pool.targets = malloc(sizeof(Subsystem*) * (pool.targetc+1));
+    pool.first_ids = malloc(sizeof(int) * (pool.targetc+1));
+    pool.results = malloc(sizeof(Subsystem*) * (pool.targetc+1));
+    pool.errors = malloc(sizeof(int) * (pool.targetc+1));
+    memset(pool.results, 0, sizeof(Subsystem*) * (pool.targetc+1));
+    memset(pool.errors, 0, sizeof(int) * (pool.targetc+1));
+
+    // the threads only read the subsystems, so what is built on first use (their stores and the templates of
+    // the subsystems that they instantiate) is built now, and the number of gates of each one follows from it:
+    // the ids are handed out in the order of the netlist, just like netlist_to_gate_only() does
+    int t = 0;
+    for (Node *n=netlist->contents->head; n!=NULL; n=n->next) {
+
+        if (n->type != STANDARD || n->std->type != SUBSYSTEM) {
+            continue;
+        }
+
+        Subsystem *target = n->std->subsys;
+        CompStore *st = subsys_store(target);
+        pool.targets[t] = target;
+        pool.first_ids[t] = component_id;
+        for (int k=0; k<st->compc; k++) {
+
+            if (st->protos[k]->type == GATE) {
+                component_id++;
+                continue;
+            }
+
+            FlatTemplate *tmpl = subsys_template(st->protos[k]->subsys);
+            if (tmpl == NULL) {
+                fprintf(stderr, "cannot flatten subsystem %s: component %s%d (%s) cannot be flattened\n", target->name, COMP_ID_PREFIX, st->ids[k], st->protos[k]->subsys->name);
+                pool.errors[t] = GENERIC_ERROR;
+                break;
+            }
+            component_id += tmpl->gatec;
+        }
+        t++;
+    }
+
+    // flatten the subsystems, they end up in the arena of dest
+    run_pool(&pool, flat_task, flat_task_done, pool.targetc, threads, dest->arena);
+
+    // add the subsystems to dest in the order of the netlist, up to the first error
+    int _en = 0;
+    for (t=0; t<pool.targetc && !_en; t++) {
+
+        if ( (_en=pool.errors[t]) ) {
+            break;
+        }
+
+        // its thread's arena is now part of dest's one
+        subsys_move_to_arena(pool.results[t], dest->arena);
+
+        Standard *std = arena_alloc(dest->arena, sizeof(Standard));
+        std->type = SUBSYSTEM;
+        std->subsys = pool.results[t];
+        std->defined_in = dest;
+        _en = add_to_lib(dest, std, 1, SUBSYSTEM);
+    }
+
+    // cleanup
+    free(pool.targets);
+    free(pool.first_ids);
+    free(pool.results);
+    free(pool.errors);
+
+    return _en;
+}
+
 void old_lib_to_file(Netlist *lib, char *filename, char *mode, int mod) {
 
     FILE *fp = fopen(filename, mode);
@@ -2550,24 +6466,34 @@ void old_lib_to_file(Netlist *lib, char *filename, char *mode, int mod) {
     // print the stuff
     for (Node *n = lib->contents->head; n!=NULL; n=n->next) {
 
+        // flattened libraries hold standards (see netlist_to_gate_only()), netlists hold subsystems
+        Subsystem *s = n->type == STANDARD ? n->std->subsys : n->subsys;
+
         // print the header line
-        char *buf = malloc(MAX_LINE_LEN);
-        subsys_hdr_to_str(n->subsys, buf, MAX_LINE_LEN);
+        int hdr_size = subsys_hdr_size(s);
+        char *buf = malloc(hdr_size);
+        subsys_hdr_to_str(s, buf, hdr_size);
         fprintf(fp, "%s\n", buf);
         free(buf);
 
         // print the BEGIN ... NETLIST line
-        fprintf(fp, "BEGIN %s NETLIST\n", n->subsys->name);
+        fprintf(fp, "BEGIN %s NETLIST\n", s->name);
 
         // print the components
-        for (Node *n_n=n->subsys->components->head; n_n!=NULL; n_n=n_n->next) {
-
+        for (Node *n_n=s->components->head; n_n!=NULL; n_n=n_n->next) {
 
             Component *comp = n_n->comp;
             fprintf(fp, "U%d %s ", comp->id, comp->prototype->gate->name);
 
+            // the inputs are either names or (if there are no names) mappings that are resolved here
             for (int i=0; i<comp->_inputc; i++) {
-                fprintf(fp, "%s ", comp->inputs[i]);
+                if (comp->inputs != NULL) {
+                    fprintf(fp, "%s ", comp->inputs[i]);
+                } else {
+                    char *b = resolve_mapping(comp->i_maps[i], s);
+                    fprintf(fp, "%s ", b);
+                    free(b);
+                }
             }
             fprintf(fp, "\n");
             if(comp->id % mod == 0) {
@@ -2576,12 +6502,18 @@ void old_lib_to_file(Netlist *lib, char *filename, char *mode, int mod) {
         }
 
         // print the output mappings
-        for (int i=0; i<n->subsys->_outputc; i++) {
-            fprintf(fp, "%s = %s\n", n->subsys->outputs[i], n->subsys->output_mappings[i]);
+        for (int i=0; i<s->_outputc; i++) {
+            if (s->output_mappings != NULL) {
+                fprintf(fp, "%s = %s\n", s->outputs[i], s->output_mappings[i]);
+            } else {
+                char *b = resolve_mapping(s->o_maps[i], s);
+                fprintf(fp, "%s = %s\n", s->outputs[i], b);
+                free(b);
+            }
         }
 
         // print the END ... NETLIST line
-        fprintf(fp, "END %s NETLIST\n", n->subsys->name);
+        fprintf(fp, "END %s NETLIST\n", s->name);
 
     }
 
@@ -2589,3 +6521,224 @@ void old_lib_to_file(Netlist *lib, char *filename, char *mode, int mod) {
 
 }
 
+
+/**
+ * @brief   Compile the given subsystem into a new model, once all the subsystems that it instantiates have one.
+*/
+SimModel *model_from_subsys(Subsystem *s) {
+
+    SimModel *m = malloc(sizeof(SimModel));
+    m->inputc = s->_inputc;
+    m->outc = s->_outputc;
+    m->instrc = 0;
+    m->instrs = NULL;
+    m->fanin = NULL;
+    m->gates = NULL;
+
+    // a subsystem of gates is simulated with its program, which must settle in one pass
+    if (subsys_gate_only(s)) {
+
+        if (s->program == NULL && compile_subsystem(s, &(s->program))) {
+            free(m);
+            return NULL;
+        }
+        if (!s->program->levelized) {
+            fprintf(stderr, "cannot simulate subsystem %s: it has a combinational cycle\n", s->name);
+            free(m);
+            return NULL;
+        }
+
+        m->gates = s->program;
+        m->slotc = s->program->slotc;
+        m->out_slots = malloc(sizeof(int) * (m->outc+1));
+        memcpy(m->out_slots, s->program->out_slots, sizeof(int) * m->outc);
+        m->frame_words = BIT_WORDS(m->slotc+1);
+
+        return m;
+    }
+
+    CompStore *st = subsys_store(s);
+    int compc = st->compc;
+
+    // check that every component has a mapping for every input, to an input or to an existing output
+    int _en = 0;
+    for (int k=0; k<compc && !_en; k++) {
+
+        Standard *proto = st->protos[k];
+        int inputc = proto->type == GATE ? proto->gate->_inputc : proto->subsys->_inputc;
+        if (st->fanin_start[k+1] - st->fanin_start[k] != inputc) {
+            fprintf(stderr, "cannot simulate subsystem %s: component %s%d does not have a mapping for every input\n", s->name, COMP_ID_PREFIX, st->ids[k]);
+            _en = GENERIC_ERROR;
+            break;
+        }
+
+        for (int f=st->fanin_start[k]; f<st->fanin_start[k+1]; f++) {
+            if (!store_mapping_valid(s, st, st->fanin + f)) {
+                fprintf(stderr, "cannot simulate subsystem %s: invalid mapping in input %d of component %s%d\n", s->name, f-st->fanin_start[k]+1, COMP_ID_PREFIX, st->ids[k]);
+                _en = GENERIC_ERROR;
+                break;
+            }
+        }
+    }
+    for (int o=0; o<s->_outputc && !_en; o++) {
+        if (!store_mapping_valid(s, st, s->o_maps[o])) {
+            fprintf(stderr, "cannot simulate subsystem %s: invalid mapping for output %s\n", s->name, s->outputs[o]);
+            _en = GENERIC_ERROR;
+        }
+    }
+    if (_en) {
+        free(m);
+        return NULL;
+    }
+
+    // sort the components topologically, a cycle cannot be settled in one pass
+    int edgec = st->fanin_start[compc];
+    int *order = malloc(sizeof(int) * (compc+1));
+    if (store_topo_order(st, order) != compc) {
+        fprintf(stderr, "cannot simulate subsystem %s: it has a combinational cycle\n", s->name);
+        free(order);
+        free(m);
+        return NULL;
+    }
+
+    // the components get their slots in the order in which they are evaluated, one for each of their outputs
+    int *slot_of = malloc(sizeof(int) * (compc+1));
+    int slotc = s->_inputc, below = 0;
+    for (int i=0; i<compc; i++) {
+        Standard *proto = st->protos[order[i]];
+        slot_of[order[i]] = slotc;
+        if (proto->type == GATE) {
+            slotc++;
+        } else {
+            slotc += proto->subsys->_outputc;
+            if (proto->subsys->model->frame_words > below) below = proto->subsys->model->frame_words;
+        }
+    }
+    m->slotc = slotc;
+    m->frame_words = BIT_WORDS(slotc+1) + below;
+
+    // create the instructions in that order, with their input slots laid out in the same order
+    m->instrc = compc;
+    m->instrs = malloc(sizeof(ModelInstr) * (compc+1));
+    m->fanin = malloc(sizeof(int) * (edgec+1));
+    int offset = 0;
+    for (int i=0; i<compc; i++) {
+
+        int k = order[i];
+        ModelInstr *in = m->instrs + i;
+        in->gate = st->protos[k]->type == GATE ? st->protos[k]->gate : NULL;
+        in->sub = st->protos[k]->type == GATE ? NULL : st->protos[k]->subsys->model;
+        in->in_slots = m->fanin + offset;
+        in->out_slot = slot_of[k];
+
+        for (int f=st->fanin_start[k]; f<st->fanin_start[k+1]; f++) {
+            Mapping *map = st->fanin + f;
+            if (map->type == SUBSYS_INPUT) {
+                m->fanin[offset++] = map->index;
+            } else {
+                m->fanin[offset++] = slot_of[map->index] + (st->protos[map->index]->type == GATE ? 0 : map->out_index);
+            }
+        }
+    }
+
+    m->out_slots = malloc(sizeof(int) * (m->outc+1));
+    for (int o=0; o<m->outc; o++) {
+        Mapping *map = s->o_maps[o];
+        if (map->type == SUBSYS_INPUT) {
+            m->out_slots[o] = map->index;
+        } else {
+            m->out_slots[o] = slot_of[map->index] + (st->protos[map->index]->type == GATE ? 0 : map->out_index);
+        }
+    }
+
+    free(order);
+    free(slot_of);
+
+    return m;
+}
+
+/**
+ * @brief   Whether the given subsystem has a model (see build_bottom_up()).
+*/
+int model_built(Subsystem *s) {
+    return s->model != NULL;
+}
+
+/**
+ * @brief   Build the model of the given subsystem (see build_bottom_up()).
+*/
+int build_model(Subsystem *s) {
+    s->model = model_from_subsys(s);
+    return s->model == NULL ? GENERIC_ERROR : 0;
+}
+
+SimModel *subsys_model(Subsystem *s) {
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    // the subsystems below s are compiled first, their models are shared by all of their instances
+    if (s->model == NULL && build_bottom_up(s, model_built, build_model, "simulate")) {
+        return NULL;
+    }
+
+    return s->model;
+}
+
+void run_model_bits(SimModel *m, uint64_t *bits) {
+
+    if (m->gates != NULL) {
+        run_program_bits(m->gates, bits);
+        return;
+    }
+
+    // the subsystems are run in the frame after this one (one at a time, so they all share it)
+    uint64_t *frame = bits + BIT_WORDS(m->slotc+1);
+
+    for (int k=0; k<m->instrc; k++) {
+
+        ModelInstr *in = &(m->instrs[k]);
+
+        if (in->gate != NULL) {
+
+            // pack the values of the inputs into the index of the truth table row
+            int index = 0;
+            for (int i=0; i<in->gate->_inputc; i++) {
+                index = (index << 1) | SLOT_BIT(bits, in->in_slots[i]);
+            }
+
+            uint64_t mask = (uint64_t)1 << (in->out_slot%64);
+            bits[in->out_slot/64] = (bits[in->out_slot/64] & ~mask) | ((uint64_t)eval_index(in->gate->truth_table, index) << (in->out_slot%64));
+            continue;
+        }
+
+        // the inputs of the subsystem are the first slots of its frame...
+        SimModel *sub = in->sub;
+        for (int i=0; i<sub->inputc; i++) {
+            uint64_t mask = (uint64_t)1 << (i%64);
+            frame[i/64] = (frame[i/64] & ~mask) | ((uint64_t)SLOT_BIT(bits, in->in_slots[i]) << (i%64));
+        }
+
+        run_model_bits(sub, frame);
+
+        // ...and its outputs are copied to the slots of the component
+        for (int o=0; o<sub->outc; o++) {
+            int slot = in->out_slot + o;
+            uint64_t mask = (uint64_t)1 << (slot%64);
+            bits[slot/64] = (bits[slot/64] & ~mask) | ((uint64_t)SLOT_BIT(frame, sub->out_slots[o]) << (slot%64));
+        }
+    }
+}
+
+void free_model(SimModel *m) {
+
+    if (m == NULL) {
+        return;
+    }
+
+    free(m->instrs);
+    free(m->fanin);
+    free(m->out_slots);
+    free(m);
+}
@@ -17,6 +17,7 @@
 
 #include "str_util.h"
 #include <stdio.h>
+#include <stdint.h>
 
 #define DECL_DESIGNATION "COMP "    /**< @brief The word that signifies that a line declares a subsystem */
 #define INPUT_DESIGNATION "IN: "    /**< @brief The word that signifies that the next part of a string is the inputs of the subsystem. */
@@ -47,12 +48,69 @@
 #define PORT_MAP_COLON ": "         /**< @brief The delimiter between the input/output declarations and the signal names */
 #define REQUIREMENT_DECL "LIB"      /**< @brief The string that indicates that a required subsystem is specified in this line */
 #define MAP_COMP_OUT_SEP "_"        /**< @brief The string that separates the component ID from the output name in a mapping */
+#define MAX_GATE_INPUTS 16          /**< @brief The maximum number of inputs of a gate (its truth table has 2^inputs rows) */
+#define TT_WORDS(inputc) (((1<<(inputc))+63)/64)    /**< @brief The number of 64-bit words that the truth table of a gate with the given number of inputs takes up */
+#define BIT_WORDS(n) (((n)+63)/64)                  /**< @brief The number of 64-bit words that n bits take up */
+#define SLOT_BIT(bits, slot) ((int)(((bits)[(slot)/64] >> ((slot)%64)) & 1))    /**< @brief The value of the given slot in bit-packed slots (slot i is bit i%64 of word i/64) */
+#define LUT_REDUCE_MAX_INPUTS 9     /**< @brief The widest truth table that eval_lanes() reduces as a whole, wider ones are looked up one lane at a time */
+#define NATIVE_CC "cc"              /**< @brief The C compiler that compile_program_native() uses (unless CC is set in the environment) */
+#define NATIVE_CFLAGS "-O3 -march=native -shared -fpic"    /**< @brief The flags that compile_program_native() passes to the C compiler */
+#define NATIVE_CACHE_DIR ".sim_cache"   /**< @brief The default directory where compiled subsystems are kept */
+#define NATIVE_WIDTH 8              /**< @brief The default number of 64-bit words per slot of compiled subsystems */
+#define MAX_EXTRACT_INPUTS 20       /**< @brief The maximum number of inputs of a subsystem whose truth tables extract_truth_tables() computes (2^20 rows) */
+#define JIT_WIDTH 8                 /**< @brief The default number of 64-bit words per slot of jit code */
+#define LIB_IMAGE_MAGIC "NLIMAGE"   /**< @brief The first bytes of a library image file (see lib_image_to_file()) */
+#define LIB_IMAGE_VERSION 1         /**< @brief The version of the library image format, an image of any other version is rebuilt */
+#define IMG_NONE UINT32_MAX         /**< @brief The reference of a missing entry (a NULL pointer) in a library image */
 #define GENERIC_ERROR -7            /**< @brief Error code indicating an error that does not fall under a specific category. An error message will usually be printed to clarify. */
 #define SIM_INPUT_DELIM     ", "    /**< @brief The string separating the inputs in the format that simulate() accepts */
 #define TESTBENCH_IN        "IN"    /**< @brief The string that indicates that the following lines in a testbench file contain input values */
 #define TESTBENCH_OUT       "OUT"   /**< @brief The string that indicates that the following lines in a testbench file contain names of outputs whose values should be printed */
 #define TB_GENERAL_DELIM    " "     /**< @brief A general delimiter for testbench files */
 #define TB_IN_VAL_DELIM     ", "    /**< @brief The string that separates the input values of one test from the next in a testbench file */
+#define SYM_TABLE_SIZE      1024    /**< @brief The initial number of slots of the symbol table where names are interned (see intern()) */
+
+/**
+ * @brief   The id of an interned name (see intern()).
+ */
+typedef uint32_t SymId;
+
+/**
+ * @brief   The table where every name is interned: the names in the order they were
+ *          interned (their ids) and an open addressing hash table of ids to find them.
+ */
+typedef struct sym_table {
+    char **names;       /**< @brief The interned names, indexed by id */
+    SymId count;        /**< @brief The number of interned names */
+    SymId cap;          /**< @brief The number of names that fit in names */
+    SymId *slots;       /**< @brief The hash table, an id per slot (or SYM_NONE for an empty one) */
+    SymId slotc;        /**< @brief The number of slots (a power of 2, at least twice count) */
+    Arena *arena;       /**< @brief Where the names are stored (each one after its id) */
+} SymTable;
+
+#define SYM_NONE ((SymId)-1)    /**< @brief An empty slot of the symbol table */
+
+/**
+ * @brief   An entry of an Index: what was found under a key.
+ */
+typedef struct index_entry {
+    int key;    /**< @brief The key (a name's SymId, or a component id) */
+    int pos;    /**< @brief The position of what was found in its list */
+    void *ptr;  /**< @brief What was found (a Standard, a Node, ...), if the index keeps it */
+} IndexEntry;
+
+/**
+ * @brief   A hash table from integer keys to positions (and pointers), so that libraries and
+ *          subsystems can be searched by name (the SymId of the interned name) or by id
+ *          without walking their lists.
+ */
+typedef struct index {
+    IndexEntry *entries;    /**< @brief The slots of the table (open addressing, INDEX_EMPTY keys are empty) */
+    int cap;                /**< @brief The number of slots (a power of 2, at least twice count) */
+    int count;              /**< @brief The number of keys in the table */
+} Index;
+
+#define INDEX_EMPTY INT32_MIN   /**< @brief The key of an empty slot of an Index */
 
 /**
  * Since a single node structure is used for all linked list needs of the
@@ -93,6 +151,36 @@ enum MAPPING_TYPE {
     SUBSYS_COMP     /**< @brief The input/output is another component (gate) in the subsystem */
 };
 
+/**
+ * The bitwise operation that a gate's truth table boils down to, so that the gate can be
+ * evaluated on many test vectors at once (one per bit of a word). Anything that is not one
+ * of the well known functions is evaluated as a generic lookup table.
+*/
+enum GATE_OP {
+    OP_CONST0,  /**< @brief The output is always 0 */
+    OP_CONST1,  /**< @brief The output is always 1 */
+    OP_BUF,     /**< @brief The output is the (single) input */
+    OP_NOT,     /**< @brief The output is the inverse of the (single) input */
+    OP_AND,     /**< @brief The output is 1 only if all inputs are 1 */
+    OP_NAND,    /**< @brief The output is 0 only if all inputs are 1 */
+    OP_OR,      /**< @brief The output is 0 only if all inputs are 0 */
+    OP_NOR,     /**< @brief The output is 1 only if all inputs are 0 */
+    OP_XOR,     /**< @brief The output is 1 if an odd number of inputs are 1 */
+    OP_XNOR,    /**< @brief The output is 1 if an even number of inputs are 1 */
+    OP_LUT      /**< @brief Anything else, the truth table is used as is */
+};
+
+/**
+ * The ways in which a testbench can be executed.
+*/
+enum SIM_MODE {
+    SIM_SCALAR,         /**< @brief Every test vector is simulated on its own (see simulator_run()) */
+    SIM_BIT_PARALLEL,   /**< @brief 64 test vectors are packed in the bits of a word and simulated at once */
+    SIM_EVENT,          /**< @brief Only the gates whose inputs changed since the previous test vector are evaluated */
+    SIM_NATIVE,         /**< @brief Like SIM_BIT_PARALLEL, but with the subsystem generated as C and compiled to machine code */
+    SIM_JIT             /**< @brief Like SIM_BIT_PARALLEL, but with the subsystem translated to x86-64 machine code in memory */
+};
+
 /**
  * @brief A dynamic way of referring to inputs and components of a subsystem.
  * 
@@ -137,11 +225,20 @@ typedef struct node {
  * 
  * @details It contains a linked list with the `things` it contains, as well as
  *          the name of the file in which they were defined.
+ * 
+ *          Everything that the parsers (and netlist_to_gate_only()) put in a library is
+ *          allocated from its arena: the standards, the gates and subsystems, their
+ *          components, mappings, lists and nodes. free_lib() frees all of it at once,
+ *          only what cannot live in an arena (indexes, compiled programs) is freed one
+ *          by one.
  */
 typedef struct netlist {
     enum STANDARD_TYPE type;        /**< @brief The possible types are the same  */
     struct linked_list *contents;   /**< @brief The contents of the library */
     char *file;                     /**< @brief The file the library was defined in */
+    Index *index;                   /**< @brief The standards of the library by name (kept by add_to_lib(), see find_in_lib()) */
+    struct lazy_lib *lazy;          /**< @brief What is needed to parse the subsystems that are not parsed yet (see subsys_lib_open_lazy()), NULL if there are none */
+    Arena *arena;                   /**< @brief Where the contents of the library are allocated (freed by free_lib()), NULL if they are malloc()'d one by one */
 } Netlist;
 
 /**
@@ -150,16 +247,19 @@ typedef struct netlist {
  * 
  * @details Gates are defined in a component library and can be used as components of subsystems.
  * 
- *          With the addition of truth tables, and with the choice to represent them as a bitstring (i.e. an
- *          integer), came the limitation of gates having up to sizeof(int)*8 (usually =32) inputs. Of course
- *          this could be overcome by replacing the integer with a long, or a long long, but what gate could/would
- *          have that many inputs?
+ *          The truth table is kept as a bitstring packed in 64-bit words, one bit per row: row r (the
+ *          row where the inputs, read as a binary number with the first input as the MSB, equal r) is bit
+ *          r%64 of word r/64. This way any row can be looked up directly with the inputs as the index (see
+ *          eval_index()), and gates can have up to MAX_GATE_INPUTS inputs (2^16 rows, 1024 words), which is
+ *          enough for wide AOI/OAI cells and LUT6s.
+ * 
+ *          The names of a gate (like all names in a netlist, see intern()) are interned.
  */
 typedef struct gate {
     char* name;                     /**< @brief The name of this gate (ASCII, human readable). */
     int _inputc;                    /**< @brief The number of inputs the gate has (mainly for internal use). */
     char** inputs;                  /**< @brief The names of the inputs of the gate. */
-    int truth_table;                /**< @brief The truth table of the gate, represented as a bitstring (integer) */
+    uint64_t *truth_table;          /**< @brief The truth table of the gate, a bitstring of 2^_inputc bits packed in TT_WORDS(_inputc) words (see details) */
 } Gate;
 
 /**
@@ -171,6 +271,9 @@ typedef struct gate {
  * 
  *          Due to the dynamic nature of the structures used to implement them (linked lists!),
  *          subsystems can contain an arbitrarily high (or low) number of components.
+ * 
+ *          All the names of a subsystem (its own, those of its inputs and outputs and its output
+ *          mappings) are interned (see intern()): the lists belong to the subsystem, the names do not.
  */
 typedef struct subsystem {
     char* name;                     /**< @brief The name of this subsystem (ASCII, human readable). */
@@ -183,6 +286,15 @@ typedef struct subsystem {
     int is_standard;                /**< @brief Boolean flag indicating whether the subsystem is a standard one */
     Mapping **o_maps;               /**< @brief If the subsystem is a standard one, along the outputs there will be output mappings */
     struct linked_list *aliases;    /**< @brief The signal aliases that the netlist in which the subsystem was defined used. Useful only during parsing. */
+    struct sim_program *program;    /**< @brief The compiled form of the subsystem that simulate() uses (built on first use, NULL until then) */
+    Index *comp_index;              /**< @brief The components by id (kept by subsys_add_comp(), NULL until the first one is added) */
+    Index *input_index;             /**< @brief The inputs by name (built on first use by subsys_input(), NULL until then) */
+    Index *output_index;            /**< @brief The outputs by name (built on first use by subsys_output(), NULL until then) */
+    Index *alias_index;             /**< @brief The aliases by name (kept by subsys_add_alias(), NULL until the first one is added) */
+    Arena *arena;                   /**< @brief The arena of the library where the subsystem, its lists and its mappings are allocated (NULL if they are malloc()'d) */
+    struct comp_store *store;       /**< @brief The components laid out in arrays (built on first use by subsys_store(), NULL until then and whenever the components change) */
+    struct flat_template *tmpl;     /**< @brief The subsystem flattened to gates, ready to be copied for every instance (built on first use by subsys_template(), NULL until then and whenever the components change) */
+    struct sim_model *model;        /**< @brief The form of the subsystem that is simulated without flattening it (built on first use by subsys_model(), NULL until then) */
 } Subsystem;
 
 /**
@@ -228,17 +340,68 @@ typedef struct component {
     Standard *prototype;    /**< @brief The subsystem/gate that the component is an instance of */
     int is_standard;        /**< @brief Boolean flag indicating whether the component is contained in a standard subsystem */
     int _inputc;            /**< @brief The number of inputs (more precisely, input mappings) the component has */
-    char **inputs;          /**< @brief The names of the input signals of the component */
+    char **inputs;          /**< @brief The (interned, see intern()) names of the input signals of the component */
     Mapping **i_maps;       /**< @brief If the component is part of a standard subsystem, along the inputs there will be input mappings */
     int buffer_index;       /**< @brief The index of the component in the simulation buffers */
 } Component;
 
+/**
+ * @brief   The components of a subsystem laid out densely, one array per field.
+ * 
+ * @details Component k (the k'th one of the list, which is what mappings refer to with index k) is
+ *          comps[k], an instance of protos[k] with id ids[k]. Its input mappings are copied one after
+ *          the other in fanin, from fanin_start[k] up to fanin_start[k+1] (a component without mappings
+ *          has none there). This way any component is found by its position in O(1) and a pass over all
+ *          of them (see compile_subsystem()) reads memory in order instead of following the list.
+ * 
+ *          A store is built from the list by subsys_store() and thrown away when the list changes.
+ */
+typedef struct comp_store {
+    int compc;              /**< @brief The number of components */
+    Component **comps;      /**< @brief The components, in the order of the list */
+    Standard **protos;      /**< @brief The prototype of each component */
+    int *ids;               /**< @brief The id of each component */
+    int *buffer_index;      /**< @brief The index of each component in the simulation buffers */
+    int *fanin_start;       /**< @brief Where the input mappings of each component start in fanin (compc+1 entries, the last one is the total) */
+    Mapping *fanin;         /**< @brief The input mappings of all the components, back to back */
+} CompStore;
+
+/**
+ * @brief   A standard subsystem flattened to gates once, so that it can be copied for every component
+ *          that instantiates it (see netlist_to_gate_only()).
+ * 
+ * @details Every signal is an integer net, relative to the subsystem: nets 0 to inputc-1 are its inputs
+ *          and net inputc+g is the output of gate g. Gate g is an instance of protos[g] and reads the
+ *          nets from fanin_start[g] up to fanin_start[g+1] in fanin; output o is net out_nets[o].
+ * 
+ *          An instance is made by copying protos and fanin, mapping the nets of the inputs to the nets
+ *          that the instance reads and adding the same offset to all the others.
+ * 
+ *          A template is built from the components by subsys_template() and thrown away when they change.
+ */
+typedef struct flat_template {
+    int inputc;             /**< @brief The number of inputs of the subsystem */
+    int outputc;            /**< @brief The number of outputs of the subsystem */
+    int gatec;              /**< @brief The number of gates */
+    Standard **protos;      /**< @brief The gate that each gate is an instance of */
+    int *fanin_start;       /**< @brief Where the input nets of each gate start in fanin (gatec+1 entries, the last one is the total) */
+    int *fanin;             /**< @brief The input nets of all the gates, back to back */
+    int *out_nets;          /**< @brief The net of each output */
+    int depth;              /**< @brief How many levels of subsystems there are below this one (0 if it only has gates) */
+    int *level_gatec;       /**< @brief How many of the gates come from each level, from 0 (its own gates) to depth */
+} FlatTemplate;
+
 /**
  * @brief   A singly linked list, containing pointers to its first and last nodes.
+ * 
+ * @details The nodes of a list with an arena (and what they contain) are allocated from
+ *          that arena, so freeing the list does nothing (see ll_free()).
  */
 typedef struct linked_list {
     Node *head;     /**< @brief The first element of the list */
     Node *tail;     /**< @brief The last element in the list */
+    int size;       /**< @brief The number of elements in the list */
+    Arena *arena;   /**< @brief Where the list, its nodes and their contents are allocated (NULL if they are malloc()'d) */
 } LList;
 
 /**
@@ -282,7 +445,7 @@ typedef struct linked_list {
  * 
 */
 typedef struct alias {
-    char *name;         /**< @brief The name of the alias (how it will be referred to in a netlist) */
+    char *name;         /**< @brief The (interned) name of the alias (how it will be referred to in a netlist) */
     Mapping *mapping;   /**< @brief A mapping to the thing that this is an alias of */
 } Alias;
 
@@ -293,10 +456,281 @@ typedef struct alias {
 typedef struct testbench {
     Subsystem *uut;     /**< @brief The Unit Under Test, the subsystem whose function will be simulated */
     char ***values;     /**< @brief The list of values that will be tried for each input */
+    Arena *arena;       /**< @brief Where the values (and their lists) are allocated, freed all at once by free_tb() */
     int v_c;            /**< @brief The number of values (and thus simulations) that this testbench provides */
     int *outs_display;  /**< @brief A list of booleans indicating whether or not each output should be displayed (all 0 by default) */
+    enum SIM_MODE mode; /**< @brief The way in which the testbench will be executed (set by the caller, see execute_tb()) */
+    int width;          /**< @brief In bit-parallel mode, the number of 64-bit words per signal (0 for the widest the CPU supports, see select_kernel()) */
+    int threads;        /**< @brief The number of threads that the tests will be split across (1 or less for none, see execute_tb_parallel()) */
+    char *cache_dir;    /**< @brief In native mode, the directory where the compiled subsystems are kept (see compile_program_native()) */
 } Testbench;
 
+/**
+ * @brief   A single step of a compiled simulation: the evaluation of one gate.
+ *
+ * @details The values of all the signals of a compiled subsystem are kept in a flat
+ *          array of "slots". The first slots hold the inputs of the subsystem, and
+ *          every component has one more slot where its output is stored. An instruction
+ *          reads the slots of the inputs of its gate and writes the result of the gate's
+ *          truth table in the slot of its output.
+ */
+typedef struct sim_instr {
+    Gate *gate;     /**< @brief The gate that is evaluated (its truth table and number of inputs) */
+    enum GATE_OP op;/**< @brief The bitwise operation that the gate's truth table is equivalent to */
+    int *in_slots;  /**< @brief The slots where the values of the gate's inputs are found (as many as the inputs of the gate) */
+    int out_slot;   /**< @brief The slot where the output of the gate will be written */
+} SimInstr;
+
+/**
+ * @brief   A gate-only subsystem compiled down to a flat list of instructions.
+ *
+ * @details If the subsystem has no combinational cycles, its components are sorted
+ *          topologically (levelized) so that every gate comes after all the gates that
+ *          drive it. Executing the instructions in order then evaluates the whole
+ *          subsystem in exactly one pass, instead of iterating until nothing changes.
+ *
+ *          If the subsystem has a cycle, the instructions are kept in the order of the
+ *          components and the levelized flag is not set, in which case simulate() falls
+ *          back to iterating until a fixed point is reached.
+ */
+typedef struct sim_program {
+    int slotc;          /**< @brief The number of slots (subsystem inputs + components) */
+    int instrc;         /**< @brief The number of instructions (one per component) */
+    SimInstr *instrs;   /**< @brief The instructions, in topological order if levelized is set */
+    int *fanin;         /**< @brief The input slots of all instructions in one array (the in_slots of each instruction point in here) */
+    int outc;           /**< @brief The number of outputs of the subsystem */
+    int *out_slots;     /**< @brief The slot that each output of the subsystem is mapped to */
+    int levelized;      /**< @brief Boolean flag indicating whether the instructions are in topological order (no cycles) */
+    int *fanout_start;  /**< @brief Where the fanout of each slot starts in the fanout array (slotc+1 entries, the last one is the end) */
+    int *fanout;        /**< @brief The instructions that read each slot, grouped by slot (see fanout_start) */
+    int *level;         /**< @brief The level of each instruction (0 if it only reads inputs, else 1 + the highest level of its drivers) */
+    int levelc;         /**< @brief The number of levels (1 if the program is not levelized) */
+    void (*native)(uint64_t*);  /**< @brief The program compiled to machine code (NULL until compile_program_native() is called) */
+    int native_width;   /**< @brief The number of 64-bit words per slot that the native code works with */
+    void *native_handle;/**< @brief The handle of the shared object where the native code was loaded from (see dlopen()) */
+    void (*jit)(uint64_t*);     /**< @brief The program translated to machine code in memory (NULL until jit_compile_program() succeeds) */
+    int jit_width;      /**< @brief The number of 64-bit words per slot that the jit code (or its fallback) works with */
+    void *jit_code;     /**< @brief The executable memory where the jit code lives (see mmap()) */
+    size_t jit_size;    /**< @brief The size of that memory */
+} SimProgram;
+
+/**
+ * @brief   A single step of a hierarchical simulation: the evaluation of one gate, or of a whole
+ *          subsystem through its own model (see SimModel).
+ */
+typedef struct model_instr {
+    Gate *gate;                 /**< @brief The gate that is evaluated (NULL if it is a subsystem) */
+    struct sim_model *sub;      /**< @brief The model of the subsystem that is evaluated (NULL if it is a gate) */
+    int *in_slots;              /**< @brief The slots where the values of the inputs are found (as many as the inputs of the gate or subsystem) */
+    int out_slot;               /**< @brief The slot of the output of the gate, or of the first output of the subsystem (the rest follow it) */
+} ModelInstr;
+
+/**
+ * @brief   A subsystem compiled for simulation without being flattened to gates.
+ *
+ * @details A subsystem that only has gates is simulated with its compiled program (see SimProgram).
+ *          Any other one has the instructions of its components in topological order: a gate is
+ *          evaluated in place, and a subsystem by running the model of its standard, which is shared
+ *          by all of its instances (so a subsystem with 4096 instances of a full adder holds the gates
+ *          of one). The first slots hold the inputs, and every component has a slot for each of its
+ *          outputs, so a mapping to output out_index of component k is one slot.
+ *
+ *          A model is run in a frame of bit-packed slots (see SLOT_BIT()), and the subsystems that it
+ *          instantiates in the frame that follows it: frame_words words are enough for the whole chain.
+ *
+ *          A model refers to the models of the subsystems that it instantiates, so they must not be
+ *          changed (see collapse_to_luts()) while it is used.
+ */
+typedef struct sim_model {
+    int inputc;         /**< @brief The number of inputs of the subsystem (the first slots) */
+    int slotc;          /**< @brief The number of slots (inputs + the outputs of every component) */
+    int instrc;         /**< @brief The number of instructions (one per component, 0 if gates is set) */
+    ModelInstr *instrs; /**< @brief The instructions, in topological order */
+    int *fanin;         /**< @brief The input slots of all instructions in one array (the in_slots of each instruction point in here) */
+    int outc;           /**< @brief The number of outputs of the subsystem */
+    int *out_slots;     /**< @brief The slot that each output of the subsystem is mapped to */
+    SimProgram *gates;  /**< @brief The program of the subsystem if it only has gates (owned by the subsystem), NULL otherwise */
+    int frame_words;    /**< @brief The number of words that a run needs: the frame of the model and the frames of the subsystems below it */
+} SimModel;
+
+/**
+ * @brief   The state of an event-driven simulation of a compiled program.
+ *
+ * @details The values of all the slots are kept from one test vector to the next. When
+ *          new inputs are applied, only the gates in the fanout of the inputs that toggled
+ *          are evaluated, and only the gates whose output actually changed pass the event
+ *          on to their own fanout. Scheduled gates are kept in one bucket per level and the
+ *          levels are processed in ascending order, so every gate is evaluated at most once
+ *          per vector, after all of its drivers have settled.
+ */
+typedef struct event_sim {
+    SimProgram *program;/**< @brief The program that is simulated (not owned by the simulation) */
+    uint64_t *bits;     /**< @brief The current value of every slot, one bit each (see SLOT_BIT()) */
+    char *scheduled;    /**< @brief Whether each instruction is already scheduled for the current vector */
+    int *bucket_start;  /**< @brief Where the bucket of each level starts in the queue (levelc+1 entries) */
+    int *bucket_fill;   /**< @brief How many instructions are scheduled in the bucket of each level */
+    int *queue;         /**< @brief The scheduled instructions, grouped in buckets by level */
+    int initialized;    /**< @brief Boolean flag indicating whether the slots hold the result of a previous vector */
+    long evaluations;   /**< @brief The total number of gate evaluations since the simulation was created */
+} EventSim;
+
+/**
+ * @brief   A reusable context for simulating one subsystem, one test vector at a time.
+ *
+ * @details Everything that a simulation needs is prepared once: the subsystem is compiled
+ *          (so every mapping is already a flat slot index) and the buffers where the values
+ *          of the signals are kept are allocated. Running a vector then only costs the gate
+ *          evaluations: there is no string handling, allocation or walking of lists.
+ *
+ *          The inputs and outputs are packed in bits, input (or output) i is bit i%64 of
+ *          word i/64.
+ *
+ *          A simulator must not be used by more than one thread at once, but any number of
+ *          simulators can share the (compiled) subsystem.
+ */
+typedef struct simulator {
+    Subsystem *subsys;  /**< @brief The subsystem that is simulated (not owned by the simulator) */
+    SimProgram *program;/**< @brief The compiled form of the subsystem (owned by the subsystem) */
+    uint64_t *bits;     /**< @brief The values of the signals, one bit per slot (see SimProgram and SLOT_BIT()) */
+    uint64_t *prev;     /**< @brief The values of the signals in the previous pass (only used if the program has cycles) */
+    int words;          /**< @brief The number of words in bits and prev */
+    int iterations;     /**< @brief The number of passes over the gates that the last vector needed */
+    SimModel *model;    /**< @brief If the subsystem instantiates subsystems, the model that it is simulated with (program is NULL then) */
+} Simulator;
+
+/**
+ * @brief   A function that executes a compiled program on a number of lanes at once
+ *          (see run_program_lanes()), along with the number of 64-bit words each slot
+ *          has for it.
+ *
+ * @details Slot i of the program occupies words [i*width, (i+1)*width) of the slots array,
+ *          so a kernel of width w simulates 64*w test vectors per pass.
+ *
+ *          Kernels that need a particular instruction set (AVX2, AVX-512) can only be used
+ *          if their supported() function (a CPUID check) says so. select_kernel() takes
+ *          care of that.
+ */
+typedef struct sim_kernel {
+    char *name;                                     /**< @brief The name of the kernel (ASCII, human readable) */
+    int width;                                      /**< @brief The number of 64-bit words per slot */
+    void (*run)(SimProgram *p, uint64_t *slots);    /**< @brief The function that executes the program */
+    int (*supported)();                             /**< @brief Whether the CPU can run the kernel (NULL if any CPU can) */
+} SimKernel;
+
+/**
+ * @brief   All the kernels that the library provides, terminated by one with a NULL name.
+ */
+extern SimKernel sim_kernels[];
+
+/**
+ * @brief   Where a table of a library image is in the file, and how many entries it has.
+ */
+typedef struct img_table {
+    uint64_t offset;    /**< @brief The offset of the first entry from the start of the file */
+    uint64_t count;     /**< @brief The number of entries */
+} ImgTable;
+
+/**
+ * @brief   The start of a library image file: a gate and a subsystem library, compiled into
+ *          tables that refer to each other by position instead of by pointer.
+ *
+ * @details Every name is a string of the strings table, referred to by its position in the
+ *          string_offs table (which holds where it starts in strings, it ends with a null byte).
+ *          Lists of names are runs of positions in the names table, truth tables are runs of
+ *          words in the words table. The components of a subsystem (and its aliases) are a run
+ *          of consecutive entries in their tables, the mappings of a component (or subsystem)
+ *          are a run of consecutive mappings.
+ *
+ *          Since nothing in the file is a pointer, it can be mapped anywhere, read-only and
+ *          shared by all the processes that use it. The hashes of the text files that it was
+ *          compiled from tell whether it is still up to date.
+ */
+typedef struct lib_image_header {
+    char magic[8];          /**< @brief LIB_IMAGE_MAGIC */
+    uint32_t version;       /**< @brief LIB_IMAGE_VERSION */
+    uint32_t reserved;      /**< @brief Always 0 */
+    uint64_t size;          /**< @brief The size of the whole file */
+    uint64_t gate_hash;     /**< @brief The hash of the contents of the gate library file (see hash_bytes()) */
+    uint64_t subsys_hash;   /**< @brief The hash of the contents of the subsystem library file */
+    ImgTable strings;       /**< @brief The characters of the names */
+    ImgTable string_offs;   /**< @brief Where each name starts in strings (uint32_t) */
+    ImgTable names;         /**< @brief The lists of names (uint32_t positions in string_offs, IMG_NONE for NULL) */
+    ImgTable words;         /**< @brief The truth tables of the gates (uint64_t) */
+    ImgTable gates;         /**< @brief The gates of the gate library (ImgGate) */
+    ImgTable subsystems;    /**< @brief The subsystems of the subsystem library (ImgSubsys) */
+    ImgTable comps;         /**< @brief The components of all subsystems (ImgComp) */
+    ImgTable maps;          /**< @brief The mappings of all components and subsystems (ImgMapping) */
+    ImgTable aliases;       /**< @brief The aliases of all subsystems (ImgAlias) */
+} LibImageHeader;
+
+/**
+ * @brief   A gate in a library image (see Gate).
+ */
+typedef struct img_gate {
+    uint32_t name;      /**< @brief The name (position in string_offs) */
+    uint32_t inputc;    /**< @brief The number of inputs */
+    uint32_t inputs;    /**< @brief The first of the names of the inputs in the names table */
+    uint32_t tt;        /**< @brief The first word of the truth table in the words table (TT_WORDS(inputc) words) */
+} ImgGate;
+
+/**
+ * @brief   A subsystem in a library image (see Subsystem).
+ */
+typedef struct img_subsys {
+    uint32_t name;              /**< @brief The name (position in string_offs) */
+    uint32_t inputc;            /**< @brief The number of inputs */
+    uint32_t inputs;            /**< @brief The first of the names of the inputs in the names table */
+    uint32_t outputc;           /**< @brief The number of outputs */
+    uint32_t outputs;           /**< @brief The first of the names of the outputs in the names table */
+    uint32_t output_mappings;   /**< @brief The first of the signals mapped to the outputs in the names table */
+    uint32_t o_maps;            /**< @brief The first of the mappings of the outputs (outputc of them) */
+    uint32_t comps;             /**< @brief The first of the components */
+    uint32_t compc;             /**< @brief The number of components */
+    uint32_t aliases;           /**< @brief The first of the aliases */
+    uint32_t aliasc;            /**< @brief The number of aliases */
+    uint32_t is_standard;       /**< @brief Whether the subsystem is a standard one */
+} ImgSubsys;
+
+/**
+ * @brief   A component in a library image (see Component).
+ */
+typedef struct img_comp {
+    int32_t id;             /**< @brief The id of the component */
+    uint32_t lib;           /**< @brief The library of the prototype (GATE for the gate library, SUBSYSTEM for the subsystem library) */
+    uint32_t proto;         /**< @brief The position of the prototype in its library */
+    uint32_t inputc;        /**< @brief The number of inputs */
+    uint32_t inputs;        /**< @brief The first of the names of the input signals in the names table */
+    uint32_t i_maps;        /**< @brief The first of the mappings of the inputs (IMG_NONE if there are none) */
+    int32_t buffer_index;   /**< @brief The index of the component in the simulation buffers */
+    uint32_t is_standard;   /**< @brief Whether the component is contained in a standard subsystem */
+} ImgComp;
+
+/**
+ * @brief   A mapping in a library image (see Mapping), a type of -1 stands for a NULL one.
+ */
+typedef struct img_mapping {
+    int32_t type;       /**< @brief The type of the mapping (-1 if there is none) */
+    int32_t index;      /**< @brief The index of the input or of the component */
+    int32_t out_index;  /**< @brief The index of the output of the component */
+} ImgMapping;
+
+/**
+ * @brief   An alias in a library image (see Alias).
+ */
+typedef struct img_alias {
+    uint32_t name;      /**< @brief The name (position in string_offs) */
+    uint32_t mapping;   /**< @brief The position of its mapping (IMG_NONE if there is none) */
+} ImgAlias;
+
+/**
+ * @brief   A library image mapped in memory (see lib_image_open()).
+ */
+typedef struct lib_image {
+    char *data;                 /**< @brief The contents of the file (mapped read-only) */
+    size_t size;                /**< @brief The size of the file */
+    LibImageHeader *header;     /**< @brief The header, at the start of data */
+} LibImage;
+
 /**
  * @brief Initialize a linked list instance.
  * 
@@ -306,6 +740,14 @@ typedef struct testbench {
  */
 LList* ll_init();
 
+/**
+ * @brief   Initialize a linked list whose nodes (and their contents) will be allocated from the given arena.
+ * 
+ * @param arena The arena (NULL for a list like the ones of ll_init())
+ * @return The newly created list (allocated from the arena too)
+ */
+LList* ll_init_in(Arena *arena);
+
 /**
  * @brief   Add the given node to the given linked list.
  * 
@@ -321,6 +763,8 @@ int ll_add(LList *ll, Node* new_element);
  *          flag indicates whether (1) or not (0) the contents of the nodes should
  *          also be free()'d.
  * 
+ * @details A list with an arena is left alone, it goes away with its arena.
+ * 
  * @param l         The list that will be freed
  * @param complete  Whether the contents of the nodes should be freed as well
  */
@@ -347,12 +791,13 @@ void ll_print(LList *l);
  * @param n         The maximum number of bytes that can be read from the string
  * @param parse_tt  A boolean flag indicating whether (1) or not (0) to also parse the
  *                  truth table for the gate.
+ * @param arena     Where the input list and the truth table are allocated (NULL for malloc())
  * 
  * @retval 0 on success
  * @retval NES on failure because of not enough space
  * @retval NARG on failure because of null arguments.
  */
-int str_to_gate(char *str, Gate *g, int n, int parse_tt);
+int str_to_gate(char *str, Gate *g, int n, int parse_tt, Arena *arena);
 
 /**
  * @brief   Write an ASCII representation of the given gate to str, writing no more
@@ -372,7 +817,7 @@ int gate_to_str(Gate *g, char *str, int n);
  * @brief   Read up to n bytes from str and parse the information into the fields
  *          of a. Everything that a refers to will be looked for in s. @see resolve_mapping()
  * 
- * @details Does not allocate memory for the alias itself, but does for the mapping.
+ * @details Does not allocate memory for the alias itself, but does for the mapping (from the arena of s).
  * 
  * @param str   The str from which the data will be read
  * @param a     The alias into which the data will be parsed
@@ -440,6 +885,10 @@ void free_node(Node *n, int complete);
  *          depends on the UUT's attributes to be able to do its job correctly, and
  *          behavio if the UUT is free'd before this is called is undefined.
  * 
+ * @note    The values, arena and outs_display fields must either have been set
+ *          by parse_tb_from_file() or be NULL, so initialize them to NULL when
+ *          creating the testbench.
+ * 
  * @param tb    A pointer to the memory that will be freed.
  */
 void free_tb(Testbench *tb);
@@ -480,6 +929,9 @@ int gate_lib_from_file(char *filename, Netlist* lib);
  * @brief   Properly free up the memorey allocated for and used by a library and
  *          its members.
  * 
+ * @details If the library has an arena, its contents are freed along with it: only the
+ *          subsystems are visited (for their indexes and compiled programs), not their components.
+ * 
  * @param lib   The library to be freed
  */
 void free_lib(Netlist *lib);
@@ -491,6 +943,9 @@ void free_lib(Netlist *lib);
  * @details free_comp is a flag that indicates whether the individual components
  *          of the subsystem should be freed.
  * 
+ *          If the subsystem was allocated from an arena, only what is not in the arena
+ *          (its indexes, its compiled program, and any list that was malloc()'d) is freed.
+ * 
  * @param s             The subsystem that will be freed
  * @param free_comp     Whether or not the components of the subsystem should also
  *                      be freed
@@ -525,7 +980,7 @@ int subsys_hdr_to_str(Subsystem* s, char* str, int n);
  *          Does not allocate memory for the subsystem itself, but does for every input
  *          and output (and also for the lists), so using this on an already initialized
  *          subsystem might cause memory leaks, as pointers to the previously allocated
- *          memory will be lost.
+ *          memory will be lost. The lists are allocated from the arena of s.
  * 
  *          Does not set s->source.
  * 
@@ -571,6 +1026,71 @@ int subsys_add_comp(Subsystem *s, Component *c);
  */
 int subsys_lib_from_file(char *filename, Netlist *lib, Netlist *lookup_lib);
 
+/**
+ * @brief   Like subsys_lib_from_file(), but the subsystems are parsed by the given number of threads.
+ * 
+ * @details The file is split into blocks, one per subsystem (from its declaration up to the next
+ *          one), which are handed to the threads. Any referenced subsystem/gate is looked up in
+ *          lookup_lib only, so the blocks do not depend on each other. The subsystems are added
+ *          to the library in the order of the file, so the result is the same as that of
+ *          subsys_lib_from_file(), and so is the error that is returned (the one of the first
+ *          block that failed, in which case the library holds the subsystems before it). The
+ *          messages that parsing each block prints are kept until all the blocks are parsed, and
+ *          only the ones of the blocks up to the first one that failed are printed, in order.
+ * 
+ * @param filename      The name of the file from which the library will be read
+ * @param lib           The library to which the data will be written
+ * @param lookup_lib    The library that will be searched for any referenced subsystem/gate
+ * @param threads       The number of threads, with 1 or less (or a lazily loaded lookup_lib, see subsys_lib_open_lazy()) the file is parsed by subsys_lib_from_file()
+ *
+ * @retval 0 on success
+ * @retval GENERIC_ERROR if the file could not be read
+ * @retval NARG on failure because of null arguments.
+ */
+int subsys_lib_from_file_parallel(char *filename, Netlist *lib, Netlist *lookup_lib, int threads);
+
+/**
+ * @brief   Like subsys_lib_from_file(), but each subsystem is only parsed when it is first
+ *          looked up (see find_in_lib()).
+ * 
+ * @details The file is read once to find where the block of each subsystem starts and ends
+ *          (only the declarations are looked at), nothing is parsed. When find_in_lib() does not
+ *          find a subsystem among the ones parsed so far, it parses its block and adds it to the
+ *          library. Parsing it looks up its components in lookup_lib, which may be lazily loaded
+ *          too (or be lib itself), so the subsystems that it is built from are parsed first, and so on.
+ *          A subsystem that is (directly or not) made of itself is reported as unknown.
+ * 
+ *          If a subsystem is defined more than once, the first definition is the one that is used.
+ *          The file is kept open until the library is freed (see free_lib()).
+ * 
+ * @note    The library (or one that looks it up) must not be used by many threads at once, since
+ *          looking up anything in it may parse more of it.
+ * 
+ * @param filename      The name of the file from which the library will be read
+ * @param lib           The library to which the data will be written
+ * @param lookup_lib    The library that will be searched for any referenced subsystem/gate
+ *
+ * @retval 0 on success
+ * @retval GENERIC_ERROR if the file could not be read
+ * @retval NARG on failure because of null arguments.
+ */
+int subsys_lib_open_lazy(char *filename, Netlist *lib, Netlist *lookup_lib);
+
+/**
+ * @brief   Return the error code that parsing the subsystem with the given name of a lazily
+ *          loaded library returned (see subsys_lib_open_lazy()), so that a caller can tell a
+ *          subsystem that is not in the file from one that could not be parsed when
+ *          find_in_lib() returns NULL.
+ * 
+ * @param lib   The library that the subsystem was looked up in
+ * @param name  The name of the subsystem
+ * 
+ * @retval 0 if the subsystem was parsed, is not parsed yet, is not in the file or the library is not lazily loaded
+ * @retval NARG on failure because of null arguments.
+ * @retval the error code of the block of the subsystem otherwise
+ */
+int lazy_lib_error(Netlist *lib, char *name);
+
 /**
  * @brief   Properly free up the memory allocated for component c and its
  *          members.
@@ -669,6 +1189,9 @@ int str_to_mapping(char *str, Subsystem *subsys, Mapping *m, int n);
  *          will be created is read from a library and should thus include
  *          input mappings or not.
  * 
+ *          The lists and mappings of the component are allocated from the
+ *          arena of s (with malloc() if there is no s or it has no arena).
+ * 
  * @param str           The string that contains the component representation
  * @param c             The component to which the data will be written
  * @param n             The maximum number of bytes that can be read from the string
@@ -698,6 +1221,8 @@ Node *move_in_list(int x, LList* list);
  *          in it and the outputs will be mapped according to the standard.
  * 
  * @details    ns is assumed to be already allocated but nothing more. Must be freed by the caller.
+ *             Its arena must be set: everything in it is allocated from there (or with malloc()
+ *             if it is NULL).
  * 
  * @param ns                The "new subsystem" - the one whose data will be created in a custom fashion
  * @param std               The standard according to which the new subsystem will be created
@@ -714,7 +1239,17 @@ int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int s
  *          only gates (translate each subsystem all the way down to the gates that it is defined
  *          as in the library that it is defined in).
  * 
- * @details Stores the translated compponents in dest, which is assumed to be allocated.
+ * @details Stores the translated subsystems in dest (as standard subsystems), which is assumed
+ *          to be allocated. Everything in dest is allocated from its own arena.
+ * 
+ *          The subsystems are flattened on integer nets: every gate is one net, and a gate only
+ *          refers to the nets that it reads with mappings (to the inputs of the subsystem or to
+ *          earlier gates). No names are built for the gates' inputs and outputs, the components
+ *          have no inputs and the subsystems no output_mappings; they are only resolved to names
+ *          when the library is written (see lib_to_file()). The result can be simulated as is.
+ * 
+ *          Subsystems are flattened down to their gates however deep they are (see subsys_template()),
+ *          without writing the levels in between to files.
  * 
  *          Starts the component ID numbering from the given one.
  * 
@@ -723,10 +1258,33 @@ int create_custom(Subsystem *ns, Standard *std, int inputc, char **inputs, int s
  * @param component_id  The starting value of the ID's of the components of the gates-only subsystem
  *
  * @retval 0 on success
- * @retval -1 on failure
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if a subsystem could not be flattened
  */
 int netlist_to_gate_only(Netlist *dest, Netlist *netlist, int component_id);
 
+/**
+ * @brief   Like netlist_to_gate_only(), but the subsystems are flattened by the given number of threads.
+ * 
+ * @details Every subsystem of the netlist is flattened on its own, into an arena of the thread that
+ *          picks it up. What the threads share is prepared first: the templates of the subsystems that
+ *          are instantiated are built (see subsys_template()), and from their sizes every subsystem gets
+ *          the id of its first gate, the same one that netlist_to_gate_only() would give it. The results
+ *          are added to dest in the order of the netlist, so dest is the same as with netlist_to_gate_only(),
+ *          and so is the error that is returned (the one of the first subsystem that failed, in which case
+ *          dest holds the subsystems before it).
+ * 
+ * @param dest          The netlist whose subsystems will only have gates as their components
+ * @param netlist       The netlist whose subsystems will be translated to gates
+ * @param component_id  The starting value of the ID's of the components of the gates-only subsystem
+ * @param threads       The number of threads, with 1 or less the netlist is flattened by netlist_to_gate_only()
+ *
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if a subsystem could not be flattened
+ */
+int netlist_to_gate_only_parallel(Netlist *dest, Netlist *netlist, int component_id, int threads);
+
 /**
  * @brief   Write the netlist for the given (non-standard) subsystem (inputs,
  *          components, outputs) to the given filename.
@@ -791,8 +1349,12 @@ void netlist_to_file(Netlist *netlist, char *filename, char *mode);
  * @param filename  The filename that the output will be written to
  * @param mode      The mode with which the file will be opened (passed verbatim
  *                  to fopen())
+ * 
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the file could not be opened
  */
-void lib_to_file(Netlist *lib, char *filename, char *mode);
+int lib_to_file(Netlist *lib, char *filename, char *mode);
 
 /**
  * @brief   Print a given library's contents in a file, but in the form that
@@ -881,7 +1443,7 @@ Standard *find_in_lib(Netlist *lib, char *name);
  * @param list      The list to search in
  * @param t         The type of the node that we are looking for
  * @param str       The name of the thing we are looking for
- * @param n         The maximum number of bytes that will be compared to str
+ * @param n         The length of the name in str (only exact matches count)
  * @param id        The id of the node that we are looking for
  * @param index     The position where the index of the item in the list will be written.
  * @retval  A pointer to the node that matches the search criteria if found
@@ -890,97 +1452,976 @@ Standard *find_in_lib(Netlist *lib, char *name);
 Node* search_in_llist(LList *list, enum NODE_TYPE t, char *str, int n, int id, int *index);
 
 /**
- * @brief   Given a string representing a truth table of a gate (in the format described in the project
- *          specification), make it a bitstring and return it (in the form of an integer).
+ * @brief   Intern the first n bytes of name: return the one copy of that name that the
+ *          whole program shares.
  * 
- * @note    Any non-bit characters (not '1' or '0') will be skipped.
+ * @details Every name stored in a gate, subsystem, component or alias (the names of the
+ *          standards, their inputs and outputs, the inputs of components, output mappings)
+ *          is interned. So each distinct name is kept in memory only once, no matter how
+ *          many times it is instantiated, and two names are equal only if they are the same
+ *          pointer. Interned names belong to the symbol table: they must never be modified
+ *          or freed (see free_symbols()).
  * 
- * @example     Suppose the input is '0, 1, 1, 0'. The bitstring would then be '0110', which means that
- *              the number 6 will be returned.
+ *          Each interned name also has a 32-bit id (see sym_id() and sym_name()), in the
+ *          order in which the names were first seen.
  * 
- * @example     Suppose that the input is '0, 1'. The bitstring would then be '01', which means that the
- *              number 1 will be returned.
+ *          Safe to call from many threads at once.
  * 
- * @param _tt   The string containing the truth table.
- * @return      The bitstring representing the given truth table.
+ * @param name  The name (does not need to be null terminated)
+ * @param n     The length of the name
+ * @return  The interned (null terminated) copy of the name
  */
-int parse_truth_table(char *_tt);
+char *intern(char *name, int n);
 
 /**
- * @brief   Given a truth table in bitstring (integer) form and a set of inputs
- *          as an array of characters, return a truth value (as an integer).
+ * @brief   Find the interned copy of the first n bytes of name, without interning it.
  * 
- * @note    The inputs array must be null terminated.
+ * @param name  The name (does not need to be null terminated)
+ * @param n     The length of the name
+ * @return  The interned copy of the name, NULL if it has never been interned (so nothing can be named like that)
+ */
+char *sym_lookup(char *name, int n);
+
+/**
+ * @brief   The id of an interned name.
  * 
- * @param tt        The truth table.
- * @param inputs    The inputs.
- * @return The truth value of the table with the given inputs (1 or 0)
+ * @param sym   The name, as returned by intern()
+ * @return  The id of the name
  */
-int eval_at(int tt, char *inputs);
+SymId sym_id(char *sym);
 
 /**
- * @brief   Given a truth table in bitstring (integer) form, print it in a nice, human readable way.
+ * @brief   The interned name with the given id.
  * 
- * @details To make debugging easy :)
+ * @param id    The id, as returned by sym_id()
+ * @return  The interned name, NULL if there is no name with that id
+ */
+char *sym_name(SymId id);
+
+/**
+ * @brief   Find the position of name in the given list of interned names.
  * 
- * @param tt        The truth table to be printed.
- * @param inputs    The number of inputs that the truth table is expected to accomodate.
+ * @details The replacement of contains() for names: the name is looked up once, and then
+ *          the list is searched by comparing pointers. Only exact matches count.
+ * 
+ * @param n     The number of names in list
+ * @param list  The interned names
+ * @param name  The name that is searched for (any string, it does not need to be interned)
+ * @return  The index of the name in list, -1 if it is not there
  */
-void print_as_truth_table(int tt, int inputs);
+int sym_index(int n, char **list, char *name);
 
 /**
- * @brief   Simulate the behavior of the given subsystem (assumed to only be made of gates) with the
- *          given set of inputs. Write the results to the given file pointer.
+ * @brief   Split str into the names separated by delim, intern them and store them in l.
  * 
- * @details The display_outs array is an array of boolean values indicating which output values should
- *          be printed to the output. The number of values in that array should therefore be equal to
- *          (or greater than, excess values will be ignored) the number of outputs of s.
+ * @details Like str_to_list(), except that only the list is allocated (and needs to be freed).
  * 
- * @note    The inputs are passed with the following format: a string of comma-delimited bits, as many
- *          as the inputs of s, each corresponding to the value of the input with its index.
+ * @param str   The string that will be split (it is not modified)
+ * @param l     The list where the interned names will be stored
+ * @param delim The delimiter on which str will be split
+ * @param arena Where the list is allocated (NULL for malloc())
+ * @return  The number of names in the list
+ */
+int str_to_sym_list(char *str, char ***l, char *delim, Arena *arena);
+
+/**
+ * @brief   Copy a list of names into a newly allocated list of interned names.
  * 
- * @example If s has 3 inputs: {A, B, C} and 2 outputs {D, E} and we want to simulate {A=1, B=1, C=0}
- *          and see the value of D, with the results printed in standard output we would call
- *          simulate as follows:
- *              simulate(s, "1, 1, 0", [1, 0], stdout)
+ * @details Like deepcopy_str_list(), but the names themselves are not copied (only interned,
+ *          if they are not already), so only the new list needs to be freed.
+ * 
+ * @param dst   Where the new list will be stored
+ * @param src   The list that will be copied
+ * @param n     The number of names in src
+ * @param arena Where the new list is allocated (NULL for malloc())
+ * @return  n
+ */
+int sym_list_copy(char ***dst, char **src, int n, Arena *arena);
+
+/**
+ * @brief   Free every interned name. Nothing that holds an interned name may be used afterwards.
+ */
+void free_symbols();
+
+/**
+ * @brief   Create an empty index with room for at least the given number of keys.
  * 
+ * @param n The number of keys that are expected (it grows as needed)
+ * @return  The new index, to be freed with free_index()
+ */
+Index *index_init(int n);
+
+/**
+ * @brief   Add a key to the index, unless it is already there (the first entry of a key is kept).
  * 
- * @param s             The subsystem whose behavior will be simulated
- * @param inputs        The input values
- * @param display_outs  An array indicating which outputs will be printed
- * @param fp            The stream where the output shall be printed
- * @return 0 on success, nonzero on error
+ * @param ix    The index
+ * @param key   The key (anything but INDEX_EMPTY)
+ * @param pos   The position of what the key refers to
+ * @param ptr   What the key refers to (may be NULL)
+ * @return  0 if it was added, 1 if the key was already there
  */
-int simulate(Subsystem* s, char *inputs, int *display_outs, FILE* fp);
+int index_put(Index *ix, int key, int pos, void *ptr);
 
 /**
- * @brief   Parse the information that describes a testbench from the given file into the
- *          given structure.
+ * @brief   Find the entry of a key.
  * 
- * @note    This does not allocate memory for the testbench struct itself, and it requires
- *          that the uut has already been set. If not, an error value will be returned.
- *          
- *          It does however allocate memory for the values array, which will need to be
- *          properly freed.
- *  
+ * @param ix    The index (may be NULL, then nothing is found)
+ * @param key   The key
+ * @return  The entry of the key, NULL if it is not in the index
+ */
+IndexEntry *index_get(Index *ix, int key);
+
+/**
+ * @brief   Free the given index.
  * 
- * @param tb        The structure where the data will be saved
- * @param filename  The file that will be parsed
- * @param mode      The mode with which fopen() will be called
- * @return 0 on success, 1 on failure.
+ * @param ix    The index
  */
-int parse_tb_from_file(Testbench *tb, char *filename, char *mode);
+void free_index(Index *ix);
 
 /**
- * @brief   Execute the given testbench and write the output to a file with the given name (that
- *          will be (f)opened with the given mode).
+ * @brief   Build the indexes of the inputs and the outputs of the given subsystem, if they
+ *          have not been built yet.
  * 
- * @param tb            The testbench to be run
- * @param output_file   The file where the output will be written
- * @param mode          The mode that will be passed to fopen()
- * @return 0 on succes, nonzero on error
+ * @details subsys_input() and subsys_output() do this on their own, it only needs to be called
+ *          before the subsystem is shared by threads that look up its signals.
+ * 
+ * @param s     The subsystem
  */
-int execute_tb(Testbench *tb, char *output_file, char *mode);
+void subsys_index_signals(Subsystem *s);
+
+/**
+ * @brief   Find an input of the given subsystem by name.
+ * 
+ * @details The inputs of a subsystem never change, so they are indexed the first time that
+ *          one is looked up.
+ * 
+ * @param s     The subsystem
+ * @param name  The name of the input (interned or not)
+ * @return  The index of the input, -1 if the subsystem has no such input
+ */
+int subsys_input(Subsystem *s, char *name);
+
+/**
+ * @brief   Find an output of the given subsystem by name (see subsys_input()).
+ * 
+ * @param s     The subsystem
+ * @param name  The name of the output (interned or not)
+ * @return  The index of the output, -1 if the subsystem has no such output
+ */
+int subsys_output(Subsystem *s, char *name);
+
+/**
+ * @brief   Find a component of the given subsystem by id.
+ * 
+ * @param s     The subsystem
+ * @param id    The id of the component
+ * @param index Where the position of the component in the list will be stored (if not NULL)
+ * @return  The node of the component, NULL if there is no component with that id
+ */
+Node *subsys_find_comp(Subsystem *s, int id, int *index);
+
+/**
+ * @brief   Return the components of the given subsystem laid out in arrays (see CompStore), building
+ *          them from the list if they have not been built since the last component was added.
+ * 
+ * @details Like the indexes of the signals (see subsys_index_signals()), it must be built before the
+ *          subsystem is shared by threads that use it.
+ * 
+ * @param s     The subsystem
+ * @return  The store (it belongs to the subsystem), NULL if s is NULL
+ */
+CompStore *subsys_store(Subsystem *s);
+
+/**
+ * @brief   Free the given component store (the components themselves are not freed).
+ * 
+ * @param st    The store
+ */
+void free_comp_store(CompStore *st);
+
+/**
+ * @brief   Return the given standard subsystem flattened to gates (see FlatTemplate), flattening it if it
+ *          has not been flattened since the last component was added.
+ * 
+ * @details The subsystems that s instantiates, at any depth, are flattened first, each one only once:
+ *          they are walked with a stack instead of recursion, so the depth of the hierarchy is not
+ *          limited by the call stack. A subsystem that instantiates itself (directly or through others)
+ *          cannot be flattened; the chain of subsystems that leads back to it is printed to stderr.
+ * 
+ *          Like the store (see subsys_store()), it must be built before the subsystem is shared by threads.
+ * 
+ * @param s     The subsystem
+ * @return  The template (it belongs to the subsystem), NULL if s is NULL or cannot be flattened
+ */
+FlatTemplate *subsys_template(Subsystem *s);
+
+/**
+ * @brief   Free the given flattening template.
+ * 
+ * @param t     The template
+ */
+void free_flat_template(FlatTemplate *t);
+
+/**
+ * @brief   Write how many gates the given subsystem has once it is flattened (see subsys_template()), and
+ *          how many of them come from each level of its hierarchy, to the given file.
+ * 
+ * @details Level 0 are the gates of s itself, level d those of the subsystems that are d subsystems below it.
+ * 
+ * @param s     The subsystem
+ * @param fp    The file
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the subsystem cannot be flattened
+ */
+int gate_levels_to_file(Subsystem *s, FILE *fp);
+
+/**
+ * @brief   Make a gate-only copy of the given subsystem, flattened down to its gates however deep
+ *          they are (see subsys_template()).
+ * 
+ * @details The copy has the name, inputs and outputs of s. Its gates are numbered from first_id, in
+ *          the order that netlist_to_gate_only() gives them, and refer to each other with mappings
+ *          only (their inputs are not named). Everything is allocated from the given arena, free the
+ *          copy with free_subsystem() before the arena.
+ * 
+ * @param s         The subsystem
+ * @param first_id  The id of the first gate of the copy
+ * @param arena     Where the copy is allocated
+ * @return  The copy, NULL if s cannot be flattened (or on null arguments)
+ */
+Subsystem *subsys_flatten(Subsystem *s, int first_id, Arena *arena);
+
+/**
+ * @brief   Add an alias to the given subsystem (and to its index of aliases).
+ * 
+ * @param s     The subsystem to which the alias will be added
+ * @param a     The alias
+ * @return 0 on success, an error code otherwise
+ */
+int subsys_add_alias(Subsystem *s, Alias *a);
+
+/**
+ * @brief   Find an alias of the given subsystem by name.
+ * 
+ * @param s     The subsystem
+ * @param name  The name of the alias (interned or not)
+ * @return  The alias, NULL if the subsystem has no alias with that name
+ */
+Alias *subsys_find_alias(Subsystem *s, char *name);
+
+/**
+ * @brief   Given a string representing a truth table of a gate (in the format described in the project
+ *          specification), make it a bitstring packed in words (see Gate) and store it in *tt.
+ * 
+ * @note    Any non-bit characters (not '1' or '0') will be skipped.
+ * 
+ * @example     Suppose the input is '0, 1, 1, 0'. Rows 1 and 2 are 1, so the bitstring (one word)
+ *              would be 6.
+ * 
+ * @example     Suppose that the input is '0, 1'. Row 1 is 1, so the bitstring would be 2.
+ * 
+ * @param _tt   The string containing the truth table.
+ * @param tt    The address where (a pointer to) the new bitstring will be stored (allocated here).
+ * @return      The number of rows found in the string.
+ */
+int parse_truth_table(char *_tt, uint64_t **tt);
+
+/**
+ * @brief   Given a truth table in bitstring form and a set of inputs
+ *          as an array of characters, return a truth value (as an integer).
+ * 
+ * @note    The inputs array must be null terminated.
+ * 
+ * @param tt        The truth table.
+ * @param inputs    The inputs.
+ * @return The truth value of the table with the given inputs (1 or 0)
+ */
+int eval_at(uint64_t *tt, char *inputs);
+
+/**
+ * @brief   Given a truth table in bitstring form and the values of its inputs
+ *          already packed in an integer (the first input being the MSB), return a truth
+ *          value.
+ *
+ * @details This is what eval_at() does, minus building and validating a string of bits,
+ *          which makes it the one to use in simulation loops.
+ *
+ * @example For a gate with 3 inputs and inputs {1, 0, 1}, index would be 5 ('101').
+ *
+ * @param tt        The truth table.
+ * @param index     The values of the inputs, packed in an integer.
+ * @return The truth value of the table with the given inputs (1 or 0)
+ */
+int eval_index(uint64_t *tt, int index);
+
+/**
+ * @brief   Given a truth table in bitstring form, print it in a nice, human readable way.
+ * 
+ * @details To make debugging easy :)
+ * 
+ * @param tt        The truth table to be printed.
+ * @param inputs    The number of inputs that the truth table is expected to accomodate.
+ */
+void print_as_truth_table(uint64_t *tt, int inputs);
+
+/**
+ * @brief   Simulate the behavior of the given subsystem (assumed to only be made of gates) with the
+ *          given set of inputs. Write the results to the given file pointer.
+ * 
+ * @details The display_outs array is an array of boolean values indicating which output values should
+ *          be printed to the output. The number of values in that array should therefore be equal to
+ *          (or greater than, excess values will be ignored) the number of outputs of s.
+ * 
+ * @note    The inputs are passed with the following format: a string of comma-delimited bits, as many
+ *          as the inputs of s, each corresponding to the value of the input with its index.
+ * 
+ * @example If s has 3 inputs: {A, B, C} and 2 outputs {D, E} and we want to simulate {A=1, B=1, C=0}
+ *          and see the value of D, with the results printed in standard output we would call
+ *          simulate as follows:
+ *              simulate(s, "1, 1, 0", [1, 0], stdout)
+ * 
+ * 
+ * @note    The first time a subsystem is simulated it is compiled (see compile_subsystem()) and the
+ *          result is kept in s->program. If the subsystem has no combinational cycles, every call
+ *          evaluates it in exactly one pass. Otherwise the gates are iterated over until nothing
+ *          changes.
+ *
+ * @note    This is a convenience for single vectors, the string is parsed and a Simulator is set up
+ *          on every call. Code that simulates many vectors should keep a Simulator instead (see
+ *          simulator_init() and simulator_run()), like execute_tb() does.
+ *
+ * @param s             The subsystem whose behavior will be simulated
+ * @param inputs        The input values
+ * @param display_outs  An array indicating which outputs will be printed
+ * @param fp            The stream where the output shall be printed
+ * @return 0 on success, nonzero on error
+ */
+int simulate(Subsystem* s, char *inputs, int *display_outs, FILE* fp);
+
+/**
+ * @brief   Compile the given (gate-only) subsystem into a flat list of instructions that
+ *          can be executed with run_program_bits().
+ *
+ * @details The inputs of the subsystem get slots 0 to (#inputs - 1) and the component that
+ *          is evaluated i'th gets slot (#inputs + i), so that the slots are written in order.
+ *
+ *          The components are sorted topologically (Kahn's algorithm). If that is not
+ *          possible because there is a combinational cycle, the program is still created
+ *          (with the instructions in the order of the component list) but its levelized
+ *          flag is not set.
+ *
+ * @param s     The subsystem to be compiled
+ * @param prog  The address where (a pointer to) the new program will be stored
+ *
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if a component is not a gate or a mapping is invalid
+ */
+int compile_subsystem(Subsystem *s, SimProgram **prog);
+
+/**
+ * @brief   Execute the instructions of the given program once, in order, reading and
+ *          writing the values of the signals in the given bit-packed slots.
+ *
+ * @details The slots of the inputs of the subsystem must have been set by the caller.
+ *          If the program is levelized, a single call leaves every slot at its final value.
+ *
+ *          Every slot is one bit (slot i is bit i%64 of word i/64, see SLOT_BIT()), so the
+ *          whole state of a subsystem takes up an eighth of what it would in bytes. Since the
+ *          gates have their slots in the order in which they are evaluated (see compile_subsystem()),
+ *          a pass writes the words one after the other.
+ *
+ * @param p     The program to be executed
+ * @param bits  The values of the signals (BIT_WORDS(p->slotc) words)
+ */
+void run_program_bits(SimProgram *p, uint64_t *bits);
+
+/**
+ * @brief   Return the model that the given subsystem is simulated with without flattening it (see
+ *          SimModel), building it (and the models of the subsystems below it) if it has not been built.
+ *
+ * @details The subsystems are walked bottom up with a stack, like in subsys_template(), and a subsystem
+ *          that instantiates itself is rejected. Only subsystems without combinational cycles can be
+ *          modelled. Like the program, it must be built before the subsystem is shared by threads.
+ *
+ * @param s     The subsystem
+ * @return  The model (it belongs to the subsystem), NULL if s is NULL or cannot be modelled
+ */
+SimModel *subsys_model(Subsystem *s);
+
+/**
+ * @brief   Run the given model once, reading the values of its inputs from the first slots of bits
+ *          and leaving every slot of it at its final value.
+ *
+ * @details The subsystems that it instantiates are run in the words after its own, one level
+ *          of the hierarchy after the other (so the depth of the calls is the depth of the hierarchy).
+ *
+ * @param m     The model
+ * @param bits  The frame of the model (m->frame_words words)
+ */
+void run_model_bits(SimModel *m, uint64_t *bits);
+
+/**
+ * @brief   Free the given model (but not the models of the subsystems that it instantiates, or its program).
+ *
+ * @param m     The model
+ */
+void free_model(SimModel *m);
+
+/**
+ * @brief   Create the state of an event-driven simulation of the given program.
+ *
+ * @note    The program must be levelized, otherwise NULL is returned.
+ *
+ * @param p The program to be simulated (must outlive the simulation)
+ * @return A pointer to the new simulation, or NULL on failure
+ */
+EventSim *event_sim_init(SimProgram *p);
+
+/**
+ * @brief   Schedule every gate that reads the given slot for evaluation in the current vector
+ *          (each gate is scheduled at most once, in the bucket of its level).
+ *
+ * @param sim   The simulation
+ * @param slot  The slot whose value changed
+ */
+void event_sim_schedule(EventSim *sim, int slot);
+
+/**
+ * @brief   Apply a new test vector to an event-driven simulation and settle the circuit.
+ *
+ * @details The first vector evaluates every gate once. Every later vector only evaluates
+ *          the gates that are reached by a change, starting from the inputs that differ from
+ *          the previous vector. The results are found in sim->bits (see p->out_slots and SLOT_BIT()).
+ *
+ * @param sim       The simulation
+ * @param inputs    The value (0 or 1) of each input of the subsystem
+ * @return The number of gates that were evaluated for this vector, or a negative value on error
+ */
+int event_sim_step(EventSim *sim, int *inputs);
+
+/**
+ * @brief   Free an event-driven simulation (but not the program it simulates).
+ *
+ * @param sim   The simulation to be freed
+ */
+void free_event_sim(EventSim *sim);
+
+/**
+ * @brief   Create a simulator for the given subsystem, compiling the subsystem if it has
+ *          not been compiled yet.
+ *
+ * @note    Compiling writes to the subsystem, so the first simulator of a subsystem should
+ *          be created before any threads that share it are started.
+ *
+ * @details A subsystem that instantiates other subsystems is simulated through its model (see
+ *          subsys_model()) instead of a program, without flattening it to gates.
+ *
+ * @param s The subsystem to be simulated
+ * @return A pointer to the new simulator, or NULL on failure
+ */
+Simulator *simulator_init(Subsystem *s);
+
+/**
+ * @brief   Simulate one test vector and settle every signal of the subsystem.
+ *
+ * @details If the subsystem has no cycles, one pass over the gates is enough. Otherwise,
+ *          the gates are evaluated over and over (starting from all signals at 0) until a
+ *          pass changes nothing. The number of passes is stored in sim->iterations.
+ *
+ * @param sim       The simulator
+ * @param in_bits   The values of the inputs, packed in bits ((inputs+63)/64 words)
+ * @param out_bits  Where the values of the outputs will be stored, packed in bits ((outputs+63)/64 words)
+ * @return 0 on success, nonzero on error
+ */
+int simulator_run(Simulator *sim, uint64_t *in_bits, uint64_t *out_bits);
+
+/**
+ * @brief   Free a simulator (but not the subsystem it simulates).
+ *
+ * @param sim   The simulator to be freed
+ */
+void free_simulator(Simulator *sim);
+
+/**
+ * @brief   Execute the instructions of the given program once, in order, on 64 sets of
+ *          values at once.
+ *
+ * @details Every slot is a 64-bit word and bit i of every slot belongs to the i'th set of
+ *          values (its "lane"), so a single pass evaluates the subsystem for 64 test vectors.
+ *          Each gate is evaluated with the bitwise operation that its truth table is
+ *          equivalent to (see classify_truth_table()).
+ *
+ *          Just like run_program_bits(), the input slots must have been set by the caller and
+ *          the program should be levelized.
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc words)
+ */
+void run_program_lanes(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   The same as run_program_lanes(), but with every slot being width words wide (see
+ *          SimKernel), for 64*width sets of values at once.
+ *
+ * @details This is the portable version of the wide kernels, it runs on any CPU.
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc * width words)
+ * @param width The number of words per slot
+ */
+void run_program_words(SimProgram *p, uint64_t *slots, int width);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * @brief   run_program_words() with 4 words (256 lanes) per slot, using AVX2 instructions.
+ *
+ * @note    Only call this if cpu_has_avx2() says so.
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc * 4 words)
+ */
+void run_program_avx2(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   run_program_words() with 8 words (512 lanes) per slot, using AVX-512 instructions.
+ *
+ * @note    Only call this if cpu_has_avx512() says so.
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc * 8 words)
+ */
+void run_program_avx512(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   Check (with CPUID) whether the CPU running the program supports AVX2.
+ *
+ * @return 1 if it does, 0 otherwise
+ */
+int cpu_has_avx2();
+
+/**
+ * @brief   Check (with CPUID) whether the CPU running the program supports AVX-512 (foundation).
+ *
+ * @return 1 if it does, 0 otherwise
+ */
+int cpu_has_avx512();
+
+#endif
+
+/**
+ * @brief   run_program_words() with 4 words per slot (the portable 256-lane kernel).
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc * 4 words)
+ */
+void run_program_words4(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   run_program_words() with 8 words per slot (the portable 512-lane kernel).
+ *
+ * @param p     The program to be executed
+ * @param slots The values of the signals (p->slotc * 8 words)
+ */
+void run_program_words8(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   Choose the fastest kernel of the given width that the CPU running the program
+ *          can execute.
+ *
+ * @details Every width has a portable kernel, so asking for 1, 4 or 8 words always succeeds.
+ *          If width is 0, the widest SIMD kernel that the CPU supports is chosen, or the
+ *          64-lane one if there is none.
+ *
+ * @param width The number of words per slot (1, 4, 8 or 0 for "the best there is")
+ * @return (a pointer to) the kernel, NULL if there is no kernel of the given width
+ */
+SimKernel *select_kernel(int width);
+
+/**
+ * @brief   Write the given program as a C source file, where every gate is a bitwise expression
+ *          on the 64-bit words of its input slots.
+ *
+ * @details The file defines a single function, void sim_kernel(uint64_t *slots), that does what
+ *          run_program_words() does with the given width, in straight-line code: one statement
+ *          per gate (looped over the words of the slot), in the order of the program. Gates that
+ *          are not a plain bitwise operation are written as a tree of muxes (the same reduction
+ *          as eval_lanes(), with the constant parts folded away), or as a per-lane lookup in a
+ *          constant table if they have more than LUT_REDUCE_MAX_INPUTS inputs.
+ *
+ * @param p     The program to be written
+ * @param width The number of 64-bit words per slot that the generated code will work with
+ * @param fp    The stream where the source will be written
+ * @return 0 on success, nonzero on error
+ */
+int program_to_c(SimProgram *p, int width, FILE *fp);
+
+/**
+ * @brief   Compile the given program to machine code and load it (see p->native).
+ *
+ * @details The source written by program_to_c() is compiled with the system C compiler (NATIVE_CC,
+ *          or the CC environment variable if it is set) into a shared object, which is then loaded
+ *          with dlopen(). The compiler is run with NATIVE_CFLAGS, without a shell. The shared object
+ *          is kept in cache_dir under a name made from a hash of the source, the compiler, its flags
+ *          and the identity of the CPU (which -march=native compiles for), so compiling the same
+ *          subsystem (with the same width) again on the same machine only loads it, and a cache
+ *          directory that is shared between machines or compilers never hands out a wrong object.
+ *
+ * @param p         The program to be compiled (must be levelized)
+ * @param width     The number of 64-bit words per slot that the native code will work with
+ * @param cache_dir The directory where the shared objects are kept (created if it does not exist)
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the program could not be compiled or loaded
+ */
+int compile_program_native(SimProgram *p, int width, char *cache_dir);
+
+/**
+ * @brief   Run the native code of the given program (see compile_program_native()), with the
+ *          same signature as the kernels of sim_kernels.
+ *
+ * @param p     The program (already compiled to native code)
+ * @param slots The values of the signals, p->native_width words per slot
+ */
+void run_program_native(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   Translate the given program to x86-64 machine code in memory (see p->jit).
+ *
+ * @details Every gate becomes a few instructions for every word of its slot: its first input
+ *          is loaded in a register, the rest are combined with it straight from memory (and,
+ *          or, xor), the result is inverted if needed (not) and stored in the slot of its output.
+ *          Gates that are not a plain bitwise operation are left to the interpreter, the code
+ *          calls jit_eval_lut() for them. The code is written in memory mapped with mmap() and
+ *          made executable (and read-only) once it is complete.
+ *
+ *          If the code cannot be generated (not an x86-64 machine, or the memory cannot be made
+ *          executable), p->jit stays NULL and run_program_jit() falls back to the interpreter.
+ *
+ * @param p     The program to be translated (must be levelized)
+ * @param width The number of 64-bit words per slot that the code will work with
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the code could not be generated (the fallback is still set up)
+ */
+int jit_compile_program(SimProgram *p, int width);
+
+/**
+ * @brief   Run the jit code of the given program (see jit_compile_program()), or the
+ *          interpreter with the same width (see run_program_words()) if there is none,
+ *          with the same signature as the kernels of sim_kernels.
+ *
+ * @param p     The program
+ * @param slots The values of the signals, p->jit_width words per slot
+ */
+void run_program_jit(SimProgram *p, uint64_t *slots);
+
+/**
+ * @brief   Evaluate a single gate on all the words of its slots, the way run_program_words()
+ *          does. This is what the jit code calls for gates that it does not translate itself.
+ *
+ * @param in    The instruction of the gate
+ * @param slots The values of the signals
+ * @param width The number of 64-bit words per slot
+ */
+void jit_eval_lut(SimInstr *in, uint64_t *slots, int width);
+
+/**
+ * @brief   Check the jit code of a subsystem against the one-vector-at-a-time simulation
+ *          (the engine behind simulate()) on the given number of random test vectors.
+ *
+ * @details The subsystem is compiled and translated (see jit_compile_program()) if needed.
+ *          Every mismatch is reported to stderr.
+ *
+ * @param s         The subsystem to be checked
+ * @param vectors   The number of random test vectors
+ * @param seed      The seed of the random vectors
+ * @return The number of vectors whose outputs differ (0 if the jit code is correct), or a
+ *         negative value on error
+ */
+int jit_check(Subsystem *s, int vectors, unsigned int seed);
+
+/**
+ * @brief   Compute the complete truth table of every output of the given subsystem.
+ *
+ * @details All 2^inputs input patterns are enumerated bit-parallel: the row of the table that
+ *          every lane simulates is the index of the lane, so the input slots are filled with
+ *          fixed patterns (0xAAAA... for the last input, 0xCCCC... for the one before it etc.)
+ *          and every pass of the widest kernel produces whole words of every table at once.
+ *
+ *          The tables are in the format of Gate truth tables (row r is bit r%64 of word r/64,
+ *          with the first input as the MSB of r).
+ *
+ *          A subsystem that instantiates subsystems is flattened to its gates first (see subsys_flatten()).
+ *
+ * @param s         The subsystem (without cycles, up to MAX_EXTRACT_INPUTS inputs)
+ * @param tables    The address where the tables will be stored, one per output (all allocated here)
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the subsystem cannot be enumerated
+ */
+int extract_truth_tables(Subsystem *s, uint64_t ***tables);
+
+/**
+ * @brief   Replace the gates of a standard subsystem with one LUT gate per output, whose truth
+ *          table is the output's complete truth table (see extract_truth_tables()).
+ *
+ * @details The LUT gates are added to the given gate library as standards named
+ *          "<subsystem>_LUT_<output>", each with the same inputs as the subsystem. The subsystem
+ *          keeps its name, inputs and outputs, but its components become the LUT gates, so every
+ *          later simulation (or instantiation) of it is a single table lookup per output.
+ *
+ * @param s         The standard subsystem to be collapsed (up to MAX_GATE_INPUTS inputs)
+ * @param gate_lib  The gate library where the LUT gates will be added
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the subsystem cannot be collapsed
+ */
+int collapse_to_luts(Subsystem *s, Netlist *gate_lib);
+
+/**
+ * @brief   Write the complete truth table of the given subsystem to the given stream, in the
+ *          same format as the output of execute_tb() (one line per input pattern).
+ *
+ * @param s     The subsystem (see extract_truth_tables())
+ * @param fp    The stream where the table will be written
+ * @return 0 on success, nonzero on error
+ */
+int truth_tables_to_file(Subsystem *s, FILE *fp);
+
+/**
+ * @brief   Write the declaration of the given gate (including its truth table) to the given
+ *          stream, in the format of component libraries (see gate_lib_from_file()).
+ *
+ * @note    Unlike gate_to_str(), the truth table is written too, and there is no limit on the
+ *          length of the line (a 16 input gate takes about 200KB).
+ *
+ * @param g     The gate to be written
+ * @param fp    The stream where the declaration will be written
+ * @return 0 on success, nonzero on error
+ */
+int gate_to_file(Gate *g, FILE *fp);
+
+/**
+ * @brief   Find out which bitwise operation (if any) the given truth table is equivalent to.
+ *
+ * @param tt        The truth table.
+ * @param inputc    The number of inputs that the truth table accomodates.
+ * @return The equivalent operation, OP_LUT if there is none.
+ */
+enum GATE_OP classify_truth_table(uint64_t *tt, int inputc);
+
+/**
+ * @brief   Evaluate a truth table on 64 sets of inputs at once.
+ *
+ * @details inputs[i] holds the values of the i'th input in all 64 lanes. The table is
+ *          reduced one input at a time (Shannon expansion), the last input first, with
+ *          each step selecting between the two halves of what is left with a bitwise mux.
+ *          Tables with more than LUT_REDUCE_MAX_INPUTS inputs are too large for that, so
+ *          the row of every lane is looked up on its own instead.
+ *
+ * @param tt        The truth table.
+ * @param inputc    The number of inputs that the truth table accomodates.
+ * @param inputs    The values of the inputs, one word per input.
+ * @return The values of the output in all 64 lanes.
+ */
+uint64_t eval_lanes(uint64_t *tt, int inputc, uint64_t *inputs);
+
+/**
+ * @brief   Properly free up the memory allocated for and used by a compiled program.
+ *
+ * @param p     The program that will be freed
+ */
+void free_program(SimProgram *p);
+
+/**
+ * @brief   Parse the information that describes a testbench from the given file into the
+ *          given structure.
+ * 
+ * @note    This does not allocate memory for the testbench struct itself, and it requires
+ *          that the uut has already been set. If not, an error value will be returned.
+ *          
+ *          It does however allocate memory for the values array, which will need to be
+ *          properly freed.
+ *  
+ * 
+ * @param tb        The structure where the data will be saved
+ * @param filename  The file that will be parsed
+ * @param mode      Unused, the file is only ever read (kept for compatibility)
+ * @return 0 on success, 1 on failure.
+ */
+int parse_tb_from_file(Testbench *tb, char *filename, char *mode);
+
+/**
+ * @brief   Execute the given testbench and write the output to a file with the given name (that
+ *          will be (f)opened with the given mode).
+ *
+ * @details How the test vectors are simulated depends on tb->mode. With SIM_SCALAR, one Simulator
+ *          is run on each one of them (see simulator_run()). With SIM_BIT_PARALLEL, the test vectors are packed
+ *          64*tb->width at a time into words and each batch is simulated with one pass over the
+ *          gates (see execute_tb_bit_parallel()). With SIM_EVENT, the test vectors are applied in order
+ *          to one event-driven simulation (see execute_tb_events()). With SIM_NATIVE, the batches are
+ *          simulated by the UUT compiled to machine code (see compile_program_native()), and with SIM_JIT
+ *          by the UUT translated to machine code in memory (see jit_compile_program()). If the UUT has
+ *          a combinational cycle, the scalar mode is used regardless.
+ *
+ *          If tb->threads is more than 1, the tests are split in chunks that are run on that many
+ *          threads (see execute_tb_parallel()), and the output is the same as with one thread.
+ * 
+ * @param tb            The testbench to be run
+ * @param output_file   The file where the output will be written
+ * @param mode          The mode that will be passed to fopen()
+ * @return 0 on succes, nonzero on error
+ */
+int execute_tb(Testbench *tb, char *output_file, char *mode);
+
+/**
+ * @brief   Run the tests of a testbench in the mode that it asks for and write the results
+ *          (but not the header) to the given stream, on the calling thread.
+ *
+ * @param tb    The testbench to be run
+ * @param fp    The stream where the output will be written
+ * @return 0 on success, nonzero on error
+ */
+int execute_tb_vectors(Testbench *tb, FILE *fp);
+
+/**
+ * @brief   Run the tests of a testbench on tb->threads threads and write the results (but
+ *          not the header) to the given stream, in the original order of the tests.
+ *
+ * @details The tests are split in chunks (a few per thread, so that the threads finish at
+ *          about the same time), and every thread keeps picking up the next chunk that has not
+ *          been run yet. Each chunk is run with execute_tb_vectors() on a copy of the testbench
+ *          that only holds its own tests, so every thread has its own simulation buffers, and
+ *          its output is kept in memory until all the chunks are done. The compiled program of
+ *          the UUT is the only thing that the threads share (it is compiled before they start).
+ *
+ * @param tb    The testbench to be run
+ * @param fp    The stream where the output will be written
+ * @return 0 on success, nonzero on error (the output is only written if every chunk succeeded)
+ */
+int execute_tb_parallel(Testbench *tb, FILE *fp);
+
+/**
+ * @brief   Execute the given testbench 64 tests at a time and write the output to the given
+ *          stream (with one line per test, in order, just like execute_tb()).
+ *
+ * @details The value of each input in 64 consecutive tests is packed into the bits of a word
+ *          and a single run_program_lanes() call simulates all of them.
+ *
+ *          If tb->width is not 1, the kernel chosen by select_kernel() is used instead, and
+ *          each batch is 64*width tests (256 with AVX2, 512 with AVX-512).
+ *
+ *          In SIM_NATIVE mode, the UUT is compiled to machine code instead (in tb->cache_dir, with
+ *          tb->width or NATIVE_WIDTH words per slot) and that code simulates every batch. SIM_JIT is the
+ *          same, with the code generated in memory (with tb->width or JIT_WIDTH words per slot).
+ *
+ * @note    The UUT must already be compiled (see compile_subsystem()) and levelized.
+ *
+ * @param tb    The testbench to be run
+ * @param fp    The stream where the output will be written
+ * @return 0 on success, nonzero on error
+ */
+int execute_tb_bit_parallel(Testbench *tb, FILE *fp);
+
+/**
+ * @brief   Run the tests of a testbench with an event-driven simulation, printing
+ *          the results in the same format as execute_tb().
+ *
+ * @details The tests are applied one after the other to the same simulation (see
+ *          event_sim_step()), so consecutive vectors that differ in few inputs only
+ *          cost the gates that those inputs actually affect. The number of gates that
+ *          were evaluated is reported for every test.
+ *
+ * @note    The UUT must already be compiled (see compile_subsystem()) and levelized.
+ *
+ * @param tb    The testbench to be run
+ * @param fp    The stream where the output will be written
+ * @return 0 on success, nonzero on error
+ */
+int execute_tb_events(Testbench *tb, FILE *fp);
+
+/**
+ * @brief   Compile a gate and a subsystem library into a library image file (see LibImageHeader).
+ *
+ * @details The image is written to a file named after the process first, and only renamed to
+ *          filename once it is complete, so that processes reading it at the same time never map
+ *          half of one.
+ *
+ *          The components of the subsystems must be instances of the gates of gate_lib or of the
+ *          subsystems of subsys_lib (the way subsys_lib_from_file() looks them up), and neither of
+ *          them can be lazily loaded (see subsys_lib_open_lazy()).
+ *
+ * @param gate_lib      The gate library (only gates)
+ * @param subsys_lib    The subsystem library (only subsystems)
+ * @param gate_hash     The hash of the file that gate_lib was read from
+ * @param subsys_hash   The hash of the file that subsys_lib was read from
+ * @param filename      The name of the image file (replaced if it exists)
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @retval GENERIC_ERROR if the libraries cannot be written as an image, or the file cannot be written
+ */
+int lib_image_to_file(Netlist *gate_lib, Netlist *subsys_lib, uint64_t gate_hash, uint64_t subsys_hash, char *filename);
+
+/**
+ * @brief   Map a library image file in memory, read-only.
+ *
+ * @details Every position that the tables hold (names, lists of names, truth tables, runs of
+ *          components, mappings and aliases, prototypes) is checked against the table that it
+ *          points into, so that libs_from_image() can trust the image.
+ *
+ * @param filename  The name of the image file
+ * @return  The mapped image, NULL if the file does not exist, or is not an image of this
+ *          version, or is truncated, or refers to an entry that it does not have
+ */
+LibImage *lib_image_open(char *filename);
+
+/**
+ * @brief   Unmap the given image and free it.
+ *
+ * @param img   The image
+ */
+void lib_image_close(LibImage *img);
+
+/**
+ * @brief   Build the gate and the subsystem library from a mapped image, without parsing any text.
+ *
+ * @details The libraries are the same as the ones that gate_lib_from_file() and subsys_lib_from_file()
+ *          would read from the files that the image was compiled from (they own their memory and
+ *          do not refer to the image, which can be closed afterwards).
+ *
+ *          Like those functions, memory is not allocated for the libraries themselves.
+ *
+ * @param img           The image
+ * @param gate_lib      Where the gate library will be written
+ * @param gate_file     The name of the file of the gate library (saved in gate_lib)
+ * @param subsys_lib    Where the subsystem library will be written
+ * @param subsys_file   The name of the file of the subsystem library (saved in subsys_lib)
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ */
+int libs_from_image(LibImage *img, Netlist *gate_lib, char *gate_file, Netlist *subsys_lib, char *subsys_file);
+
+/**
+ * @brief   Read a gate and a subsystem library, from their image if it is up to date, else from
+ *          their text files (and then compile them into the image for the next time).
+ *
+ * @details The image is up to date if the hashes of the contents of both files are the ones it
+ *          was compiled from.
+ *
+ * @param gate_file     The name of the file of the gate library
+ * @param gate_lib      Where the gate library will be written
+ * @param subsys_file   The name of the file of the subsystem library
+ * @param subsys_lib    Where the subsystem library will be written (looked up in the gate library)
+ * @param image_file    The name of the image file
+ * @param threads       The number of threads that parse the subsystem library, if it is parsed (see subsys_lib_from_file_parallel())
+ * @retval 0 on success
+ * @retval NARG on failure because of null arguments
+ * @return any error of gate_lib_from_file() or subsys_lib_from_file() otherwise
+ */
+int libs_from_files_cached(char *gate_file, Netlist *gate_lib, char *subsys_file, Netlist *subsys_lib, char *image_file, int threads);
 
 
 
@@ -26,15 +26,25 @@
 #define OUTPUT_FILE         "testbench_out.txt"
 #define SUBSYSTEM_NAME      "FULL_ADDER5"
 #define TESTBENCH_FILE      "testbench.txt"
+#define SIM_MODE_NAME       "scalar"
 
 void usage();
 
 int main(int argc, char *argv[]) {
 
     char ch, *gate_lib_name = GATE_LIB_NAME, *input_file = INPUT_FILE, *output_file = OUTPUT_FILE, *subsys_name = SUBSYSTEM_NAME, *tb_file = TESTBENCH_FILE;
+    enum SIM_MODE mode = SIM_SCALAR;
+    int width = 0;
+    int threads = 1;
+    char *cache_dir = NATIVE_CACHE_DIR;
+    char *lut_lib = NULL;
+    char *image_file = NULL;
+    char *parent_file = NULL;
+    int lazy = 0;
+    int table = 0;
 
     // parse any (optional) arguments
-    while ((ch = getopt(argc, argv, "g:i:o:t:s:h")) != -1) {
+    while ((ch = getopt(argc, argv, "g:i:o:t:s:m:w:j:c:x:b:p:lh")) != -1) {
 		switch (ch) {		
 			case 'g':
 				gate_lib_name = optarg;
@@ -51,6 +61,58 @@ int main(int argc, char *argv[]) {
             case 's':
                 subsys_name = optarg;
                 break;
+            case 'm':
+                if (strcmp(optarg, "table") == 0) {
+                    table = 1;
+                } else if (strcmp(optarg, "scalar") == 0) {
+                    mode = SIM_SCALAR;
+                } else if (strcmp(optarg, "bitpar") == 0) {
+                    mode = SIM_BIT_PARALLEL;
+                } else if (strcmp(optarg, "event") == 0) {
+                    mode = SIM_EVENT;
+                } else if (strcmp(optarg, "native") == 0) {
+                    mode = SIM_NATIVE;
+                } else if (strcmp(optarg, "jit") == 0) {
+                    mode = SIM_JIT;
+                } else {
+                    fprintf(stderr, "unknown simulation mode '%s'\n", optarg);
+                    usage();
+                    exit(-1);
+                }
+                break;
+            case 'w':
+                // the width is given in lanes (bits), the library wants words
+                width = atoi(optarg);
+                if (width != 64 && width != 256 && width != 512) {
+                    fprintf(stderr, "invalid kernel width '%s', use 64, 256 or 512\n", optarg);
+                    usage();
+                    exit(-1);
+                }
+                width /= 64;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+                    usage();
+                    exit(-1);
+                }
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
+            case 'x':
+                lut_lib = optarg;
+                break;
+            case 'b':
+                image_file = optarg;
+                break;
+            case 'p':
+                parent_file = optarg;
+                break;
+            case 'l':
+                lazy = 1;
+                break;
             case 'h':
             default:
 				usage();
@@ -58,26 +120,105 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-    // parse the component library where the gates that may be used are defined
     Netlist *gate_lib = malloc(sizeof(Netlist));
-    if (gate_lib_from_file(gate_lib_name, gate_lib)) {
-        fprintf(stderr, "There was an error, the program terminated abruptly!\n");
-        return -1;
-    }
-    
-    // read the netlist where the input circuit is described
     Netlist *input = malloc(sizeof(Netlist));
-    if (subsys_lib_from_file(input_file, input, gate_lib)) {
+    Netlist *parent = NULL;
+
+    if (image_file != NULL) {
+
+        // read both libraries from their compiled image, if it is up to date
+        if (libs_from_files_cached(gate_lib_name, gate_lib, input_file, input, image_file, threads)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+
+    } else {
+
+        // parse the component library where the gates that may be used are defined
+        if (gate_lib_from_file(gate_lib_name, gate_lib)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+        
+        // the netlist may instantiate the subsystems of another library, which is read first
+        Netlist *lookup = gate_lib;
+        if (parent_file != NULL) {
+            parent = malloc(sizeof(Netlist));
+            if (subsys_lib_from_file_parallel(parent_file, parent, gate_lib, threads)) {
+                fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+                return -1;
+            }
+            lookup = parent;
+        }
+
+        // read the netlist where the input circuit is described (all of it, or only the subsystem that is simulated)
+        if (lazy ? subsys_lib_open_lazy(input_file, input, lookup) : subsys_lib_from_file_parallel(input_file, input, lookup, threads)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+    }
+
+    // find the subsystem that will be simulated
+    Standard *std = find_in_lib(input, subsys_name);
+    if (std == NULL) {
+        int _en = lazy_lib_error(input, subsys_name);
+        if (_en) {
+            fprintf(stderr, "the subsystem %s could not be parsed (error %d)\n", subsys_name, _en);
+        }
         fprintf(stderr, "There was an error, the program terminated abruptly!\n");
         return -1;
     }
+    Subsystem *s = std->subsys;
 
-    // find the subsystem that will be simulated
-    Subsystem *s = find_in_lib(input, subsys_name)->subsys;
+    // collapse it into one LUT gate per output if asked to, and write those gates to the given component library
+    if (lut_lib != NULL) {
+
+        if (collapse_to_luts(s, gate_lib)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+
+        FILE *fp = fopen(lut_lib, "a");
+        if (fp == NULL) {
+            fprintf(stderr, "could not open %s\n", lut_lib);
+            return -1;
+        }
+
+        // the library might not end with a newline
+        fprintf(fp, "\n");
+        for (Node *n=s->components->head; n!=NULL; n=n->next) {
+            gate_to_file(n->comp->prototype->gate, fp);
+        }
+        fclose(fp);
+    }
+
+    // with no testbench, write the whole truth table of the subsystem
+    if (table) {
+
+        FILE *fp = fopen(output_file, "w");
+        if (fp == NULL || truth_tables_to_file(s, fp)) {
+            fprintf(stderr, "There was an error, the program terminated abruptly!\n");
+            return -1;
+        }
+        fclose(fp);
+
+        free_lib(input);
+        if (parent != NULL) free_lib(parent);
+        free_lib(gate_lib);
+        free_symbols();
+        return 0;
+    }
 
     // initialize the testbench structure
     Testbench *tb = malloc(sizeof(Testbench));
     tb->uut = s;
+    tb->mode = mode;
+    tb->width = width;
+    tb->threads = threads;
+    tb->cache_dir = cache_dir;
+    tb->values = NULL;          // set by parse_tb_from_file(), so that free_tb() can tell what it allocated
+    tb->arena = NULL;
+    tb->outs_display = NULL;
 
     // start a clock
     clock_t start = clock();  // measure the total time - include the parsing of the file
@@ -102,8 +243,10 @@ int main(int argc, char *argv[]) {
 
     // cleanup
     free_tb(tb);
-    free_lib(gate_lib);
     free_lib(input);
+    if (parent != NULL) free_lib(parent);
+    free_lib(gate_lib);
+    free_symbols();
     printf("Program executed successfully\n");
 
     return 0;
@@ -117,4 +260,18 @@ void usage() {
     printf("\t-o <filename>:\twrite the output to a file with the given name (will be overwritten if it already exists) (default %s)\n", OUTPUT_FILE);
     printf("\t-t <filename>:\tuse the file with the given name as the testbench file (default %s)\n", TESTBENCH_FILE);
     printf("\t-s <name>:\tfind and simulate the subsystem with the given name (must be contained in the specified netlist) (default %s)\n", SUBSYSTEM_NAME);
+    printf("\t-m <mode>:\tsimulate the tests in the given mode (default %s):\n", SIM_MODE_NAME);
+    printf("\t\t\tscalar: one test at a time\n");
+    printf("\t\t\tbitpar: 64 (or more, see -w) tests at a time, packed in the bits of words\n");
+    printf("\t\t\tevent: one test at a time, only re-evaluating the gates affected by the inputs that changed\n");
+    printf("\t\t\tnative: like bitpar, but with the subsystem compiled to machine code with the system C compiler\n");
+    printf("\t\t\ttable: no testbench, write the complete truth table of the subsystem (up to %d inputs)\n", MAX_EXTRACT_INPUTS);
+    printf("\t\t\tjit: like bitpar, but with the subsystem translated to x86-64 machine code in memory\n");
+    printf("\t-w <lanes>:\tin bitpar, native or jit mode, simulate 64, 256 or 512 tests per pass (default: the most that the CPU can do with SIMD instructions, 512 in native and jit mode)\n");
+    printf("\t-c <dir>:\tin native mode, keep the compiled subsystems in the given directory, so that they are only compiled once (default %s)\n", NATIVE_CACHE_DIR);
+    printf("\t-x <filename>:\tcollapse the subsystem into one LUT gate per output (before simulating it) and append those gates to the given component library\n");
+    printf("\t-b <filename>:\tread the component library and the netlist from the given compiled image if it is up to date, else parse them and compile them into it\n");
+    printf("\t-p <filename>:\tread the given subsystem library before the netlist, so that the netlist can instantiate its subsystems (they are simulated without flattening them, one test at a time) (ignored with -b)\n");
+    printf("\t-l:\t\tonly parse the subsystem that is simulated, not the whole netlist (ignored with -b)\n");
+    printf("\t-j <threads>:\tsplit the parsing of the netlist and the tests across the given number of threads, the output stays in the same order (default 1)\n");
 }
@@ -16,6 +16,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "str_util.h"
 
 int write_at(char* dest, char* src, int offset, int n) {
@@ -131,6 +135,116 @@ int read_line_from_file(char **line, char *filename, size_t *len, int offset) {
     return nread;
 }
 
+LineReader *lr_open(char *filename) {
+
+    if (filename == NULL) return NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        close(fd);
+        return NULL;
+    }
+
+    LineReader *r = malloc(sizeof(LineReader));
+    r->size = st.st_size;
+    r->pos = 0;
+    r->mapped = 0;
+    r->data = NULL;
+    r->cap = 128;
+    r->line = malloc(r->cap);
+
+    // map the whole file, an empty one has nothing to map
+    if (r->size > 0) {
+        r->data = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (r->data != MAP_FAILED) {
+            r->mapped = 1;
+        } else {
+
+            // not every file can be mapped (e.g. pipes), read those in one go instead
+            r->data = malloc(r->size);
+            size_t got = 0;
+            ssize_t n;
+            while (got < r->size && (n = read(fd, r->data + got, r->size - got)) > 0) {
+                got += n;
+            }
+            r->size = got;
+        }
+    }
+
+    close(fd);
+
+    return r;
+}
+
+LineReader *lr_from_memory(char *data, size_t size) {
+
+    LineReader *r = malloc(sizeof(LineReader));
+    r->data = data;
+    r->size = size;
+    r->pos = 0;
+    r->mapped = -1;
+    r->cap = 128;
+    r->line = malloc(r->cap);
+
+    return r;
+}
+
+int lr_next(LineReader *r, char **line) {
+
+    if (r == NULL || r->pos >= r->size) {
+        return -1;
+    }
+
+    // the line ends right after the next newline (or at the end of the file)
+    char *start = r->data + r->pos;
+    char *nl = memchr(start, '\n', r->size - r->pos);
+    size_t nread = nl != NULL ? (size_t)(nl - start) + 1 : r->size - r->pos;
+    r->pos += nread;
+
+    // copy it, with a null byte, so that it can be modified (trim_line() may touch one byte past it)
+    if (nread + 2 > r->cap) {
+        while (nread + 2 > r->cap) r->cap *= 2;
+        r->line = realloc(r->line, r->cap);
+    }
+    memcpy(r->line, start, nread);
+    r->line[nread] = '\0';
+
+    char* ignore_start = strstr(r->line, COMMENT_PREFIX);
+    if (ignore_start) {
+        *ignore_start=0;
+    }
+
+    ignore_start = strstr(r->line, KEYWORD_PREFIX);
+    if (ignore_start) {
+        *ignore_start=0;
+    }
+
+    trim_line(&(r->line));
+    *line = r->line;
+
+    return nread;
+}
+
+void lr_close(LineReader *r) {
+
+    if (r == NULL) return;
+
+    if (r->mapped == 1) {
+        munmap(r->data, r->size);
+    } else if (r->mapped == 0) {
+        free(r->data);
+    }
+    free(r->line);
+    free(r);
+}
+
 int starts_with(char *s1, char *s2) {
 
     if (s1 == NULL || s2 == NULL) {
@@ -161,30 +275,29 @@ int index_starts_with(char *s1, char **list, int l_c) {
 
 int str_to_list(char *str, char ***l, char *delim) {
 
-    char *cur;
+    StrView tok;
     int i=0;
 
-    while(str != NULL) {
-
-        // get the list item
-        cur = split(&str, delim);
+    // allocate the list once, with room for every item
+    int n = count_tokens(str, delim);
+    (*l) = realloc((*l), sizeof(char*)*(n+1));
+    if ((*l) == NULL) {
+        fprintf(stderr, "malloc() error! not enough memory!\n");
+        exit(-1);
+    }
 
-        // allocate memory for the list entry
-        (*l) = realloc((*l), sizeof(char*)*(i+1));
-        if ((*l) == NULL) {
-            fprintf(stderr, "malloc() error! not enough memory!\n");
-            exit(-1);
-        }
+    while(next_token(&str, delim, &tok)) {
 
         // allocate memory for the item (plus a null byte)
-        (*l)[i] = malloc(strlen(cur)+1);
+        (*l)[i] = malloc(tok.len+1);
         if ((*l)[i] == NULL) {
             fprintf(stderr, "malloc() error! not enough memory!\n");
             exit(-1);
         }
 
         // copy the item into the table
-        strncpy((*l)[i], cur, strlen(cur)+1);  // strncpy will insert null bytes in empty space
+        memcpy((*l)[i], tok.str, tok.len);
+        (*l)[i][tok.len] = '\0';
 
         i++;
     }
@@ -192,6 +305,141 @@ int str_to_list(char *str, char ***l, char *delim) {
     return i;
 }
 
+int str_to_arena_list(char *str, char ***l, char *delim, Arena *a) {
+
+    StrView tok;
+    int i=0;
+
+    // the list and its items all come from the arena
+    (*l) = arena_alloc(a, sizeof(char*)*(count_tokens(str, delim)+1));
+    while(next_token(&str, delim, &tok)) {
+        (*l)[i++] = arena_strndup(a, tok);
+    }
+
+    return i;
+}
+
+int next_token(char **str, char *delim, StrView *tok) {
+
+    if (*str == NULL) return 0;
+
+    tok->str = *str;
+
+    char *end = strstr(*str, delim);
+    if (end) {
+        /* if delim is found, the token ends there and str moves after it */
+        tok->len = end - *str;
+        *str = end+strlen(delim);
+    } else {
+        /* if this is the last token set str to NULL */
+        tok->len = strlen(*str);
+        *str = NULL;
+    }
+
+    return 1;
+}
+
+int count_tokens(char *str, char *delim) {
+
+    StrView tok;
+    int n = 0;
+
+    while (next_token(&str, delim, &tok)) n++;
+
+    return n;
+}
+
+Arena *arena_init(size_t block_size) {
+
+    Arena *a = malloc(sizeof(Arena));
+    a->head = NULL;
+    a->block_size = block_size > 0 ? block_size : 4096;
+
+    return a;
+}
+
+void *arena_alloc(Arena *a, size_t n) {
+
+    // keep everything aligned to 8 bytes, enough for any of the types stored in an arena
+    n = (n + 7) & ~(size_t)7;
+
+    // add a new block if the current one is full, each one twice the size of the last
+    if (a->head == NULL || a->head->used + n > a->head->size) {
+
+        size_t size = a->block_size;
+        while (size < n) size *= 2;
+        a->block_size = size*2;
+
+        ArenaBlock *b = malloc(sizeof(ArenaBlock) + size);
+        if (b == NULL) {
+            fprintf(stderr, "malloc() error! not enough memory!\n");
+            exit(-1);
+        }
+        b->next = a->head;
+        b->used = 0;
+        b->size = size;
+        a->head = b;
+    }
+
+    void *p = a->head->data + a->head->used;
+    a->head->used += n;
+
+    return p;
+}
+
+char *arena_strndup(Arena *a, StrView v) {
+
+    char *str = arena_alloc(a, v.len+1);
+    memcpy(str, v.str, v.len);
+    str[v.len] = '\0';
+
+    return str;
+}
+
+void *alloc_in(Arena *a, size_t n) {
+    return a != NULL ? arena_alloc(a, n) : malloc(n);
+}
+
+void free_in(Arena *a, void *p) {
+    if (a == NULL) free(p);
+}
+
+void arena_merge(Arena *dst, Arena *src) {
+
+    if (src == NULL) return;
+
+    // the blocks of src go after the one that dst allocates from, so that it keeps allocating from it
+    if (src->head != NULL) {
+        ArenaBlock *last = src->head;
+        while (last->next != NULL) last = last->next;
+
+        if (dst->head == NULL) {
+            dst->head = src->head;
+        } else {
+            last->next = dst->head->next;
+            dst->head->next = src->head;
+        }
+    }
+
+    if (src->block_size > dst->block_size) {
+        dst->block_size = src->block_size;
+    }
+
+    free(src);
+}
+
+void arena_free(Arena *a) {
+
+    if (a == NULL) return;
+
+    ArenaBlock *next;
+    for (ArenaBlock *b=a->head; b!=NULL; b=next) {
+        next = b->next;
+        free(b);
+    }
+    free(a);
+}
+
 int trim_line(char **line) {
     int i=0, text=0, end=0;
     char *start = (*line);
@@ -333,3 +581,33 @@ int one_at_index(int size, int n) {
     res = (1<<((size-1)-n));
     return res;
 }
+
+unsigned long long hash_bytes(char *str, int n) {
+
+    // FNV-1a: xor in every byte, then multiply by the FNV prime
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i=0; i<n; i++) {
+        hash ^= (unsigned char) str[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+int hash_file(char *filename, unsigned long long *hash) {
+
+    if (filename == NULL || hash == NULL) {
+        return -1;
+    }
+
+    // the reader maps the whole file, which is all that is needed
+    LineReader *r = lr_open(filename);
+    if (r == NULL) {
+        return -1;
+    }
+
+    *hash = hash_bytes(r->data, r->size);
+    lr_close(r);
+
+    return 0;
+}
@@ -93,6 +93,127 @@ int write_list_at(int lc, char** l, char* delim, char* dest, int offset, int n,
  */
 char *split(char **str, char *delim);
 
+#ifndef STR_VIEW
+#define STR_VIEW
+/**
+ * @brief   A part of a string that is not copied (and not null terminated): len bytes starting at str.
+ */
+typedef struct str_view {
+    char *str;  /**< Where the part starts */
+    int len;    /**< How many bytes it is */
+} StrView;
+
+/**
+ * @brief   A block of an arena (see Arena).
+ */
+typedef struct arena_block {
+    struct arena_block *next;   /**< The block that was allocated before this one */
+    size_t used;                /**< The bytes of data that have been handed out */
+    size_t size;                /**< The bytes of data that this block has */
+    char data[];                /**< The memory that is handed out */
+} ArenaBlock;
+
+/**
+ * @brief   A region of memory that many small objects are allocated from and that is freed
+ *          all at once.
+ * 
+ * @details Allocating is moving a pointer forward in the current block (a new, bigger one is
+ *          added when it is full), and the objects are never freed one by one. Meant for lots
+ *          of small things that live as long as something else does (e.g. the values of a testbench).
+ */
+typedef struct arena {
+    ArenaBlock *head;   /**< The block that objects are allocated from */
+    size_t block_size;  /**< The size of the next block that will be added */
+} Arena;
+#endif
+
+/**
+ * @brief   Find the next token of str (up to delim, or to the end of str), without copying it.
+ * 
+ * @details Works like split(), but str is not modified: tok points into it. Consecutive
+ *          delimiters give empty tokens, just like split() does.
+ * 
+ * @param str   The (address of the) string, moved after the token and its delimiter (NULL after the last token)
+ * @param delim The delimiter at which the string will be split
+ * @param tok   Where the found token will be stored
+ * @return  1 if a token was found, 0 if str was already NULL
+ */
+int next_token(char **str, char *delim, StrView *tok);
+
+/**
+ * @brief   Count the tokens that next_token() would find in str.
+ * 
+ * @param str   The string
+ * @param delim The delimiter
+ * @return  The number of tokens (0 if str is NULL)
+ */
+int count_tokens(char *str, char *delim);
+
+/**
+ * @brief   Create an (empty) arena whose first block will have the given size.
+ * 
+ * @param block_size    The size of the first block in bytes (0 for a default size)
+ * @return  The new arena, to be freed with arena_free()
+ */
+Arena *arena_init(size_t block_size);
+
+/**
+ * @brief   Allocate n bytes (aligned for any type) from the given arena.
+ * 
+ * @param a The arena
+ * @param n The number of bytes
+ * @return  The allocated memory, which is freed along with the arena
+ */
+void *arena_alloc(Arena *a, size_t n);
+
+/**
+ * @brief   Copy the given view into the arena as a null terminated string.
+ * 
+ * @param a The arena
+ * @param v The part of a string that will be copied
+ * @return  The copy
+ */
+char *arena_strndup(Arena *a, StrView v);
+
+/**
+ * @brief   Allocate n bytes from the given arena, or with malloc() if there is no arena.
+ * 
+ * @details For structures that may or may not live in an arena: they are allocated with this
+ *          and freed with free_in() with the same arena, whichever it is.
+ * 
+ * @param a The arena (NULL for none)
+ * @param n The number of bytes
+ * @return  The allocated memory
+ */
+void *alloc_in(Arena *a, size_t n);
+
+/**
+ * @brief   Free memory that was allocated by alloc_in() with the same arena (nothing is done if
+ *          there is an arena, the memory goes away with it).
+ * 
+ * @param a The arena (NULL for none)
+ * @param p The memory
+ */
+void free_in(Arena *a, void *p);
+
+/**
+ * @brief   Move everything that was allocated from src to dst, and free src.
+ * 
+ * @details Only the blocks change hands, nothing is copied, so whatever was allocated from src
+ *          stays where it is and is freed along with dst.
+ * 
+ * @param dst   The arena that takes over the blocks
+ * @param src   The arena that gives them up (freed, NULL for none)
+ */
+void arena_merge(Arena *dst, Arena *src);
+
+/**
+ * @brief   Free the given arena and everything that was allocated from it.
+ * 
+ * @param a The arena
+ */
+void arena_free(Arena *a);
+
 /**
  * @brief   Reads from the file with the given filename starting at offset and until a newline
  *          character is found. Stores the line in the buffer pointed to by line.
@@ -129,6 +250,63 @@ char *split(char **str, char *delim);
  */
 int read_line_from_file(char **line, char *filename, size_t *len, int offset);
 
+/**
+ * @brief   A file opened once and handed out line by line (see lr_open() and lr_next()).
+ * 
+ * @details The whole file is mapped in memory (or read into a buffer, if it cannot be mapped),
+ *          so reading it sequentially costs no system calls per line, unlike read_line_from_file().
+ */
+#ifndef LINE_READER
+#define LINE_READER
+typedef struct line_reader {
+    char *data;     /**< The contents of the file */
+    size_t size;    /**< The size of the file in bytes */
+    size_t pos;     /**< The offset of the next line in data */
+    int mapped;     /**< 1 if data is mapped, 0 if it was malloc'd, -1 if it belongs to someone else (see lr_from_memory()) */
+    char *line;     /**< The buffer where the last line is stored */
+    size_t cap;     /**< The size of the line buffer */
+} LineReader;
+#endif
+
+/**
+ * @brief   Open the file with the given filename for reading line by line with lr_next().
+ * 
+ * @param filename  The file that will be read
+ * @return  The reader (to be closed with lr_close()), NULL if the file could not be opened
+ */
+LineReader *lr_open(char *filename);
+
+/**
+ * @brief   Read the given bytes line by line with lr_next(), as if they were a file.
+ * 
+ * @details The bytes are not copied (nor freed by lr_close()), so they must outlive the reader.
+ *          Meant for reading parts of a file that is already open (e.g. one block per thread).
+ * 
+ * @param data  The bytes
+ * @param size  The number of bytes
+ * @return  The reader (to be closed with lr_close())
+ */
+LineReader *lr_from_memory(char *data, size_t size);
+
+/**
+ * @brief   Read the next line of the file, in the same way as read_line_from_file() does.
+ * 
+ * @details The stored line has any comment or keyword removed and is trimmed. It belongs to
+ *          the reader and is overwritten by the next call, so it must be copied to be kept.
+ * 
+ * @param r     The reader
+ * @param line  A pointer to where (the address of) the read line will be saved
+ * @return  The number of bytes read from the file, -1 at the end of it
+ */
+int lr_next(LineReader *r, char **line);
+
+/**
+ * @brief   Close the file of the given reader and free the reader.
+ * 
+ * @param r The reader that will be closed
+ */
+void lr_close(LineReader *r);
+
 /**
  * @brief   Check if s1 starts with s2. Basically a wrapper to strncmp(s1, s2, strlen(s2)).
  * 
@@ -161,16 +339,29 @@ int index_starts_with(char *s1, char **list, int l_c);
  * @note    Each element of l and l itself will eventually need to be freed
  *          by the caller.
  * 
- * @note    split() will be called on str, so it will be modified. Keeping a
- *          pointer to it (for example to free it later) is suggested.
+ * @note    str is not modified, the items are found with next_token() and only copied once
+ *          (l is allocated once, with room for all of them).
  * 
  * @param str   The string that will be split into substrings that will be stored in l
- * @param l     The list where the substrings of str will be stored0
+ * @param l     The list where the substrings of str will be stored
  * @param delim The delimiter on which str will be split
  * @return  Returns the number of items written.
  */
 int str_to_list(char *str, char ***l, char *delim);
 
+/**
+ * @brief   Like str_to_list(), but l and its elements are allocated from the given arena.
+ * 
+ * @details Nothing needs to be freed by the caller, everything goes away with arena_free().
+ * 
+ * @param str   The string that will be split into substrings that will be stored in l
+ * @param l     The list where the substrings of str will be stored
+ * @param delim The delimiter on which str will be split
+ * @param a     The arena where l and its elements will be allocated
+ * @return  Returns the number of items written.
+ */
+int str_to_arena_list(char *str, char ***l, char *delim, Arena *a);
+
 /**
  * @brief   Remove the starting and trailing whitespace from a line of text.
  * 
@@ -286,3 +477,24 @@ char* binary(int x);
  * @return      The resulting bitstring as an integer
  */
 int one_at_index(int size, int n);
+
+/**
+ * @brief   Hash the first n bytes of the given string (64-bit FNV-1a).
+ * 
+ * @details Meant for telling contents apart (e.g. naming cached files after what
+ *          they were made from), not for anything that needs to be secure.
+ * 
+ * @param str   The bytes to be hashed
+ * @param n     The number of bytes that will be hashed
+ * @return      The hash of the bytes
+ */
+unsigned long long hash_bytes(char *str, int n);
+
+/**
+ * @brief   Hash the contents of the file with the given name (see hash_bytes()).
+ * 
+ * @param filename  The name of the file
+ * @param hash      Where the hash will be stored
+ * @return      0 on success, -1 if the file could not be read
+ */
+int hash_file(char *filename, unsigned long long *hash);